@@ -1,64 +1,256 @@
 #include <string.h>
-#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <string>
 #include <vector>
 
+#include <unicode/utf16.h>
+#include <unicode/utf8.h>
 #include <utils/Log.h>
 
 #include "minikin/Hyphenator.h"
+#include "minikin/MappedFile.h"
 
 using minikin::HyphenationType;
 using minikin::Hyphenator;
+using minikin::MappedFile;
+
+namespace {
+
+// A word of the word list, with the UTF-8 offset of each UTF-16 code unit so that the hyphenation
+// can be printed back in the original encoding.
+struct Word {
+    std::string utf8;
+    std::vector<uint16_t> utf16;
+    std::vector<size_t> utf8Offsets;  // One more than utf16, the last one is utf8.size().
+};
+
+void usage() {
+    fprintf(stderr,
+            "usage: hyphtool [options] hyb-file locale [word-list]\n"
+            "\n"
+            "Hyphenates each line of the UTF-8 word list, or of stdin if the word list is missing\n"
+            "or \"-\", and prints the words with a '-' at each hyphenation point.\n"
+            "\n"
+            "options:\n"
+            "  -p N     minimum prefix length (default 2)\n"
+            "  -s N     minimum suffix length (default 3)\n"
+            "  -n N     hyphenate the word list N times for timing (default 1)\n"
+            "  -e FILE  compare the output with FILE, one hyphenated word per line, and exit\n"
+            "           with 1 if any of them differs\n"
+            "  -q       don't print the hyphenated words\n");
+}
 
 Hyphenator* loadHybFile(const char* fn, int minPrefix, int minSuffix, const char* language) {
-    struct stat statbuf;
-    int status = stat(fn, &statbuf);
-    if (status < 0) {
+    // Never unmapped, since the hyphenator refers to the data until the process exits.
+    MappedFile* file = MappedFile::open(fn).release();
+    if (file == nullptr) {
         fprintf(stderr, "error opening %s\n", fn);
         return nullptr;
     }
-    size_t size = statbuf.st_size;
-    FILE* f = fopen(fn, "rb");
-    if (f == NULL) {
-        fprintf(stderr, "error opening %s\n", fn);
+    const uint8_t* data = static_cast<const uint8_t*>(file->data());
+    if (!Hyphenator::isValidBinary(data, file->size())) {
+        fprintf(stderr, "invalid hyb file %s\n", fn);
         return nullptr;
     }
-    uint8_t* buf = new uint8_t[size];
-    size_t read_size = fread(buf, 1, size, f);
-    fclose(f);
-    if (read_size < size) {
+    return Hyphenator::loadBinary(data, minPrefix, minSuffix, language);
+}
+
+// Reads the lines of the file, without the line terminators. Returns false on error.
+bool readLines(const char* fn, std::vector<std::string>* lines) {
+    FILE* f = strcmp(fn, "-") == 0 ? stdin : fopen(fn, "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "error opening %s\n", fn);
+        return false;
+    }
+    std::string line;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c == '\n') {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            lines->push_back(line);
+            line.clear();
+        } else {
+            line.push_back(c);
+        }
+    }
+    if (!line.empty()) {
+        lines->push_back(line);
+    }
+    const bool failed = ferror(f);
+    if (f != stdin) {
+        fclose(f);
+    }
+    if (failed) {
         fprintf(stderr, "error reading %s\n", fn);
-        delete[] buf;
-        return nullptr;
     }
-    return Hyphenator::loadBinary(buf, minPrefix, minSuffix, language);
+    return !failed;
+}
+
+// Decodes the UTF-8 word. Ill-formed sequences are replaced with U+FFFD.
+Word decodeWord(const std::string& utf8) {
+    Word word;
+    word.utf8 = utf8;
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(utf8.data());
+    const int32_t length = utf8.size();
+    int32_t i = 0;
+    while (i < length) {
+        const size_t start = i;
+        UChar32 c;
+        U8_NEXT(s, i, length, c);
+        if (c < 0) {
+            c = 0xFFFD;
+        }
+        word.utf8Offsets.push_back(start);
+        if (U16_LENGTH(c) == 1) {
+            word.utf16.push_back(c);
+        } else {
+            // The trail surrogate starts at the end of the code point, so that it is empty.
+            word.utf8Offsets.push_back(i);
+            word.utf16.push_back(U16_LEAD(c));
+            word.utf16.push_back(U16_TRAIL(c));
+        }
+    }
+    word.utf8Offsets.push_back(utf8.size());
+    return word;
 }
 
+// Returns the word with a '-' at each hyphenation point.
+std::string formatHyphenation(const Word& word, const std::vector<HyphenationType>& result) {
+    std::string out;
+    for (size_t i = 0; i < word.utf16.size(); i++) {
+        const size_t start = word.utf8Offsets[i];
+        const size_t end = word.utf8Offsets[i + 1];
+        if (start == end) {
+            continue;  // The trail surrogate, printed with the lead one.
+        }
+        if (result[i] != HyphenationType::DONT_BREAK) {
+            out.push_back('-');
+        }
+        out.append(word.utf8, start, end - start);
+    }
+    return out;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * p))];
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
-    Hyphenator* hyph = loadHybFile("/tmp/en.hyb", 2, 3, "en");  // should also be configurable
-    std::vector<HyphenationType> result;
-    std::vector<uint16_t> word;
-    if (argc < 2) {
-        fprintf(stderr, "usage: hyphtool word\n");
+    int minPrefix = 2;
+    int minSuffix = 3;
+    int iterations = 1;
+    const char* expectedFile = nullptr;
+    bool quiet = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:n:e:qh")) != -1) {
+        switch (opt) {
+            case 'p':
+                minPrefix = atoi(optarg);
+                break;
+            case 's':
+                minSuffix = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'e':
+                expectedFile = optarg;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (argc - optind < 2 || argc - optind > 3 || minPrefix < 1 || minSuffix < 1 ||
+        iterations < 1) {
+        usage();
         return 1;
     }
-    char* asciiword = argv[1];
-    size_t len = strlen(asciiword);
-    for (size_t i = 0; i < len; i++) {
-        uint32_t c = asciiword[i];
-        if (c == '-') {
-            c = 0x00AD;
+    const char* hybFile = argv[optind];
+    const std::string locale = argv[optind + 1];
+    const char* wordList = argc - optind == 3 ? argv[optind + 2] : "-";
+
+    // Hyphenator only needs the language to pick the language specific rules, same as
+    // HyphenatorMap::addFileInternal.
+    const std::string language = locale.substr(0, locale.find_first_of("-_"));
+    Hyphenator* hyph = loadHybFile(hybFile, minPrefix, minSuffix, language.c_str());
+    if (hyph == nullptr) {
+        return 1;
+    }
+    std::vector<std::string> lines;
+    if (!readLines(wordList, &lines)) {
+        return 1;
+    }
+    std::vector<Word> words;
+    words.reserve(lines.size());
+    for (const std::string& line : lines) {
+        words.push_back(decodeWord(line));
+    }
+
+    // Each call is timed separately for the latency percentiles. The clock overhead is included,
+    // which is a few tens of nanoseconds on most hosts.
+    std::vector<std::vector<HyphenationType>> results(words.size());
+    std::vector<double> latencies;
+    latencies.reserve(words.size() * iterations);
+    const auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < words.size(); i++) {
+            const auto wordStart = std::chrono::steady_clock::now();
+            hyph->hyphenate(words[i].utf16, &results[i]);
+            const auto wordEnd = std::chrono::steady_clock::now();
+            latencies.push_back(
+                    std::chrono::duration<double, std::nano>(wordEnd - wordStart).count());
         }
-        // ASCII (or possibly ISO Latin 1), but kinda painful to do utf conversion :(
-        word.push_back(c);
     }
-    hyph->hyphenate(word, &result);
-    for (size_t i = 0; i < len; i++) {
-        if (result[i] != HyphenationType::DONT_BREAK) {
-            printf("-");
+    const double elapsed =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::string> expected;
+    if (expectedFile != nullptr && !readLines(expectedFile, &expected)) {
+        return 1;
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+        const std::string hyphenated = formatHyphenation(words[i], results[i]);
+        if (!quiet) {
+            printf("%s\n", hyphenated.c_str());
+        }
+        if (expectedFile != nullptr) {
+            const std::string& expectedWord = i < expected.size() ? expected[i] : std::string();
+            if (hyphenated != expectedWord) {
+                fprintf(stderr, "line %zu: expected %s, got %s\n", i + 1, expectedWord.c_str(),
+                        hyphenated.c_str());
+                mismatches++;
+            }
         }
-        printf("%c", word[i]);
     }
-    printf("\n");
+    if (expectedFile != nullptr && expected.size() != words.size()) {
+        fprintf(stderr, "expected %zu words, got %zu\n", expected.size(), words.size());
+        mismatches++;
+    }
+
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        fprintf(stderr, "%zu words x %d: %.0f words/s\n", words.size(), iterations,
+                latencies.size() / elapsed);
+        fprintf(stderr, "latency (ns): p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n",
+                percentile(latencies, 0.5), percentile(latencies, 0.9),
+                percentile(latencies, 0.99), latencies.back());
+    }
+    if (mismatches != 0) {
+        fprintf(stderr, "%zu mismatches\n", mismatches);
+        return 1;
+    }
     return 0;
 }
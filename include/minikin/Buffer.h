@@ -17,6 +17,7 @@
 #ifndef MINIKIN_BUFFER_H
 #define MINIKIN_BUFFER_H
 
+#include <cstdint>
 #include <cstring>
 #include <string_view>
 #include <type_traits>
@@ -24,14 +25,73 @@
 
 namespace minikin {
 
+// Access policy of BasicBufferReader for trusted buffers, e.g. the memory shared by the Zygote.
+// No bounds checking is done, so reading has no overhead.
+class TrustedBufferPolicy {
+public:
+    static constexpr bool kChecked = false;
+
+    constexpr bool hasError() const { return false; }
+
+protected:
+    constexpr bool checkRange(size_t /* pos */, uint64_t /* length */) { return true; }
+    constexpr uint32_t checkCount(size_t /* pos */, uint32_t count) { return count; }
+};
+
+// Access policy of BasicBufferReader for untrusted buffers, e.g. a font map loaded from disk. Every
+// access is validated against the buffer size. Once an access fails, the reader returns zero
+// values and empty arrays, and hasError() returns true.
+class CheckedBufferPolicy {
+public:
+    static constexpr bool kChecked = true;
+
+    bool hasError() const { return mError; }
+
+    // Marks the buffer as invalid. Used when the read values are inconsistent.
+    void setError() { mError = true; }
+
+protected:
+    CheckedBufferPolicy() : mSize(0), mError(false) {}
+    explicit CheckedBufferPolicy(size_t size) : mSize(size), mError(false) {}
+
+    bool checkRange(size_t pos, uint64_t length) {
+        if (mError || pos > mSize || length > mSize - pos) {
+            mError = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Every serialized element takes at least one byte, so a count larger than the remaining
+    // buffer size is always broken. Rejecting it keeps the caller from reserving huge memory.
+    uint32_t checkCount(size_t pos, uint32_t count) {
+        if (mError || count > mSize - pos) {
+            mError = true;
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    size_t mSize;
+    bool mError;
+};
+
 // This is a helper class to read data from a memory buffer.
 // This class does not copy memory, and may return pointers to parts of the memory buffer.
 // Thus the memory buffer should outlive objects created using this class.
-class BufferReader {
+// Use BufferReader for trusted buffers and CheckedBufferReader for untrusted buffers.
+template <typename Policy>
+class BasicBufferReader : public Policy {
 public:
-    BufferReader(const void* buffer) : BufferReader(buffer, 0) {}
-    BufferReader(const void* buffer, uint32_t pos)
+    template <typename P = Policy, typename = std::enable_if_t<!P::kChecked>>
+    BasicBufferReader(const void* buffer) : BasicBufferReader(buffer, 0) {}
+    template <typename P = Policy, typename = std::enable_if_t<!P::kChecked>>
+    BasicBufferReader(const void* buffer, uint32_t pos)
             : mData(reinterpret_cast<const uint8_t*>(buffer)), mPos(pos) {}
+    template <typename P = Policy, typename = std::enable_if_t<P::kChecked>>
+    BasicBufferReader(const void* buffer, size_t size, uint32_t pos = 0)
+            : Policy(size), mData(reinterpret_cast<const uint8_t*>(buffer)), mPos(pos) {}
 
     template <typename T>
     static uint32_t align(uint32_t pos) {
@@ -46,7 +106,11 @@ public:
     template <typename T>
     const T& read() {
         static_assert(std::is_pod<T>::value, "T must be a POD");
-        mPos = BufferReader::align<T>(mPos);
+        mPos = BasicBufferReader::align<T>(mPos);
+        if (!this->checkRange(mPos, sizeof(T))) {
+            static const T kZero = {};
+            return kZero;
+        }
         const T* data = reinterpret_cast<const T*>(mData + mPos);
         mPos += sizeof(T);
         return *data;
@@ -55,7 +119,8 @@ public:
     template <typename T>
     void skip() {
         static_assert(std::is_pod<T>::value, "T must be a POD");
-        mPos = BufferReader::align<T>(mPos);
+        mPos = BasicBufferReader::align<T>(mPos);
+        if (!this->checkRange(mPos, sizeof(T))) return;
         mPos += sizeof(T);
     }
 
@@ -64,7 +129,10 @@ public:
     std::pair<const T*, uint32_t> readArray() {
         static_assert(std::is_pod<T>::value, "T must be a POD");
         uint32_t size = read<uint32_t>();
-        mPos = BufferReader::align<T>(mPos);
+        mPos = BasicBufferReader::align<T>(mPos);
+        if (!this->checkRange(mPos, static_cast<uint64_t>(size) * sizeof(T))) {
+            return std::make_pair(nullptr, 0);
+        }
         const T* data = reinterpret_cast<const T*>(mData + mPos);
         mPos += size * sizeof(T);
         return std::make_pair(data, size);
@@ -74,7 +142,8 @@ public:
     void skipArray() {
         static_assert(std::is_pod<T>::value, "T must be a POD");
         uint32_t size = read<uint32_t>();
-        mPos = BufferReader::align<T>(mPos);
+        mPos = BasicBufferReader::align<T>(mPos);
+        if (!this->checkRange(mPos, static_cast<uint64_t>(size) * sizeof(T))) return;
         mPos += size * sizeof(T);
     }
 
@@ -85,6 +154,13 @@ public:
 
     void skipString() { skipArray<char>(); }
 
+    // Read the number of elements that follows. The checked reader returns zero if the remaining
+    // buffer is too short for that many elements.
+    uint32_t readCount() {
+        uint32_t count = read<uint32_t>();
+        return this->checkCount(mPos, count);
+    }
+
     const void* data() const { return mData; }
     size_t pos() const { return mPos; }
 
@@ -93,6 +169,9 @@ private:
     size_t mPos;
 };
 
+using BufferReader = BasicBufferReader<TrustedBufferPolicy>;
+using CheckedBufferReader = BasicBufferReader<CheckedBufferPolicy>;
+
 // This is a helper class to write data to a memory buffer.
 class BufferWriter {
 public:
@@ -26,8 +26,18 @@ namespace minikin {
 
 class CmapCoverage {
 public:
+    // The number of code points in a page is 1 << kLogCharsPerPage.
+    static constexpr int kLogCharsPerPage = 8;
+
     static SparseBitSet getCoverage(const uint8_t* cmap_data, size_t cmap_size,
                                     std::vector<std::unique_ptr<SparseBitSet>>* out);
+
+    // Returns the set of pages (code point >> kLogCharsPerPage) which have at least one covered
+    // code point. This reads the same subtable as getCoverage but does not build the per code
+    // point bitmaps nor the variation sequence coverage. outHasVSTable is set to true if the
+    // cmap has a format 14 subtable.
+    static SparseBitSet getCoveragePages(const uint8_t* cmap_data, size_t cmap_size,
+                                         bool* outHasVSTable);
 };
 
 }  // namespace minikin
@@ -17,6 +17,7 @@
 #ifndef MINIKIN_FONT_H
 #define MINIKIN_FONT_H
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
@@ -115,6 +116,10 @@ public:
     // Type for functions to read MinikinFont metadata and return
     // TypefaceLoader.
     using TypefaceReader = TypefaceLoader*(BufferReader* reader);
+    // Same as TypefaceReader but for untrusted buffers. The returned TypefaceLoader is later
+    // called with a BufferReader pointing to the same metadata, so the function must validate
+    // every field that the loader reads. Returns nullptr if the metadata is broken.
+    using CheckedTypefaceReader = TypefaceLoader*(CheckedBufferReader* reader);
     // Type for functions to write MinikinFont metadata.
     using TypefaceWriter = void(BufferWriter* writer, const MinikinFont* typeface);
 
@@ -127,6 +132,23 @@ public:
                 new Font(style, typefaceMetadataReader, typefaceLoader, localeListId));
     }
 
+    // Returns nullptr and sets the error on the reader if the buffer is broken.
+    template <CheckedTypefaceReader typefaceReader>
+    static std::shared_ptr<Font> readFrom(CheckedBufferReader* reader, uint32_t localeListId) {
+        FontStyle style = FontStyle(reader);
+        // The metadata is validated by typefaceReader, so the loader can read it without checks.
+        BufferReader typefaceMetadataReader(reader->data(), reader->pos());
+        TypefaceLoader* typefaceLoader = typefaceReader(reader);
+        if (typefaceLoader == nullptr) {
+            reader->setError();
+        }
+        if (reader->hasError()) {
+            return nullptr;
+        }
+        return std::shared_ptr<Font>(
+                new Font(style, typefaceMetadataReader, typefaceLoader, localeListId));
+    }
+
     template <TypefaceWriter typefaceWriter>
     void writeTo(BufferWriter* writer) const {
         mStyle.writeTo(writer);
@@ -143,6 +165,11 @@ public:
 
     std::unordered_set<AxisTag> getSupportedAxes() const;
 
+    // Returns the character to be drawn for the preferred hyphen character. The Armenian hyphen,
+    // the Hebrew maqaf and the Canadian syllabic hyphen fall back to HYPHEN, and HYPHEN falls back
+    // to HYPHEN-MINUS, if this font does not support them. Memoized per hyphen character.
+    uint32_t getHyphenChar(uint32_t preferredHyphen) const;
+
 private:
     // Use Builder instead.
     Font(std::shared_ptr<MinikinFont>&& typeface, FontStyle style, HbFontUniquePtr&& baseFont,
@@ -179,6 +206,11 @@ private:
 
     uint32_t mLocaleListId;
 
+    // The character drawn for each hyphen character in kHyphenChars. Zero until getHyphenChar
+    // resolves it.
+    static constexpr uint32_t kHyphenCharCount = 4;
+    mutable std::atomic<uint32_t> mHyphenChars[kHyphenCharCount] = {};
+
     // Stop copying and moving
     Font(Font&& o) = delete;
     Font& operator=(Font&& o) = delete;
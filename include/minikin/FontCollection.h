@@ -42,11 +42,12 @@ public:
 
     template <Font::TypefaceReader typefaceReader>
     static std::vector<std::shared_ptr<FontCollection>> readVector(BufferReader* reader) {
+        SparseBitSetTableReader coverageTable(reader);
         uint32_t allFontFamiliesCount = reader->read<uint32_t>();
         std::vector<std::shared_ptr<FontFamily>> allFontFamilies;
         allFontFamilies.reserve(allFontFamiliesCount);
         for (uint32_t i = 0; i < allFontFamiliesCount; i++) {
-            allFontFamilies.push_back(FontFamily::readFrom<typefaceReader>(reader));
+            allFontFamilies.push_back(FontFamily::readFrom<typefaceReader>(reader, &coverageTable));
         }
         uint32_t fontCollectionsCount = reader->read<uint32_t>();
         std::vector<std::shared_ptr<FontCollection>> fontCollections;
@@ -57,6 +58,30 @@ public:
         return fontCollections;
     }
 
+    // Reads font collections from an untrusted buffer, e.g. a font map file loaded from disk.
+    // Every offset and index is validated before use. Returns an empty vector if the buffer is
+    // broken.
+    template <Font::CheckedTypefaceReader typefaceReader>
+    static std::vector<std::shared_ptr<FontCollection>> readVector(CheckedBufferReader* reader) {
+        SparseBitSetTableReader coverageTable(reader);
+        uint32_t allFontFamiliesCount = reader->readCount();
+        std::vector<std::shared_ptr<FontFamily>> allFontFamilies;
+        allFontFamilies.reserve(allFontFamiliesCount);
+        for (uint32_t i = 0; i < allFontFamiliesCount && !reader->hasError(); i++) {
+            allFontFamilies.push_back(FontFamily::readFrom<typefaceReader>(reader, &coverageTable));
+        }
+        uint32_t fontCollectionsCount = reader->readCount();
+        std::vector<std::shared_ptr<FontCollection>> fontCollections;
+        fontCollections.reserve(fontCollectionsCount);
+        for (uint32_t i = 0; i < fontCollectionsCount && !reader->hasError(); i++) {
+            fontCollections.emplace_back(new FontCollection(reader, allFontFamilies));
+        }
+        if (reader->hasError()) {
+            return std::vector<std::shared_ptr<FontCollection>>();
+        }
+        return fontCollections;
+    }
+
     template <Font::TypefaceWriter typefaceWriter>
     static void writeVector(BufferWriter* writer,
                             const std::vector<std::shared_ptr<FontCollection>>& fontCollections) {
@@ -64,10 +89,17 @@ public:
         // Note: operator== for shared_ptr compares raw pointer values.
         std::unordered_map<std::shared_ptr<FontFamily>, uint32_t> fontFamilyToIndexMap;
         collectAllFontFamilies(fontCollections, &allFontFamilies, &fontFamilyToIndexMap);
+        // Families often share the coverage, e.g. the weights of a superfamily split into separate
+        // families. Write every distinct coverage once and refer to it by index.
+        SparseBitSetTableWriter coverageTable;
+        for (const auto& fontFamily : allFontFamilies) {
+            fontFamily->addCoveragesTo(&coverageTable);
+        }
+        coverageTable.writeTo(writer);
 
         writer->write<uint32_t>(allFontFamilies.size());
         for (const auto& fontFamily : allFontFamilies) {
-            fontFamily->writeTo<typefaceWriter>(writer);
+            fontFamily->writeTo<typefaceWriter>(writer, &coverageTable);
         }
         writer->write<uint32_t>(fontCollections.size());
         for (const auto& fontCollection : fontCollections) {
@@ -200,8 +232,10 @@ public:
 private:
     FRIEND_TEST(FontCollectionTest, bufferTest);
 
-    FontCollection(BufferReader* reader,
-                   const std::vector<std::shared_ptr<FontFamily>>& allFontFamilies);
+    template <typename Reader>
+    FontCollection(Reader* reader, const std::vector<std::shared_ptr<FontFamily>>& allFontFamilies);
+    // Returns true if all the page ranges and family indices read from the buffer are in range.
+    bool isValid() const;
     // Write fields of the instance, using fontFamilyToIndexMap for finding
     // indices for FontFamily.
     void writeTo(BufferWriter* writer,
@@ -227,6 +261,19 @@ private:
 
     // Initialize the FontCollection.
     void init(const std::vector<std::shared_ptr<FontFamily>>& typefaces);
+    // Initialize mFirstFontFamilies from mFamilies.
+    void initFirstFontFamilies();
+
+    // Returns the first family which gets kFirstFontScore for the character without variation
+    // selector, or an empty result if there is no such family.
+    FamilyMatchResult getFirstFontFamilyForChar(uint32_t ch) const {
+        for (uint8_t familyIndex : mFirstFontFamilies) {
+            if (mFamilies[familyIndex]->getCoverage().get(ch)) {
+                return FamilyMatchResult::Builder().add(familyIndex).build();
+            }
+        }
+        return FamilyMatchResult();
+    }
 
     FamilyMatchResult getFamilyForChar(uint32_t ch, uint32_t vs, uint32_t localeListId,
                                        FamilyVariant variant) const;
@@ -266,6 +313,11 @@ private:
     // This vector has pointers to the font family instances which have cmap 14 subtables.
     std::vector<std::shared_ptr<FontFamily>> mVSFamilyVec;
 
+    // Indices of the families which always win if they cover the character, i.e. the first family
+    // and the custom fallback families, in the order of mFamilies. Checking their coverage first
+    // skips the score calculation for the common case that the first family covers the text.
+    std::vector<uint8_t> mFirstFontFamilies;
+
     // Set of supported axes in this collection.
     std::unordered_set<AxisTag> mSupportedAxes;
 
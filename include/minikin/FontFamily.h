@@ -18,6 +18,7 @@
 #define MINIKIN_FONT_FAMILY_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -37,9 +38,19 @@ public:
     FontFamily(FamilyVariant variant, std::vector<std::shared_ptr<Font>>&& fonts);
     FontFamily(uint32_t localeListId, FamilyVariant variant,
                std::vector<std::shared_ptr<Font>>&& fonts, bool isCustomFallback);
+    // If isLazyCoverage is true, only a page level summary of the cmap coverage is computed at
+    // construction time. The full coverage is computed when it is first needed, e.g. when
+    // the family is looked up for a character. This is useful for fallback families which are
+    // rarely used.
+    FontFamily(uint32_t localeListId, FamilyVariant variant,
+               std::vector<std::shared_ptr<Font>>&& fonts, bool isCustomFallback,
+               bool isLazyCoverage);
 
+    // If coverageTable is not null, the coverages are read as indices to the table. The table must
+    // be the one read from the buffer written with the corresponding writer table.
     template <Font::TypefaceReader typefaceReader>
-    static std::shared_ptr<FontFamily> readFrom(BufferReader* reader) {
+    static std::shared_ptr<FontFamily> readFrom(
+            BufferReader* reader, const SparseBitSetTableReader* coverageTable = nullptr) {
         uint32_t localeListId = readLocaleListInternal(reader);
         uint32_t fontsCount = reader->read<uint32_t>();
         std::vector<std::shared_ptr<Font>> fonts;
@@ -47,19 +58,46 @@ public:
         for (uint32_t i = 0; i < fontsCount; i++) {
             fonts.emplace_back(Font::readFrom<typefaceReader>(reader, localeListId));
         }
-        return readFromInternal(reader, std::move(fonts), localeListId);
+        return readFromInternal(reader, std::move(fonts), localeListId, coverageTable);
+    }
+
+    // Returns nullptr and sets the error on the reader if the buffer is broken.
+    template <Font::CheckedTypefaceReader typefaceReader>
+    static std::shared_ptr<FontFamily> readFrom(
+            CheckedBufferReader* reader, const SparseBitSetTableReader* coverageTable = nullptr) {
+        uint32_t localeListId = readLocaleListInternal(reader);
+        uint32_t fontsCount = reader->readCount();
+        std::vector<std::shared_ptr<Font>> fonts;
+        fonts.reserve(fontsCount);
+        for (uint32_t i = 0; i < fontsCount; i++) {
+            std::shared_ptr<Font> font = Font::readFrom<typefaceReader>(reader, localeListId);
+            if (font == nullptr) return nullptr;
+            fonts.push_back(std::move(font));
+        }
+        if (fonts.empty()) {
+            reader->setError();
+            return nullptr;
+        }
+        return readFromInternal(reader, std::move(fonts), localeListId, coverageTable);
     }
 
+    // If coverageTable is not null, the coverages are written as indices to the table. They must
+    // have been added to the table with addCoveragesTo().
     template <Font::TypefaceWriter typefaceWriter>
-    void writeTo(BufferWriter* writer) const {
+    void writeTo(BufferWriter* writer,
+                 const SparseBitSetTableWriter* coverageTable = nullptr) const {
         writeLocaleListInternal(writer);
         writer->write<uint32_t>(mFonts.size());
         for (const std::shared_ptr<Font>& font : mFonts) {
             font->writeTo<typefaceWriter>(writer);
         }
-        writeToInternal(writer);
+        writeToInternal(writer, coverageTable);
     }
 
+    // Adds the cmap coverage and the variation sequence coverages to the table so that identical
+    // coverages of different families are serialized once.
+    void addCoveragesTo(SparseBitSetTableWriter* coverageTable) const;
+
     FakedFont getClosestMatch(FontStyle style) const;
 
     uint32_t localeListId() const { return mLocaleListId; }
@@ -73,16 +111,32 @@ public:
     bool isColorEmojiFamily() const { return mIsColorEmoji; }
     const std::unordered_set<AxisTag>& supportedAxes() const { return mSupportedAxes; }
     bool isCustomFallback() const { return mIsCustomFallback; }
+    bool isLazyCoverage() const { return mIsLazyCoverage; }
 
     // Get Unicode coverage.
-    const SparseBitSet& getCoverage() const { return mCoverage; }
+    const SparseBitSet& getCoverage() const {
+        ensureCoverage();
+        return mCoverage;
+    }
+
+    // Returns one more than the maximum covered code point, or zero if empty. For the lazy
+    // coverage family, this is rounded up to the page boundary and does not compute the full
+    // coverage.
+    uint32_t getCoverageLength() const;
+
+    // Returns the first covered code point at or after fromChar, or SparseBitSet::kNotFound. For
+    // the lazy coverage family, this returns the first code point of the next page that has any
+    // coverage instead, which is enough for building page based lookup tables.
+    uint32_t nextCoveredCharOrPage(uint32_t fromChar) const;
 
     // Returns true if the font has a glyph for the code point and variation selector pair.
     // Caller should acquire a lock before calling the method.
     bool hasGlyph(uint32_t codepoint, uint32_t variationSelector) const;
 
     // Returns true if this font family has a variaion sequence table (cmap format 14 subtable).
-    bool hasVSTable() const { return !mCmapFmt14Coverage.empty(); }
+    bool hasVSTable() const {
+        return mIsLazyCoverage ? mHasVSTableSummary : !mCmapFmt14Coverage.empty();
+    }
 
     // Creates new FontFamily based on this family while applying font variations. Returns nullptr
     // if none of variations apply to this family.
@@ -96,14 +150,25 @@ private:
                bool isCustomFallback, SparseBitSet&& coverage,
                std::vector<std::unique_ptr<SparseBitSet>>&& cmapFmt14Coverage);
 
-    static uint32_t readLocaleListInternal(BufferReader* reader);
-    static std::shared_ptr<FontFamily> readFromInternal(BufferReader* reader,
-                                                        std::vector<std::shared_ptr<Font>>&& fonts,
-                                                        uint32_t localeListId);
+    template <typename Reader>
+    static uint32_t readLocaleListInternal(Reader* reader);
+    template <typename Reader>
+    static std::shared_ptr<FontFamily> readFromInternal(
+            Reader* reader, std::vector<std::shared_ptr<Font>>&& fonts, uint32_t localeListId,
+            const SparseBitSetTableReader* coverageTable);
     void writeLocaleListInternal(BufferWriter* writer) const;
-    void writeToInternal(BufferWriter* writer) const;
+    void writeToInternal(BufferWriter* writer, const SparseBitSetTableWriter* coverageTable) const;
 
     void computeCoverage();
+    void computeCoverageSummary();
+    void computeCmapCoverage() const;
+    void computeSupportedAxes();
+
+    inline void ensureCoverage() const {
+        if (mIsLazyCoverage) {
+            std::call_once(mCoverageOnceFlag, &FontFamily::computeCmapCoverage, this);
+        }
+    }
 
     uint32_t mLocaleListId;
     FamilyVariant mVariant;
@@ -111,9 +176,17 @@ private:
     std::unordered_set<AxisTag> mSupportedAxes;
     bool mIsColorEmoji;
     bool mIsCustomFallback;
+    bool mIsLazyCoverage;
+
+    // Summary of the coverage, only used if mIsLazyCoverage is true. The set contains the page
+    // indices (code point >> CmapCoverage::kLogCharsPerPage) which have any coverage.
+    SparseBitSet mCoveragePages;
+    bool mHasVSTableSummary;
+    mutable std::once_flag mCoverageOnceFlag;
 
-    SparseBitSet mCoverage;
-    std::vector<std::unique_ptr<SparseBitSet>> mCmapFmt14Coverage;
+    // Lazy-initialized if mIsLazyCoverage is true.
+    mutable SparseBitSet mCoverage;
+    mutable std::vector<std::unique_ptr<SparseBitSet>> mCmapFmt14Coverage;
 
     MINIKIN_PREVENT_COPY_AND_ASSIGN(FontFamily);
 };
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FONT_MAP_FILE_H
+#define MINIKIN_FONT_MAP_FILE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "minikin/Buffer.h"
+#include "minikin/Font.h"
+#include "minikin/FontCollection.h"
+
+namespace minikin {
+
+// The container of the serialized font map, i.e. the output of FontCollection::writeVector, for
+// persisting it in a file.
+//
+// The layout is a fixed size header followed by the payload:
+//
+//   offset 0                  FontMapFileHeader
+//   offset kPayloadOffset     payload written by FontCollection::writeVector
+//
+// The payload is read in place with BufferReader, so the file can be mapped read-only by many
+// processes (see MappedFile) and shared without copying. All the values are in the native byte
+// order; a file written on a machine with a different byte order is rejected by the magic number
+// check.
+struct FontMapFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    // Offset of the payload from the start of the file.
+    uint32_t payloadOffset;
+    uint32_t payloadSize;
+    // Checksum of the payload. See FontMapFile::computeChecksum.
+    uint32_t checksum;
+    // Reserved for future use. Must be zero.
+    uint32_t reserved;
+};
+
+class FontMapFile {
+public:
+    static constexpr uint32_t kMagic = 0x4d464b4d;  // "MKFM" in little endian.
+    // Increment this when the serialized format of FontCollection or its members is changed.
+    static constexpr uint32_t kVersion = 2;
+    // The payload offset is aligned to this value so that the alignment done by BufferReader,
+    // which is relative to the payload start, is also valid for the absolute address.
+    static constexpr uint32_t kPayloadAlignment = 64;
+    static constexpr uint32_t kPayloadOffset =
+            (sizeof(FontMapFileHeader) + kPayloadAlignment - 1) / kPayloadAlignment *
+            kPayloadAlignment;
+    // The minimum alignment required for the address of the file contents.
+    static constexpr uint32_t kRequiredAlignment = 8;
+
+    // Writes the font map file contents to the buffer, and returns the number of bytes written.
+    // Passing nullptr only measures the required buffer size. The buffer must be aligned to
+    // kRequiredAlignment.
+    template <Font::TypefaceWriter typefaceWriter>
+    static size_t write(void* buffer,
+                        const std::vector<std::shared_ptr<FontCollection>>& fontCollections) {
+        uint8_t* payload =
+                buffer == nullptr ? nullptr : reinterpret_cast<uint8_t*>(buffer) + kPayloadOffset;
+        BufferWriter writer(payload);
+        FontCollection::writeVector<typefaceWriter>(&writer, fontCollections);
+        if (buffer != nullptr) {
+            writeHeader(buffer, writer.size());
+        }
+        return kPayloadOffset + writer.size();
+    }
+
+    // Returns the address of the payload if the data is a valid font map file of the current
+    // version. Otherwise returns nullptr.
+    // The checksum verification reads the whole payload. If the file was already verified, e.g. by
+    // the process which wrote it, verifyChecksum can be false to skip it.
+    static const void* getPayload(const void* data, size_t size, bool verifyChecksum);
+
+    // Reads font collections from the font map file contents. Returns an empty vector if the data
+    // is not a valid font map file. The payload is read with CheckedBufferReader, so a broken
+    // payload is rejected even if the checksum verification is skipped. The data must outlive the
+    // returned font collections.
+    template <Font::CheckedTypefaceReader typefaceReader>
+    static std::vector<std::shared_ptr<FontCollection>> readVector(const void* data, size_t size,
+                                                                   bool verifyChecksum) {
+        const void* payload = getPayload(data, size, verifyChecksum);
+        if (payload == nullptr) {
+            return std::vector<std::shared_ptr<FontCollection>>();
+        }
+        const FontMapFileHeader* header = reinterpret_cast<const FontMapFileHeader*>(data);
+        CheckedBufferReader reader(payload, header->payloadSize);
+        return FontCollection::readVector<typefaceReader>(&reader);
+    }
+
+    static uint32_t computeChecksum(const void* data, size_t size);
+
+private:
+    static void writeHeader(void* buffer, size_t payloadSize);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FONT_MAP_FILE_H
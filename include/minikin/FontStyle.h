@@ -48,9 +48,10 @@ public:
     constexpr FontStyle(Weight weight, Slant slant)
             : FontStyle(static_cast<uint16_t>(weight), slant) {}
     constexpr FontStyle(uint16_t weight, Slant slant) : mWeight(weight), mSlant(slant) {}
-    explicit FontStyle(BufferReader* reader) {
-        mWeight = reader->read<uint16_t>();
-        mSlant = static_cast<Slant>(reader->read<uint8_t>());
+    template <typename Policy>
+    explicit FontStyle(BasicBufferReader<Policy>* reader) {
+        mWeight = reader->template read<uint16_t>();
+        mSlant = static_cast<Slant>(reader->template read<uint8_t>());
     }
 
     void writeTo(BufferWriter* writer) const {
@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "minikin/Characters.h"
+#include "minikin/Range.h"
 #include "minikin/U16StringPiece.h"
 
 namespace minikin {
@@ -36,6 +37,12 @@ class Hyphenator;
 // In Android, the Hyphenator is allocated in Zygote and never gets released.
 void addHyphenator(const std::string& localeStr, const Hyphenator* hyphenator);
 void addHyphenatorAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr);
+// Registers the hyphenation patterns in the hyb file at the path, without reading the file.
+// The file is mapped read-only on the first lookup of the locale, so that the languages never used
+// don't take memory, and the mapped pages are shared with other processes using the same file.
+// If the file is missing or broken, the locale is hyphenated as if it was not registered.
+void addHyphenatorFile(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                       size_t minSuffix);
 
 enum class HyphenationType : uint8_t {
     // Note: There are implicit assumptions scattered in the code that DONT_BREAK is 0.
@@ -190,6 +197,24 @@ public:
         return hyphenate(word, out->data());
     }
 
+    // Compute the hyphenation of all the words of a paragraph at once, e.g. the word ranges given
+    // by WordBreaker. The hyphenation of each word is stored at the word's offsets in the
+    // paragraph, and the entries outside of the words are DONT_BREAK. The ranges must not overlap,
+    // and empty ones are skipped.
+    //
+    // out must have at least the length of the text.
+    void hyphenate(const U16StringPiece& text, const std::vector<Range>& words,
+                   HyphenationType* out) const;
+
+    // Compute the hyphenation of all the words of a paragraph at once.
+    //
+    // out will be resized to text length.
+    void hyphenate(const U16StringPiece& text, const std::vector<Range>& words,
+                   std::vector<HyphenationType>* out) const {
+        out->resize(text.size());
+        return hyphenate(text, words, out->data());
+    }
+
     // Returns true if the codepoint is like U+2010 HYPHEN in line breaking and usage: a character
     // immediately after which line breaks are allowed, but words containing it should not be
     // automatically hyphenated.
@@ -205,6 +230,17 @@ public:
     static Hyphenator* loadBinary(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                                   const std::string& locale);
 
+    // Returns true if the header of the data is known and all the tables it points to are within
+    // the given size, which catches truncated and foreign files. The contents of the tables, such
+    // as the trie links, the automaton states and the pattern offsets, are not validated and are
+    // trusted by loadBinary as before, so the data must come from a trusted hyb file. Only the
+    // headers of the tables and the page index of the alphabet are read, so it is cheap enough
+    // for mapped files.
+    static bool isValidBinary(const uint8_t* patternData, size_t size);
+
+    // Returns the unique ID of this hyphenator, which is never reused by another instance.
+    uint32_t getId() const { return mId; }
+
 private:
     enum class HyphenationLocale : uint8_t {
         OTHER = 0,
@@ -226,6 +262,11 @@ private:
     // Note that this method writes len+2 entries into alpha_codes (including start and stop)
     HyphenationType alphabetLookup(uint16_t* alpha_codes, const U16StringPiece& word) const;
 
+    // Hyphenates a word which failed alphabetLookup, after NFC normalization and with non-BMP
+    // characters looked up as code points. Hyphenation points are mapped back to the offsets of
+    // the original word. Returns false if the word still doesn't map to the alphabet.
+    bool hyphenateNormalized(const U16StringPiece& word, HyphenationType* out) const;
+
     // calculate hyphenation from patterns, assuming alphabet lookup has already been done
     void hyphenateFromCodes(const uint16_t* codes, size_t len, HyphenationType hyphenValue,
                             HyphenationType* out) const;
@@ -238,6 +279,7 @@ private:
     const uint8_t* mPatternData;
     const size_t mMinPrefix, mMinSuffix;
     const HyphenationLocale mHyphenationLocale;
+    const uint32_t mId;
 
     // accessors for binary data
     const Header* getHeader() const { return reinterpret_cast<const Header*>(mPatternData); }
@@ -31,6 +31,7 @@
 namespace minikin {
 
 class Layout;
+class LayoutPieceView;
 struct LayoutPieces;
 
 struct LayoutGlyph {
@@ -102,10 +103,14 @@ public:
 
     // Append another layout (for example, cached value) into this one
     void appendLayout(const LayoutPiece& src, size_t start, float extraAdvance);
+    void appendLayout(const LayoutPieceView& src, size_t start, float extraAdvance);
 
 private:
     FRIEND_TEST(LayoutTest, doLayoutWithPrecomputedPiecesTest);
 
+    template <typename Piece>
+    void appendLayoutPiece(const Piece& src, size_t start, float extraAdvance);
+
     void doLayout(const U16StringPiece& str, const Range& range, Bidi bidiFlags,
                   const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen);
 
@@ -61,11 +61,19 @@ public:
     const FakedFont& fontAt(int glyphPos) const { return mFonts[mFontIndices[glyphPos]]; }
     uint32_t glyphIdAt(int glyphPos) const { return mGlyphIds[glyphPos]; }
     const Point& pointAt(int glyphPos) const { return mPoints[glyphPos]; }
+    uint32_t advanceCount() const { return mAdvances.size(); }
+    float advanceAt(int pos) const { return mAdvances[pos]; }
+
+    // Returns true if the text can be split before the code unit at pos without changing the
+    // shaping result of either side, i.e. there is no kerning, ligature or joining across pos.
+    // The start of the piece is always safe.
+    bool isSafeToBreakAt(int pos) const { return mSafeToBreak[pos]; }
 
     uint32_t getMemoryUsage() const {
         return sizeof(uint8_t) * mFontIndices.size() + sizeof(uint32_t) * mGlyphIds.size() +
-               sizeof(Point) * mPoints.size() + sizeof(float) * mAdvances.size() + sizeof(float) +
-               sizeof(MinikinRect) + sizeof(MinikinExtent);
+               sizeof(Point) * mPoints.size() + sizeof(float) * mAdvances.size() +
+               (mSafeToBreak.size() + 7) / 8 + sizeof(float) + sizeof(MinikinRect) +
+               sizeof(MinikinExtent);
     }
 
 private:
@@ -75,7 +83,8 @@ private:
     std::vector<uint32_t> mGlyphIds;    // per glyph
     std::vector<Point> mPoints;         // per glyph
 
-    std::vector<float> mAdvances;  // per code units
+    std::vector<float> mAdvances;    // per code units
+    std::vector<bool> mSafeToBreak;  // per code units
 
     float mAdvance;
     MinikinExtent mExtent;
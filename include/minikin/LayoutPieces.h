@@ -17,28 +17,77 @@
 #ifndef MINIKIN_LAYOUT_PIECES_H
 #define MINIKIN_LAYOUT_PIECES_H
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "minikin/LayoutCache.h"
 #include "minikin/LayoutCore.h"
+#include "minikin/Macros.h"
 #include "minikin/MinikinPaint.h"
 
 namespace minikin {
 
+struct LayoutPieces;
+struct LazyLayoutPieces;
+
+// A layout piece stored in the pooled buffers of LayoutPieces. Has the same accessors as
+// LayoutPiece, so the compositors accept both.
+class LayoutPieceView {
+public:
+    LayoutPieceView(const LayoutPieces* pieces, uint32_t index) : mPieces(pieces), mIndex(index) {}
+
+    inline float advance() const;
+    inline const MinikinExtent& extent() const;
+
+    inline uint32_t glyphCount() const;
+    inline const FakedFont& fontAt(int glyphPos) const;
+    inline uint32_t glyphIdAt(int glyphPos) const;
+    inline const Point& pointAt(int glyphPos) const;
+    inline uint32_t advanceCount() const;
+    inline float advanceAt(int pos) const;
+
+private:
+    const LayoutPieces* mPieces;
+    uint32_t mIndex;
+};
+
+// The layout pieces of a paragraph. The glyphs of all the pieces are kept in shared buffers
+// instead of a LayoutPiece per piece. The pieces are indexed by a hash map while they are inserted
+// and by a sorted vector after compact(), which saves the memory of the hash map nodes.
 struct LayoutPieces {
     const static uint32_t kNoPaintId = static_cast<uint32_t>(-1);
 
+    // A piece is identified by the content of its context instead of the offsets in the
+    // paragraph, so that the pieces are still found after the text before them is edited.
     struct Key {
-        Key(const Range& range, HyphenEdit hyphenEdit, bool dir, uint32_t paintId)
-                : range(range), hyphenEdit(hyphenEdit), dir(dir), paintId(paintId) {}
+        Key(uint64_t contextHash, uint32_t contextLength, const Range& range,
+            HyphenEdit hyphenEdit, bool dir, uint32_t paintId)
+                : contextHash(contextHash),
+                  contextLength(contextLength),
+                  range(range),
+                  hyphenEdit(hyphenEdit),
+                  dir(dir),
+                  paintId(paintId) {}
+
+        Key(const U16StringPiece& textBuf, const Range& range, const Range& context,
+            HyphenEdit hyphenEdit, bool dir, uint32_t paintId)
+                : Key(hashText(textBuf.substr(context)), context.getLength(),
+                      range - context.getStart(), hyphenEdit, dir, paintId) {}
 
-        Range range;
+        uint64_t contextHash;
+        uint32_t contextLength;
+        Range range;  // Relative to the start of the context.
         HyphenEdit hyphenEdit;
         bool dir;
         uint32_t paintId;
 
         uint32_t hash() const {
             return Hasher()
+                    .update(contextHash)
+                    .update(contextLength)
                     .update(range.getStart())
                     .update(range.getEnd())
                     .update(hyphenEdit)
@@ -48,15 +97,44 @@ struct LayoutPieces {
         }
 
         bool operator==(const Key& o) const {
-            return range == o.range && hyphenEdit == o.hyphenEdit && dir == o.dir &&
+            return contextHash == o.contextHash && contextLength == o.contextLength &&
+                   range == o.range && hyphenEdit == o.hyphenEdit && dir == o.dir &&
                    paintId == o.paintId;
         }
 
+        bool operator<(const Key& o) const {
+            if (contextHash != o.contextHash) return contextHash < o.contextHash;
+            if (contextLength != o.contextLength) return contextLength < o.contextLength;
+            if (range.getStart() != o.range.getStart()) {
+                return range.getStart() < o.range.getStart();
+            }
+            if (range.getEnd() != o.range.getEnd()) return range.getEnd() < o.range.getEnd();
+            if (hyphenEdit != o.hyphenEdit) return hyphenEdit < o.hyphenEdit;
+            if (dir != o.dir) return dir < o.dir;
+            return paintId < o.paintId;
+        }
+
         uint32_t getMemoryUsage() const {
-            return sizeof(Range) + sizeof(HyphenEdit) + sizeof(bool) + sizeof(uint32_t);
+            return sizeof(uint64_t) + sizeof(uint32_t) + sizeof(Range) + sizeof(HyphenEdit) +
+                   sizeof(bool) + sizeof(uint32_t);
         }
     };
 
+    // 64-bit FNV-1a hash of the text. The key does not keep the text itself, so the hash is wider
+    // than the one of the LayoutCache to make collisions negligible. A collision would make a piece
+    // take the glyphs of another context of the same length, shaped for the same paint, direction
+    // and relative range. This is accepted instead of keeping the context text of every piece:
+    // the chance is about n^2 / 2^65 for n distinct contexts, and the contexts which are compared
+    // all come from the same paragraph or its hint, so a crafted collision only changes how a text
+    // is drawn into another text the same author could have written directly.
+    static uint64_t hashText(const U16StringPiece& text) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (uint32_t i = 0; i < text.size(); i++) {
+            hash = (hash ^ text[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
     struct KeyHasher {
         std::size_t operator()(const Key& key) const { return key.hash(); }
     };
@@ -65,55 +143,312 @@ struct LayoutPieces {
         std::size_t operator()(const MinikinPaint& paint) const { return paint.hash(); }
     };
 
+    // The location of a piece in the shared buffers.
+    struct Entry {
+        uint32_t glyphStart;
+        uint32_t glyphCount;
+        uint32_t advanceStart;
+        uint32_t advanceCount;
+        uint32_t fontStart;  // fontIndices are relative to this.
+        // The context in the text the piece was first inserted for. Only used to drop the pieces
+        // of the edited text in merge().
+        Range context;
+        float advance;
+        MinikinExtent extent;
+    };
+
     LayoutPieces() : nextPaintId(0) {}
-    ~LayoutPieces() {}
+    inline ~LayoutPieces();
+    LayoutPieces(LayoutPieces&&) = default;
+    LayoutPieces& operator=(LayoutPieces&&) = default;
 
     uint32_t nextPaintId;
     std::unordered_map<MinikinPaint, uint32_t, PaintHasher> paintMap;
-    std::unordered_map<Key, LayoutPiece, KeyHasher> offsetMap;
 
-    void insert(const Range& range, HyphenEdit edit, const LayoutPiece& layout, bool dir,
-                const MinikinPaint& paint) {
+    // The entry indices of the pieces inserted after the last compact().
+    std::unordered_map<Key, uint32_t, KeyHasher> offsetMap;
+    // The entry indices of the compacted pieces, sorted by key.
+    std::vector<std::pair<Key, uint32_t>> sortedKeys;
+
+    std::vector<Entry> entries;
+    std::vector<uint8_t> fontIndices;  // per glyph
+    std::vector<uint32_t> glyphIds;    // per glyph
+    std::vector<Point> points;         // per glyph
+    std::vector<float> advances;       // per code unit
+    std::vector<FakedFont> fonts;      // per piece
+
+    // The pieces shaped on demand by getOrCreate, see enableLazyLayout().
+    std::unique_ptr<LazyLayoutPieces> lazyPieces;
+
+    // Accepts both LayoutPiece and LayoutPieceView.
+    template <typename Piece>
+    void insert(const U16StringPiece& textBuf, const Range& range, const Range& context,
+                HyphenEdit edit, const Piece& layout, bool dir, const MinikinPaint& paint) {
+        insert(textBuf, range, context, edit, layout, dir, paint, 0 /* textOffset */);
+    }
+
+    // Same as above, for a piece measured on a part of the paragraph, which starts at textOffset.
+    // The piece is keyed by its content, and its context is recorded in the paragraph.
+    template <typename Piece>
+    void insert(const U16StringPiece& textBuf, const Range& range, const Range& context,
+                HyphenEdit edit, const Piece& layout, bool dir, const MinikinPaint& paint,
+                uint32_t textOffset) {
+        insert(Key(textBuf, range, context, edit, dir, addPaint(paint)), context + textOffset,
+               layout);
+    }
+
+    // Returns the paint ID of the paint, assigning a new one if the paint is not known yet.
+    uint32_t addPaint(const MinikinPaint& paint) {
         uint32_t paintId = findPaintId(paint);
         if (paintId == kNoPaintId) {
             paintId = nextPaintId++;
             paintMap.insert(std::make_pair(paint, paintId));
         }
-        offsetMap.emplace(std::piecewise_construct,
-                          std::forward_as_tuple(range, edit, dir, paintId),
-                          std::forward_as_tuple(layout));
+        return paintId;
     }
 
+    // Makes getOrCreate keep the pieces it shapes on a miss, up to maxPieceCount pieces. When the
+    // limit is reached, the kept pieces are dropped and the retention starts over. The paints
+    // must be registered with addPaint so that the pieces get keys.
+    inline void enableLazyLayout(uint32_t maxPieceCount);
+
     template <typename F>
     void getOrCreate(const U16StringPiece& textBuf, const Range& range, const Range& context,
                      const MinikinPaint& paint, bool dir, StartHyphenEdit startEdit,
                      EndHyphenEdit endEdit, uint32_t paintId, F& f) const {
         const HyphenEdit edit = packHyphenEdit(startEdit, endEdit);
-        auto it = offsetMap.find(Key(range, edit, dir, paintId));
-        if (it == offsetMap.end()) {
+        const Key key(textBuf, range, context, edit, dir, paintId);
+        const uint32_t index = find(key);
+        if (index != kNotFound) {
+            f(LayoutPieceView(this, index), paint);
+        } else if (lazyPieces == nullptr || paintId == kNoPaintId) {
             LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
                                                    range - context.getStart(), paint, dir,
                                                    startEdit, endEdit, f);
         } else {
-            f(it->second, paint);
+            getOrCreateLazily(key, textBuf, range, context, paint, dir, startEdit, endEdit, f);
         }
     }
 
+    // Inserts all the pieces of other into this. The paint IDs of other are assigned in their
+    // original order, so merging the same sequence of pieces gives the same result.
+    void merge(const LayoutPieces& other) {
+        merge(other, [](const Key& /* key */, Range* /* context */) { return true; });
+    }
+
+    // Same as merge, but only inserts the pieces for which filter(key, &context) returns true. The
+    // filter may move the context of the piece, e.g. when the text before it was edited.
+    template <typename Filter>
+    void merge(const LayoutPieces& other, Filter filter) {
+        std::vector<const MinikinPaint*> paints(other.nextPaintId, nullptr);
+        for (const auto& [paint, paintId] : other.paintMap) {
+            paints[paintId] = &paint;
+        }
+        std::vector<uint32_t> paintIds(other.nextPaintId, kNoPaintId);
+        for (uint32_t i = 0; i < paints.size(); i++) {
+            if (paints[i] == nullptr) continue;
+            paintIds[i] = findPaintId(*paints[i]);
+            if (paintIds[i] == kNoPaintId) {
+                paintIds[i] = nextPaintId++;
+                paintMap.insert(std::make_pair(*paints[i], paintIds[i]));
+            }
+        }
+        auto mergePiece = [&](const Key& key, uint32_t index) {
+            Range context = other.entries[index].context;
+            if (!filter(key, &context)) {
+                return;
+            }
+            insert(Key(key.contextHash, key.contextLength, key.range, key.hyphenEdit, key.dir,
+                       paintIds[key.paintId]),
+                   context, LayoutPieceView(&other, index));
+        };
+        for (const auto& [key, index] : other.sortedKeys) {
+            mergePiece(key, index);
+        }
+        for (const auto& [key, index] : other.offsetMap) {
+            mergePiece(key, index);
+        }
+    }
+
+    // Moves the pieces inserted so far to the sorted vector, and releases the hash map and the
+    // unused capacity of the buffers. Called once the pieces are not going to change.
+    void compact() {
+        if (offsetMap.empty()) {
+            return;
+        }
+        sortedKeys.reserve(sortedKeys.size() + offsetMap.size());
+        sortedKeys.insert(sortedKeys.end(), offsetMap.begin(), offsetMap.end());
+        std::sort(sortedKeys.begin(), sortedKeys.end(),
+                  [](const auto& l, const auto& r) { return l.first < r.first; });
+        std::unordered_map<Key, uint32_t, KeyHasher>().swap(offsetMap);
+        sortedKeys.shrink_to_fit();
+        entries.shrink_to_fit();
+        fontIndices.shrink_to_fit();
+        glyphIds.shrink_to_fit();
+        points.shrink_to_fit();
+        advances.shrink_to_fit();
+        fonts.shrink_to_fit();
+    }
+
+    uint32_t size() const { return sortedKeys.size() + offsetMap.size(); }
+
+    static constexpr uint32_t kNotFound = static_cast<uint32_t>(-1);
+
+    // Returns the entry index of the piece, or kNotFound.
+    uint32_t find(const Key& key) const {
+        auto it = offsetMap.find(key);
+        if (it != offsetMap.end()) {
+            return it->second;
+        }
+        auto sortedIt = std::lower_bound(
+                sortedKeys.begin(), sortedKeys.end(), key,
+                [](const std::pair<Key, uint32_t>& l, const Key& r) { return l.first < r; });
+        if (sortedIt != sortedKeys.end() && sortedIt->first == key) {
+            return sortedIt->second;
+        }
+        return kNotFound;
+    }
+
     uint32_t findPaintId(const MinikinPaint& paint) const {
         auto paintIt = paintMap.find(paint);
         return paintIt == paintMap.end() ? kNoPaintId : paintIt->second;
     }
 
     uint32_t getMemoryUsage() const {
-        uint32_t result = 0;
-        for (const auto& i : offsetMap) {
-            result += i.first.getMemoryUsage() + i.second.getMemoryUsage();
-        }
+        uint32_t result = (Key(0, 0, Range(), 0, false, 0).getMemoryUsage() + sizeof(uint32_t)) *
+                          size();
+        result += sizeof(Entry) * entries.size() + sizeof(uint8_t) * fontIndices.size() +
+                  sizeof(uint32_t) * glyphIds.size() + sizeof(Point) * points.size() +
+                  sizeof(float) * advances.size() + sizeof(FakedFont) * fonts.size();
         result += (sizeof(MinikinPaint) + sizeof(uint32_t)) * paintMap.size();
-        return result;
+        return result + getLazyMemoryUsage();
     }
+
+private:
+    template <typename F>
+    inline void getOrCreateLazily(const Key& key, const U16StringPiece& textBuf,
+                                  const Range& range, const Range& context,
+                                  const MinikinPaint& paint, bool dir, StartHyphenEdit startEdit,
+                                  EndHyphenEdit endEdit, F& f) const;
+
+    inline uint32_t getLazyMemoryUsage() const;
+
+    template <typename Piece>
+    void insert(const Key& key, const Range& context, const Piece& layout) {
+        if (find(key) != kNotFound) {
+            return;
+        }
+        Entry entry;
+        entry.glyphStart = glyphIds.size();
+        entry.glyphCount = layout.glyphCount();
+        entry.advanceStart = advances.size();
+        entry.advanceCount = layout.advanceCount();
+        entry.fontStart = fonts.size();
+        entry.context = context;
+        entry.advance = layout.advance();
+        entry.extent = layout.extent();
+        for (uint32_t i = 0; i < layout.glyphCount(); i++) {
+            const FakedFont& font = layout.fontAt(i);
+            uint32_t fontIndex = entry.fontStart;
+            while (fontIndex < fonts.size() && fonts[fontIndex] != font) {
+                fontIndex++;
+            }
+            if (fontIndex == fonts.size()) {
+                fonts.push_back(font);
+            }
+            fontIndices.push_back(fontIndex - entry.fontStart);
+            glyphIds.push_back(layout.glyphIdAt(i));
+            points.push_back(layout.pointAt(i));
+        }
+        for (uint32_t i = 0; i < layout.advanceCount(); i++) {
+            advances.push_back(layout.advanceAt(i));
+        }
+        offsetMap.emplace(key, entries.size());
+        entries.push_back(entry);
+    }
+};
+
+// The pieces kept by the lazy layout of LayoutPieces. The lock makes the lookups of a const
+// MeasuredText safe from multiple threads.
+struct LazyLayoutPieces {
+    explicit LazyLayoutPieces(uint32_t maxPieceCount) : maxPieceCount(maxPieceCount) {}
+
+    std::mutex mutex;
+    LayoutPieces pieces GUARDED_BY(mutex);
+    const uint32_t maxPieceCount;
 };
 
+inline LayoutPieces::~LayoutPieces() {}
+
+inline void LayoutPieces::enableLazyLayout(uint32_t maxPieceCount) {
+    lazyPieces = std::make_unique<LazyLayoutPieces>(maxPieceCount);
+}
+
+template <typename F>
+inline void LayoutPieces::getOrCreateLazily(const Key& key, const U16StringPiece& textBuf,
+                                            const Range& range, const Range& context,
+                                            const MinikinPaint& paint, bool dir,
+                                            StartHyphenEdit startEdit, EndHyphenEdit endEdit,
+                                            F& f) const {
+    std::lock_guard<std::mutex> lock(lazyPieces->mutex);
+    LayoutPieces& pieces = lazyPieces->pieces;
+    const uint32_t index = pieces.find(key);
+    if (index != kNotFound) {
+        f(LayoutPieceView(&pieces, index), paint);
+        return;
+    }
+    if (pieces.size() >= lazyPieces->maxPieceCount) {
+        pieces = LayoutPieces();
+    }
+    auto insertAndCall = [&](const LayoutPiece& layout, const MinikinPaint& layoutPaint) {
+        pieces.insert(key, context, layout);
+        f(layout, layoutPaint);
+    };
+    LayoutCache::getInstance().getOrCreate(textBuf.substr(context), range - context.getStart(),
+                                           paint, dir, startEdit, endEdit, insertAndCall);
+}
+
+inline uint32_t LayoutPieces::getLazyMemoryUsage() const {
+    if (lazyPieces == nullptr) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(lazyPieces->mutex);
+    return lazyPieces->pieces.getMemoryUsage();
+}
+
+inline float LayoutPieceView::advance() const {
+    return mPieces->entries[mIndex].advance;
+}
+
+inline const MinikinExtent& LayoutPieceView::extent() const {
+    return mPieces->entries[mIndex].extent;
+}
+
+inline uint32_t LayoutPieceView::glyphCount() const {
+    return mPieces->entries[mIndex].glyphCount;
+}
+
+inline const FakedFont& LayoutPieceView::fontAt(int glyphPos) const {
+    const LayoutPieces::Entry& entry = mPieces->entries[mIndex];
+    return mPieces->fonts[entry.fontStart + mPieces->fontIndices[entry.glyphStart + glyphPos]];
+}
+
+inline uint32_t LayoutPieceView::glyphIdAt(int glyphPos) const {
+    return mPieces->glyphIds[mPieces->entries[mIndex].glyphStart + glyphPos];
+}
+
+inline const Point& LayoutPieceView::pointAt(int glyphPos) const {
+    return mPieces->points[mPieces->entries[mIndex].glyphStart + glyphPos];
+}
+
+inline uint32_t LayoutPieceView::advanceCount() const {
+    return mPieces->entries[mIndex].advanceCount;
+}
+
+inline float LayoutPieceView::advanceAt(int pos) const {
+    return mPieces->advances[mPieces->entries[mIndex].advanceStart + pos];
+}
+
 }  // namespace minikin
 
 #endif  // MINIKIN_LAYOUT_PIECES_H
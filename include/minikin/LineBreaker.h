@@ -23,6 +23,7 @@
 #define MINIKIN_LINE_BREAKER_H
 
 #include <deque>
+#include <functional>
 #include <vector>
 
 #include "minikin/FontCollection.h"
@@ -120,6 +121,20 @@ LineBreakResult breakIntoLines(const U16StringPiece& textBuffer, BreakStrategy s
                                const MeasuredText& measuredText, const LineWidth& lineWidth,
                                const TabStops& tabStops);
 
+// Breaks a paragraph into lines with the greedy strategy, measuring one chunk of about chunkLength
+// characters at a time instead of the whole paragraph. This is for very long paragraphs, e.g. logs
+// or books without line feeds, since only the widths of one chunk are kept at a time and the first
+// lines are available before the whole paragraph is measured.
+//
+// The chunks are built with MeasuredTextBuilder::buildRange from the style runs in builder. If a
+// run in a chunk can not be split, the rest of the lines are broken from the whole paragraph. The
+// lines are passed to onLines as soon as they are final, in the paragraph order and with offsets
+// in the paragraph.
+void breakIntoLinesInChunks(const U16StringPiece& textBuffer, const MeasuredTextBuilder& builder,
+                            HyphenationFrequency frequency, const LineWidth& lineWidth,
+                            const TabStops& tabStops, uint32_t chunkLength,
+                            const std::function<void(LineBreakResult&&)>& onLines);
+
 }  // namespace minikin
 
 #endif  // MINIKIN_LINE_BREAKER_H
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_MAPPED_FILE_H
+#define MINIKIN_MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// A read-only shared memory mapping of a whole file. The mapped pages are backed by the page cache,
+// so all the processes mapping the same file share the same physical memory.
+class MappedFile {
+public:
+    // Maps the file at the given path. Returns nullptr if the file can not be opened or mapped,
+    // or if it is empty.
+    static std::unique_ptr<MappedFile> open(const std::string& path);
+
+    ~MappedFile();
+
+    // The mapped address is aligned to the page size.
+    const void* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    MappedFile(void* data, size_t size) : mData(data), mSize(size) {}
+
+    void* mData;
+    size_t mSize;
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(MappedFile);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_MAPPED_FILE_H
@@ -30,6 +30,21 @@
 
 namespace minikin {
 
+// A hyphenation point of a word, at which Run::measureHyphenPieces splits the word.
+struct HyphenSplit {
+    // The split offset.
+    uint32_t offset;
+
+    // The edit at the start of the second piece.
+    StartHyphenEdit startHyphen;
+
+    // The edit at the end of the first piece.
+    EndHyphenEdit endHyphen;
+
+    HyphenSplit(uint32_t offset, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen)
+            : offset(offset), startHyphen(startHyphen), endHyphen(endHyphen) {}
+};
+
 class Run {
 public:
     Run(const Range& range) : mRange(range) {}
@@ -48,6 +63,15 @@ public:
     virtual void getMetrics(const U16StringPiece& text, std::vector<float>* advances,
                             LayoutPieces* precomputed, LayoutPieces* outPieces) const = 0;
 
+    // Same as getMetrics but only for the characters in the range. The range is in this run and
+    // starts and ends at the word breaks used for splitting layouts, see LayoutSplitter. The
+    // default implementation measures the whole run.
+    virtual void getMetricsInRange(const U16StringPiece& text, const Range& /* range */,
+                                   std::vector<float>* advances, LayoutPieces* precomputed,
+                                   LayoutPieces* outPieces) const {
+        getMetrics(text, advances, precomputed, outPieces);
+    }
+
     virtual std::pair<float, MinikinRect> getBounds(const U16StringPiece& text, const Range& range,
                                                     const LayoutPieces& pieces) const = 0;
     virtual MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
@@ -75,9 +99,46 @@ public:
         return 0.0;
     }
 
+    // Measures the two hyphenation pieces made by splitting the range at each of the splits: the
+    // first one ends with the split's endHyphen and the second one starts with its startHyphen.
+    // Returns the pairs of widths in the order of splits. The default implementation measures
+    // each piece with measureHyphenPiece.
+    virtual std::vector<std::pair<float, float>> measureHyphenPieces(
+            const U16StringPiece& text, const Range& range, const std::vector<HyphenSplit>& splits,
+            LayoutPieces* pieces) const {
+        std::vector<std::pair<float, float>> widths;
+        widths.reserve(splits.size());
+        for (const HyphenSplit& split : splits) {
+            widths.push_back(measureHyphenSplit(text, range, split, pieces));
+        }
+        return widths;
+    }
+
+    // Creates a run for the part of this run in the range, with the offsets relative to origin.
+    // Used for measuring a paragraph a chunk at a time. Returns nullptr if the run can not be
+    // split, which is the default.
+    virtual std::unique_ptr<Run> createSubRun(const Range& /* range */,
+                                              uint32_t /* origin */) const {
+        return nullptr;
+    }
+
     inline const Range& getRange() const { return mRange; }
 
 protected:
+    // Measures the two hyphenation pieces of a split with measureHyphenPiece.
+    std::pair<float, float> measureHyphenSplit(const U16StringPiece& text, const Range& range,
+                                               const HyphenSplit& split,
+                                               LayoutPieces* pieces) const {
+        const auto [firstRange, secondRange] = range.split(split.offset);
+        const U16StringPiece firstText = text.substr(firstRange);
+        const U16StringPiece secondText = text.substr(secondRange);
+        return std::make_pair(
+                measureHyphenPiece(firstText, Range(0, firstText.size()),
+                                   StartHyphenEdit::NO_EDIT, split.endHyphen, pieces),
+                measureHyphenPiece(secondText, Range(0, secondText.size()), split.startHyphen,
+                                   EndHyphenEdit::NO_EDIT, pieces));
+    }
+
     const Range mRange;
 };
 
@@ -90,9 +151,17 @@ public:
     uint32_t getLocaleListId() const override { return mPaint.localeListId; }
     bool isRtl() const override { return mIsRtl; }
 
+    std::unique_ptr<Run> createSubRun(const Range& range, uint32_t origin) const override {
+        return std::make_unique<StyleRun>(range - origin, MinikinPaint(mPaint), mIsRtl);
+    }
+
     void getMetrics(const U16StringPiece& text, std::vector<float>* advances,
                     LayoutPieces* precomputed, LayoutPieces* outPieces) const override;
 
+    void getMetricsInRange(const U16StringPiece& text, const Range& range,
+                           std::vector<float>* advances, LayoutPieces* precomputed,
+                           LayoutPieces* outPieces) const override;
+
     std::pair<float, MinikinRect> getBounds(const U16StringPiece& text, const Range& range,
                                             const LayoutPieces& pieces) const override;
 
@@ -110,7 +179,20 @@ public:
                              StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                              LayoutPieces* pieces) const override;
 
+    // Unless the hyphenated pieces need to be kept in pieces, derives the widths from the cluster
+    // advances of the whole range, collected once for all the splits, where shaping is context
+    // free at the split, and only shapes the clusters touching the hyphens.
+    std::vector<std::pair<float, float>> measureHyphenPieces(const U16StringPiece& text,
+                                                             const Range& range,
+                                                             const std::vector<HyphenSplit>& splits,
+                                                             LayoutPieces* pieces) const override;
+
 private:
+    // Same as measureHyphenPiece, for text starting at textOffset in the paragraph.
+    float measureHyphenPiece(const U16StringPiece& text, uint32_t textOffset, const Range& range,
+                             StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                             LayoutPieces* pieces) const;
+
     MinikinPaint mPaint;
     const bool mIsRtl;
 };
@@ -124,6 +206,12 @@ public:
     bool canBreak() const { return false; }
     uint32_t getLocaleListId() const { return mLocaleListId; }
 
+    std::unique_ptr<Run> createSubRun(const Range& range, uint32_t origin) const override {
+        // The width is put on the first character of the run.
+        const float width = range.getStart() == mRange.getStart() ? mWidth : 0;
+        return std::make_unique<ReplacementRun>(range - origin, width, mLocaleListId);
+    }
+
     void getMetrics(const U16StringPiece& /* text */, std::vector<float>* advances,
                     LayoutPieces* /* precomputed */, LayoutPieces* /* outPieces */) const override {
         (*advances)[mRange.getStart()] = mWidth;
@@ -171,6 +259,33 @@ struct HyphenBreak {
             : offset(offset), type(type), first(first), second(second) {}
 };
 
+// Represents a word break point, precomputed for the line breakers.
+struct WordBreakPoint {
+    // The break offset.
+    uint32_t offset;
+
+    // The word before the break, used as the hyphenation target.
+    Range wordRange;
+
+    // The penalty multiplier of the break, which is non-zero inside an email address or URL.
+    int breakBadness;
+
+    // True if this is the first break after a locale change, where the word breaker restarts.
+    bool isLocaleStart;
+
+    // True if the break is in an email address or URL, or at its end, where the word breaker does
+    // not restart at a locale change.
+    bool inEmailOrUrl;
+
+    WordBreakPoint(uint32_t offset, const Range& wordRange, int breakBadness, bool isLocaleStart,
+                   bool inEmailOrUrl)
+            : offset(offset),
+              wordRange(wordRange),
+              breakBadness(breakBadness),
+              isLocaleStart(isLocaleStart),
+              inEmailOrUrl(inEmailOrUrl) {}
+};
+
 class MeasuredText {
 public:
     // Character widths.
@@ -182,13 +297,18 @@ public:
     // The style information.
     std::vector<std::unique_ptr<Run>> runs;
 
-    // The copied layout pieces for construcing final layouts.
+    // Word break points in the order the line breakers visit them. Empty unless built with
+    // MeasuredTextBuilder::buildWithWordBreaks, in which case the line breakers use them instead
+    // of iterating the word breaks with ICU.
+    std::vector<WordBreakPoint> wordBreaks;
+
+    // The copied layout pieces for construcing final layouts. Compacted after the measurement.
     // TODO: Stop assigning width/extents if layout pieces are available for reducing memory impact.
     LayoutPieces layoutPieces;
 
     uint32_t getMemoryUsage() const {
         return sizeof(float) * widths.size() + sizeof(HyphenBreak) * hyphenBreaks.size() +
-               layoutPieces.getMemoryUsage();
+               sizeof(WordBreakPoint) * wordBreaks.size() + layoutPieces.getMemoryUsage();
     }
 
     Layout buildLayout(const U16StringPiece& textBuf, const Range& range, const Range& contextRange,
@@ -206,13 +326,43 @@ private:
     friend class MeasuredTextBuilder;
 
     void measure(const U16StringPiece& textBuf, bool computeHyphenation, bool computeLayout,
-                 MeasuredText* hint);
+                 MeasuredText* hint, uint32_t threadCount);
+    void measureInParallel(const U16StringPiece& textBuf, bool computeHyphenation,
+                           bool computeLayout, MeasuredText* hint, uint32_t threadCount);
+    void remeasure(const U16StringPiece& textBuf, bool computeHyphenation, bool computeLayout,
+                   const MeasuredText& previous, const Range& editRange, uint32_t newLength);
+    Range rehyphenate(const U16StringPiece& textBuf, const MeasuredText& previous,
+                      const Range& dirtyRange, int32_t delta, LayoutPieces* piecesOut);
+    void computeWordBreaks(const U16StringPiece& textBuf);
+
+    void enableLazyLayout(uint32_t maxLayoutPieceCount) {
+        for (const auto& run : runs) {
+            if (run->getPaint() != nullptr) {
+                layoutPieces.addPaint(*run->getPaint());
+            }
+        }
+        layoutPieces.enableLazyLayout(maxLayoutPieceCount);
+    }
 
     // Use MeasuredTextBuilder instead.
     MeasuredText(const U16StringPiece& textBuf, std::vector<std::unique_ptr<Run>>&& runs,
-                 bool computeHyphenation, bool computeLayout, MeasuredText* hint)
+                 bool computeHyphenation, bool computeLayout, MeasuredText* hint,
+                 uint32_t threadCount)
             : widths(textBuf.size()), runs(std::move(runs)) {
-        measure(textBuf, computeHyphenation, computeLayout, hint);
+        measure(textBuf, computeHyphenation, computeLayout, hint, threadCount);
+        layoutPieces.compact();
+    }
+
+    // Use MeasuredTextBuilder instead.
+    MeasuredText(const U16StringPiece& textBuf, std::vector<std::unique_ptr<Run>>&& runs,
+                 bool computeHyphenation, bool computeLayout, const MeasuredText& previous,
+                 const Range& editRange, uint32_t newLength)
+            : runs(std::move(runs)) {
+        remeasure(textBuf, computeHyphenation, computeLayout, previous, editRange, newLength);
+        if (!previous.wordBreaks.empty()) {
+            computeWordBreaks(textBuf);
+        }
+        layoutPieces.compact();
     }
 };
 
@@ -234,11 +384,70 @@ public:
         mRuns.emplace_back(std::make_unique<T>(std::forward<Args>(args)...));
     }
 
+    // If threadCount is larger than one, the runs are shaped and the hyphenation points are
+    // measured on up to threadCount threads. The result is identical to the single thread
+    // measurement. Custom runs must support concurrent getMetrics and measureHyphenPiece calls in
+    // this case.
     std::unique_ptr<MeasuredText> build(const U16StringPiece& textBuf, bool computeHyphenation,
-                                        bool computeLayout, MeasuredText* hint) {
+                                        bool computeLayout, MeasuredText* hint,
+                                        uint32_t threadCount = 1) {
         // Unable to use make_unique here since make_unique is not a friend of MeasuredText.
         return std::unique_ptr<MeasuredText>(new MeasuredText(
-                textBuf, std::move(mRuns), computeHyphenation, computeLayout, hint));
+                textBuf, std::move(mRuns), computeHyphenation, computeLayout, hint, threadCount));
+    }
+
+    // Builds the MeasuredText of the part of the text in the range, with the offsets relative to
+    // the start of the range. The runs are kept in this builder, so that the other parts of the
+    // text can be built later, and must outlive the result. Returns nullptr if a run in the range
+    // does not support Run::createSubRun, unless the range starts at 0 and contains the whole run.
+    // Thus the whole text can always be built.
+    std::unique_ptr<MeasuredText> buildRange(const U16StringPiece& textBuf, const Range& range,
+                                             bool computeHyphenation, bool computeLayout) const;
+
+    static constexpr uint32_t kDefaultMaxLazyLayoutPieceCount = 512;
+
+    // Same as build with computeLayout = false, but the layout pieces shaped by the first
+    // buildLayout, getBounds or getExtent of a range are kept in the MeasuredText, up to
+    // maxLayoutPieceCount pieces. A paragraph which is never drawn costs no glyph memory.
+    std::unique_ptr<MeasuredText> buildWithLazyLayout(
+            const U16StringPiece& textBuf, bool computeHyphenation, MeasuredText* hint,
+            uint32_t maxLayoutPieceCount = kDefaultMaxLazyLayoutPieceCount) {
+        std::unique_ptr<MeasuredText> result =
+                build(textBuf, computeHyphenation, false /* computeLayout */, hint);
+        result->enableLazyLayout(maxLayoutPieceCount);
+        return result;
+    }
+
+    // Same as build, but the word break points are also computed and kept in the MeasuredText, so
+    // that breaking the text into lines again, e.g. for a new width, doesn't iterate the word
+    // breaks with ICU.
+    std::unique_ptr<MeasuredText> buildWithWordBreaks(const U16StringPiece& textBuf,
+                                                      bool computeHyphenation, bool computeLayout,
+                                                      MeasuredText* hint,
+                                                      uint32_t threadCount = 1) {
+        std::unique_ptr<MeasuredText> result =
+                build(textBuf, computeHyphenation, computeLayout, hint, threadCount);
+        result->computeWordBreaks(textBuf);
+        return result;
+    }
+
+    // Builds the MeasuredText of the text after an edit, reusing the measurement of the text
+    // before the edit. The characters in editRange of the previous text were replaced with
+    // newLength characters. Only the words around the edit are shaped and hyphenated again, the
+    // rest of widths and hyphenBreaks is copied from previous with shifted offsets. The
+    // layoutPieces of previous are copied since they do not depend on the offsets. If previous
+    // has word break points, they are computed again for the whole text.
+    //
+    // The style runs added to this builder must be the same as the ones of previous outside of the
+    // edited range, after shifting by the length difference, and computeHyphenation and
+    // computeLayout must be the same as the ones previous was built with.
+    std::unique_ptr<MeasuredText> buildAfterEdit(const U16StringPiece& textBuf,
+                                                 bool computeHyphenation, bool computeLayout,
+                                                 const MeasuredText& previous,
+                                                 const Range& editRange, uint32_t newLength) {
+        return std::unique_ptr<MeasuredText>(
+                new MeasuredText(textBuf, std::move(mRuns), computeHyphenation, computeLayout,
+                                 previous, editRange, newLength));
     }
 
     MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(MeasuredTextBuilder);
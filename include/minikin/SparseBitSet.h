@@ -18,9 +18,13 @@
 #define MINIKIN_SPARSE_BIT_SET_H
 
 #include <minikin/Buffer.h>
+#include <minikin/Macros.h>
 #include <sys/types.h>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // ---------------------------------------------------------------------------
 
@@ -43,7 +47,11 @@ public:
         initFromRanges(ranges, nRanges);
     }
 
-    explicit SparseBitSet(BufferReader* reader) : SparseBitSet() { initFromBuffer(reader); }
+    // The checked reader validates the page table and sets the error on the reader if broken.
+    template <typename Policy>
+    explicit SparseBitSet(BasicBufferReader<Policy>* reader) : SparseBitSet() {
+        initFromBuffer(reader);
+    }
 
     SparseBitSet(SparseBitSet&&) = default;
     SparseBitSet& operator=(SparseBitSet&&) = default;
@@ -69,7 +77,10 @@ public:
 
 private:
     void initFromRanges(const uint32_t* ranges, size_t nRanges);
-    void initFromBuffer(BufferReader* reader);
+    template <typename Reader>
+    void initFromBuffer(Reader* reader);
+    // Returns true if every page index points inside mBitmaps.
+    bool isValid() const;
 
     static const uint32_t kMaximumCapacity = 0xFFFFFF;
     static const int kLogValuesPerPage = 8;
@@ -102,6 +113,62 @@ private:
     void operator=(const SparseBitSet&) = delete;
 };
 
+// Collects SparseBitSets to be serialized together, e.g. the coverages of all font families in a
+// font map. Bit sets are addressed by content, so identical bit sets are written only once.
+class SparseBitSetTableWriter {
+public:
+    SparseBitSetTableWriter() {}
+
+    // Adds the bit set to the table. The bit set must outlive this object.
+    void add(const SparseBitSet* bitset);
+
+    // Returns the table index of the bit set previously added.
+    uint32_t indexOf(const SparseBitSet* bitset) const;
+
+    // Returns the number of distinct bit sets.
+    uint32_t size() const { return mBitSets.size(); }
+
+    void writeTo(BufferWriter* writer) const;
+
+private:
+    std::vector<const SparseBitSet*> mBitSets;
+    std::unordered_map<const SparseBitSet*, uint32_t> mIndexByBitSet;
+    // Key is the serialized form of the bit set.
+    std::unordered_map<std::string, uint32_t> mIndexByContent;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(SparseBitSetTableWriter);
+};
+
+// Reads the table written by SparseBitSetTableWriter. Bit sets are not copied, so every bit set
+// returned for the same index shares the memory of the buffer.
+class SparseBitSetTableReader {
+public:
+    // The checked reader validates all the bit sets in the table.
+    template <typename Policy>
+    explicit SparseBitSetTableReader(BasicBufferReader<Policy>* reader) : mData(reader->data()) {
+        uint32_t size = reader->readCount();
+        mPositions.reserve(size);
+        for (uint32_t i = 0; i < size && !reader->hasError(); i++) {
+            mPositions.push_back(reader->pos());
+            SparseBitSet bitset(reader);
+        }
+    }
+
+    uint32_t size() const { return mPositions.size(); }
+
+    // The index must be less than size().
+    SparseBitSet get(uint32_t index) const {
+        BufferReader reader(mData, mPositions[index]);
+        return SparseBitSet(&reader);
+    }
+
+private:
+    const void* mData;
+    std::vector<uint32_t> mPositions;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(SparseBitSetTableReader);
+};
+
 }  // namespace minikin
 
 #endif  // MINIKIN_SPARSE_BIT_SET_H
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/LineBreaker.h"
+
+#include <algorithm>
+
+#include "minikin/GraphemeBreak.h"
+#include "minikin/MeasuredText.h"
+
+#include "GreedyLineBreaker.h"
+#include "LayoutUtils.h"
+#include "LineBreakerUtil.h"
+
+namespace minikin {
+
+namespace {
+
+// The line widths of a chunk, whose line numbers start from the first line of the chunk.
+class ChunkLineWidth : public LineWidth {
+public:
+    ChunkLineWidth(const LineWidth& lineWidth, uint32_t firstLineNo)
+            : mLineWidth(lineWidth), mFirstLineNo(firstLineNo) {}
+
+    float getAt(size_t lineNo) const override { return mLineWidth.getAt(mFirstLineNo + lineNo); }
+    float getMin() const override { return mLineWidth.getMin(); }
+
+private:
+    const LineWidth& mLineWidth;
+    const uint32_t mFirstLineNo;
+};
+
+// Returns the end of the chunk starting at start. The chunk ends after a line end space if
+// possible, so that the words and the layout pieces in the chunk are the same as in the paragraph.
+// Text without such a space in the latter half of the chunk, e.g. CJK or Thai, ends at a word break
+// for the layout cache, or at a grapheme break, so that a chunk stays about length long. Only the
+// last line of such a chunk may differ from the paragraph, and that one is broken again with the
+// next chunk.
+uint32_t findChunkEnd(const U16StringPiece& textBuf, uint32_t start, uint32_t length) {
+    if (textBuf.size() - start <= length) {
+        return textBuf.size();
+    }
+    const uint32_t limit = start + length;
+    // A break far before the limit would keep the chunk from growing when it is retried with a
+    // longer length.
+    const uint32_t minEnd = start + std::max(length / 2, 1u);
+    for (uint32_t i = limit; i > minEnd; i--) {
+        if (isLineEndSpace(textBuf[i - 1])) {
+            return i;
+        }
+    }
+    const uint32_t wordBreak = getPrevWordBreakForCache(textBuf, limit);
+    if (wordBreak > minEnd) {
+        return wordBreak;
+    }
+    for (uint32_t i = limit; i > minEnd; i--) {
+        if (GraphemeBreak::isGraphemeBreak(nullptr /* advances */, textBuf.data(), 0,
+                                           textBuf.size(), i)) {
+            return i;
+        }
+    }
+    return limit;
+}
+
+// Returns the number of the lines of the chunk which do not depend on the text after the chunk.
+// Returns 0 if there is no such line.
+size_t countFinalLines(const U16StringPiece& chunkText, const LineBreakResult& lines) {
+    if (lines.breakPoints.size() <= 1) {
+        return 0;
+    }
+    // The lines before a break after a line end space are final, since the greedy line breaking
+    // of the following lines starts over there in the same way. The last line is never final.
+    for (size_t i = lines.breakPoints.size() - 1; i > 0; i--) {
+        const uint32_t offset = lines.breakPoints[i - 1];
+        if (isLineEndSpace(chunkText[offset - 1])) {
+            return i;
+        }
+    }
+    // No line ends after a space, e.g. in CJK text. Accept all but the last line.
+    return lines.breakPoints.size() - 1;
+}
+
+// Breaks the whole paragraph and passes the lines from lineNo to onLines.
+void breakRestOfParagraph(const U16StringPiece& textBuf, const MeasuredTextBuilder& builder,
+                          const LineWidth& lineWidth, const TabStops& tabStops,
+                          bool enableHyphenation, uint32_t lineNo,
+                          const std::function<void(LineBreakResult&&)>& onLines) {
+    std::unique_ptr<MeasuredText> measured =
+            builder.buildRange(textBuf, Range(0, textBuf.size()), false /* computeHyphenation */,
+                               false /* computeLayout */);
+    LineBreakResult result =
+            breakLineGreedy(textBuf, *measured, lineWidth, tabStops, enableHyphenation);
+    if (result.breakPoints.size() <= lineNo) {
+        return;
+    }
+    LineBreakResult lines;
+    lines.breakPoints.assign(result.breakPoints.begin() + lineNo, result.breakPoints.end());
+    lines.widths.assign(result.widths.begin() + lineNo, result.widths.end());
+    lines.ascents.assign(result.ascents.begin() + lineNo, result.ascents.end());
+    lines.descents.assign(result.descents.begin() + lineNo, result.descents.end());
+    lines.flags.assign(result.flags.begin() + lineNo, result.flags.end());
+    onLines(std::move(lines));
+}
+
+}  // namespace
+
+void breakIntoLinesInChunks(const U16StringPiece& textBuf, const MeasuredTextBuilder& builder,
+                            HyphenationFrequency frequency, const LineWidth& lineWidth,
+                            const TabStops& tabStops, uint32_t chunkLength,
+                            const std::function<void(LineBreakResult&&)>& onLines) {
+    const bool enableHyphenation = frequency != HyphenationFrequency::None;
+    uint32_t start = 0;
+    uint32_t lineNo = 0;
+    uint32_t length = std::max(chunkLength, 1u);
+    while (start < textBuf.size()) {
+        const Range chunk(start, findChunkEnd(textBuf, start, length));
+        const U16StringPiece chunkText = textBuf.substr(chunk);
+        std::unique_ptr<MeasuredText> measured = builder.buildRange(
+                textBuf, chunk, false /* computeHyphenation */, false /* computeLayout */);
+        if (measured == nullptr) {
+            // A run in the chunk can not be split. Break the whole paragraph instead and pass the
+            // lines after the ones already passed, which are the same in the paragraph.
+            breakRestOfParagraph(textBuf, builder, lineWidth, tabStops, enableHyphenation, lineNo,
+                                 onLines);
+            return;
+        }
+        LineBreakResult result =
+                breakLineGreedy(chunkText, *measured, ChunkLineWidth(lineWidth, lineNo), tabStops,
+                                enableHyphenation);
+
+        size_t finalCount = result.breakPoints.size();
+        if (chunk.getEnd() != textBuf.size()) {
+            finalCount = countFinalLines(chunkText, result);
+            if (finalCount == 0) {
+                // A line is longer than the chunk. Retry with a longer chunk.
+                length *= 2;
+                continue;
+            }
+        }
+        if (finalCount == 0) {
+            break;  // No line break in the rest of the text.
+        }
+
+        LineBreakResult lines;
+        for (size_t i = 0; i < finalCount; i++) {
+            lines.breakPoints.push_back(result.breakPoints[i] + start);
+            lines.widths.push_back(result.widths[i]);
+            lines.ascents.push_back(result.ascents[i]);
+            lines.descents.push_back(result.descents[i]);
+            lines.flags.push_back(result.flags[i]);
+        }
+        start += result.breakPoints[finalCount - 1];
+        lineNo += finalCount;
+        length = std::max(chunkLength, 1u);
+        onLines(std::move(lines));
+    }
+}
+
+}  // namespace minikin
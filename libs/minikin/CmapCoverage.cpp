@@ -423,8 +423,20 @@ static void getCoverageFormat14(std::vector<std::unique_ptr<SparseBitSet>>* out,
     out->shrink_to_fit();
 }
 
-SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_size,
-                                       std::vector<std::unique_ptr<SparseBitSet>>* out) {
+namespace {
+
+constexpr uint32_t kNoTable = UINT32_MAX;
+
+// Offsets of the cmap subtables used for computing coverage.
+struct CmapSubtables {
+    uint32_t bestTableOffset = kNoTable;
+    uint16_t bestTableFormat = 0;
+    uint32_t vsTableOffset = kNoTable;
+};
+
+}  // namespace
+
+static CmapSubtables findSubtables(const uint8_t* cmap_data, size_t cmap_size) {
     constexpr size_t kHeaderSize = 4;
     constexpr size_t kNumTablesOffset = 2;
     constexpr size_t kTableSize = 8;
@@ -432,20 +444,17 @@ SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_siz
     constexpr size_t kEncodingIdOffset = 2;
     constexpr size_t kOffsetOffset = 4;
     constexpr size_t kFormatOffset = 0;
-    constexpr uint32_t kNoTable = UINT32_MAX;
 
+    CmapSubtables result;
     if (kHeaderSize > cmap_size) {
-        return SparseBitSet();
+        return result;
     }
     uint32_t numTables = readU16(cmap_data, kNumTablesOffset);
     if (kHeaderSize + numTables * kTableSize > cmap_size) {
-        return SparseBitSet();
+        return result;
     }
 
-    uint32_t bestTableOffset = kNoTable;
-    uint16_t bestTableFormat = 0;
     uint8_t bestTablePriority = kLowestPriority;
-    uint32_t vsTableOffset = kNoTable;
     for (uint32_t i = 0; i < numTables; ++i) {
         const uint32_t tableHeadOffset = kHeaderSize + i * kTableSize;
         const uint16_t platformId = readU16(cmap_data, tableHeadOffset + kPlatformIdOffset);
@@ -458,8 +467,8 @@ SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_siz
         const uint16_t format = readU16(cmap_data, offset + kFormatOffset);
 
         if (platformId == 0 /* Unicode */ && encodingId == 5 /* Variation Sequences */) {
-            if (vsTableOffset == kNoTable && format == 14) {
-                vsTableOffset = offset;
+            if (result.vsTableOffset == kNoTable && format == 14) {
+                result.vsTableOffset = offset;
             } else {
                 // Ignore the (0, 5) table if we have already seen another valid one or it's in a
                 // format we don't understand.
@@ -501,42 +510,82 @@ SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_siz
             }
             const uint8_t priority = getTablePriority(platformId, encodingId);
             if (priority < bestTablePriority) {
-                bestTableOffset = offset;
+                result.bestTableOffset = offset;
+                result.bestTableFormat = format;
                 bestTablePriority = priority;
-                bestTableFormat = format;
             }
         }
-        if (vsTableOffset != kNoTable && bestTablePriority == 0 /* highest priority */) {
+        if (result.vsTableOffset != kNoTable && bestTablePriority == 0 /* highest priority */) {
             // Already found the highest priority table and variation sequences table. No need to
             // look at remaining tables.
             break;
         }
     }
+    return result;
+}
 
-    SparseBitSet coverage;
+// Returns the ranges of the best base subtable. The result is empty if there is no usable table.
+static std::vector<uint32_t> getBaseCoverageRanges(const uint8_t* cmap_data, size_t cmap_size,
+                                                   const CmapSubtables& tables) {
+    std::vector<uint32_t> coverageVec;
+    if (tables.bestTableOffset == kNoTable) {
+        return coverageVec;
+    }
+    const uint8_t* tableData = cmap_data + tables.bestTableOffset;
+    const size_t tableSize = cmap_size - tables.bestTableOffset;
+    bool success;
+    if (tables.bestTableFormat == 4) {
+        success = getCoverageFormat4(coverageVec, tableData, tableSize);
+    } else {
+        success = getCoverageFormat12(coverageVec, tableData, tableSize);
+    }
+    if (!success) {
+        coverageVec.clear();
+    }
+    return coverageVec;
+}
 
-    if (bestTableOffset != kNoTable) {
-        const uint8_t* tableData = cmap_data + bestTableOffset;
-        const size_t tableSize = cmap_size - bestTableOffset;
-        bool success;
-        std::vector<uint32_t> coverageVec;
-        if (bestTableFormat == 4) {
-            success = getCoverageFormat4(coverageVec, tableData, tableSize);
-        } else {
-            success = getCoverageFormat12(coverageVec, tableData, tableSize);
-        }
+SparseBitSet CmapCoverage::getCoverage(const uint8_t* cmap_data, size_t cmap_size,
+                                       std::vector<std::unique_ptr<SparseBitSet>>* out) {
+    const CmapSubtables tables = findSubtables(cmap_data, cmap_size);
 
-        if (success) {
-            coverage = SparseBitSet(&coverageVec.front(), coverageVec.size() >> 1);
-        }
+    SparseBitSet coverage;
+    std::vector<uint32_t> coverageVec = getBaseCoverageRanges(cmap_data, cmap_size, tables);
+    if (!coverageVec.empty()) {
+        coverage = SparseBitSet(&coverageVec.front(), coverageVec.size() >> 1);
     }
 
-    if (vsTableOffset != kNoTable) {
-        const uint8_t* tableData = cmap_data + vsTableOffset;
-        const size_t tableSize = cmap_size - vsTableOffset;
+    if (tables.vsTableOffset != kNoTable) {
+        const uint8_t* tableData = cmap_data + tables.vsTableOffset;
+        const size_t tableSize = cmap_size - tables.vsTableOffset;
         getCoverageFormat14(out, tableData, tableSize, coverage);
     }
     return coverage;
 }
 
+SparseBitSet CmapCoverage::getCoveragePages(const uint8_t* cmap_data, size_t cmap_size,
+                                            bool* outHasVSTable) {
+    const CmapSubtables tables = findSubtables(cmap_data, cmap_size);
+    *outHasVSTable = tables.vsTableOffset != kNoTable;
+
+    const std::vector<uint32_t> coverageVec = getBaseCoverageRanges(cmap_data, cmap_size, tables);
+    // Collapse the code point ranges into page ranges. Adjacent code point ranges often fall into
+    // the same page, so merge overlapping page ranges as well as touching ones.
+    std::vector<uint32_t> pageVec;
+    for (size_t i = 0; i < coverageVec.size(); i += 2) {
+        const uint32_t startPage = coverageVec[i] >> kLogCharsPerPage;
+        const uint32_t endPage = ((coverageVec[i + 1] - 1) >> kLogCharsPerPage) + 1;
+        if (!pageVec.empty() && pageVec.back() >= startPage) {
+            pageVec.back() = std::max(pageVec.back(), endPage);
+        } else {
+            pageVec.push_back(startPage);
+            pageVec.push_back(endPage);
+        }
+    }
+    if (pageVec.empty()) {
+        return SparseBitSet();
+    }
+    return SparseBitSet(&pageVec.front(), pageVec.size() >> 1);
+}
+
 }  // namespace minikin
@@ -18,12 +18,14 @@
 
 #include "minikin/Font.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <hb-ot.h>
 #include <hb.h>
 #include <log/log.h>
 
+#include "minikin/Characters.h"
 #include "minikin/HbUtils.h"
 #include "minikin/MinikinFont.h"
 
@@ -32,6 +34,14 @@
 
 namespace minikin {
 
+namespace {
+
+// The hyphen characters memoized in Font::mHyphenChars, in the same order.
+constexpr uint32_t kHyphenChars[] = {CHAR_HYPHEN, CHAR_ARMENIAN_HYPHEN, CHAR_MAQAF,
+                                     CHAR_UCAS_HYPHEN};
+
+}  // namespace
+
 std::shared_ptr<Font> Font::Builder::build() {
     if (mIsWeightSet && mIsSlantSet) {
         // No need to read OS/2 header of the font file.
@@ -122,4 +132,33 @@ std::unordered_set<AxisTag> Font::getSupportedAxes() const {
     return supportedAxes;
 }
 
+uint32_t Font::getHyphenChar(uint32_t preferredHyphen) const {
+    const auto it = std::find(std::begin(kHyphenChars), std::end(kHyphenChars), preferredHyphen);
+    if (it == std::end(kHyphenChars)) {
+        return preferredHyphen;
+    }
+    std::atomic<uint32_t>& memoized = mHyphenChars[it - std::begin(kHyphenChars)];
+    uint32_t hyphenChar = memoized.load(std::memory_order_relaxed);
+    if (hyphenChar == 0) {
+        hb_font_t* font = baseFont().get();
+        hb_codepoint_t glyph;
+        hyphenChar = preferredHyphen;
+        if (hyphenChar != CHAR_HYPHEN && !hb_font_get_nominal_glyph(font, hyphenChar, &glyph)) {
+            // The original hyphen requested was not supported. Let's try and see if the
+            // Unicode hyphen is supported.
+            hyphenChar = CHAR_HYPHEN;
+        }
+        if (hyphenChar == CHAR_HYPHEN && !hb_font_get_nominal_glyph(font, hyphenChar, &glyph)) {
+            // Fallback to ASCII HYPHEN-MINUS if the font didn't have a glyph for the preferred
+            // hyphen. Note that we intentionally don't do anything special if the font doesn't
+            // have a HYPHEN-MINUS either, so a tofu could be shown, hinting towards something
+            // missing.
+            hyphenChar = CHAR_HYPHEN_MINUS;
+        }
+        // Racing threads compute the same value, so the last store wins without harm.
+        memoized.store(hyphenChar, std::memory_order_relaxed);
+    }
+    return hyphenChar;
+}
+
 }  // namespace minikin
@@ -23,6 +23,7 @@
 #include <log/log.h>
 #include <unicode/unorm2.h>
 
+#include "minikin/CmapCoverage.h"
 #include "minikin/Emoji.h"
 #include "minikin/FontFileParser.h"
 
@@ -72,6 +73,8 @@ FontCollection::FontCollection(const vector<std::shared_ptr<FontFamily>>& typefa
 }
 
 void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces) {
+    // The page level coverage of the lazy coverage families must not be coarser than mRanges.
+    static_assert(kLogCharsPerPage >= CmapCoverage::kLogCharsPerPage);
     mId = gNextCollectionId++;
     vector<uint32_t> lastChar;
     size_t nTypefaces = typefaces.size();
@@ -81,13 +84,13 @@ void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces)
         if (family->getClosestMatch(defaultStyle).font == nullptr) {
             continue;
         }
-        const SparseBitSet& coverage = family->getCoverage();
         mFamilies.push_back(family);  // emplace_back would be better
         if (family->hasVSTable()) {
             mVSFamilyVec.push_back(family);
         }
-        mMaxChar = max(mMaxChar, coverage.length());
-        lastChar.push_back(coverage.nextSetBit(0));
+        // Use the page level coverage so that the lazy coverage families are not loaded here.
+        mMaxChar = max(mMaxChar, family->getCoverageLength());
+        lastChar.push_back(family->nextCoveredCharOrPage(0));
 
         const std::unordered_set<AxisTag>& supportedAxes = family->supportedAxes();
         mSupportedAxes.insert(supportedAxes.begin(), supportedAxes.end());
@@ -111,7 +114,7 @@ void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces)
             if (lastChar[j] < (i + 1) << kLogCharsPerPage) {
                 const std::shared_ptr<FontFamily>& family = mFamilies[j];
                 mOwnedFamilyVec.push_back(static_cast<uint8_t>(j));
-                uint32_t nextChar = family->getCoverage().nextSetBit((i + 1) << kLogCharsPerPage);
+                uint32_t nextChar = family->nextCoveredCharOrPage((i + 1) << kLogCharsPerPage);
                 lastChar[j] = nextChar;
             }
         }
@@ -122,18 +125,31 @@ void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces)
                         "Exceeded the maximum indexable cmap coverage.");
     mFamilyVec = mOwnedFamilyVec.data();
     mFamilyVecCount = mOwnedFamilyVec.size();
+    initFirstFontFamilies();
 }
 
-FontCollection::FontCollection(BufferReader* reader,
+void FontCollection::initFirstFontFamilies() {
+    for (size_t i = 0; i < mFamilies.size(); i++) {
+        if (i == 0 || mFamilies[i]->isCustomFallback()) {
+            mFirstFontFamilies.push_back(static_cast<uint8_t>(i));
+        }
+    }
+}
+
+template <typename Reader>
+FontCollection::FontCollection(Reader* reader,
                                const std::vector<std::shared_ptr<FontFamily>>& families) {
     mId = gNextCollectionId++;
-    mMaxChar = reader->read<uint32_t>();
-    uint32_t familiesCount = reader->read<uint32_t>();
+    mMaxChar = reader->template read<uint32_t>();
+    uint32_t familiesCount = reader->readCount();
     mFamilies.reserve(familiesCount);
     for (uint32_t i = 0; i < familiesCount; i++) {
-        uint32_t index = reader->read<uint32_t>();
-        if (index >= families.size()) {
+        uint32_t index = reader->template read<uint32_t>();
+        if (index >= families.size() || families[index] == nullptr) {
             ALOGE("Invalid FontFamily index: %zu", (size_t)index);
+            if constexpr (Reader::kChecked) {
+                reader->setError();
+            }
         } else {
             mFamilies.push_back(families[index]);
             if (families[index]->hasVSTable()) {
@@ -143,10 +159,38 @@ FontCollection::FontCollection(BufferReader* reader,
     }
     // Range is two packed uint16_t
     static_assert(sizeof(Range) == 4);
-    std::tie(mRanges, mRangesCount) = reader->readArray<Range>();
-    std::tie(mFamilyVec, mFamilyVecCount) = reader->readArray<uint8_t>();
-    const auto& [axesPtr, axesCount] = reader->readArray<AxisTag>();
+    std::tie(mRanges, mRangesCount) = reader->template readArray<Range>();
+    std::tie(mFamilyVec, mFamilyVecCount) = reader->template readArray<uint8_t>();
+    const auto& [axesPtr, axesCount] = reader->template readArray<AxisTag>();
     mSupportedAxes.insert(axesPtr, axesPtr + axesCount);
+    if constexpr (Reader::kChecked) {
+        if (!isValid()) {
+            reader->setError();
+        }
+    }
+    initFirstFontFamilies();
+}
+
+template FontCollection::FontCollection(BufferReader* reader,
+                                        const std::vector<std::shared_ptr<FontFamily>>& families);
+template FontCollection::FontCollection(CheckedBufferReader* reader,
+                                        const std::vector<std::shared_ptr<FontFamily>>& families);
+
+bool FontCollection::isValid() const {
+    if (mFamilies.empty() || mFamilies.size() > MAX_FAMILY_COUNT) return false;
+    // getFamilyForChar() looks up the page of every character below mMaxChar.
+    if ((static_cast<uint64_t>(mMaxChar) + (1 << kLogCharsPerPage) - 1) >> kLogCharsPerPage >
+        mRangesCount) {
+        return false;
+    }
+    for (size_t i = 0; i < mRangesCount; i++) {
+        const Range& range = mRanges[i];
+        if (range.start > range.end || range.end > mFamilyVecCount) return false;
+    }
+    for (size_t i = 0; i < mFamilyVecCount; i++) {
+        if (mFamilyVec[i] >= mFamilies.size()) return false;
+    }
+    return true;
 }
 
 void FontCollection::writeTo(BufferWriter* writer,
@@ -341,6 +385,13 @@ FontCollection::FamilyMatchResult FontCollection::getFamilyForChar(uint32_t ch,
         return FamilyMatchResult::Builder().add(0).build();
     }
 
+    if (vs == 0) {
+        FamilyMatchResult firstFontFamily = getFirstFontFamilyForChar(ch);
+        if (!firstFontFamily.empty()) {
+            return firstFontFamily;
+        }
+    }
+
     Range range = mRanges[ch >> kLogCharsPerPage];
 
     if (vs != 0) {
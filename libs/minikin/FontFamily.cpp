@@ -43,14 +43,26 @@ FontFamily::FontFamily(FamilyVariant variant, std::vector<std::shared_ptr<Font>>
 
 FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
                        std::vector<std::shared_ptr<Font>>&& fonts, bool isCustomFallback)
+        : FontFamily(localeListId, variant, std::move(fonts), isCustomFallback,
+                     false /* isLazyCoverage */) {}
+
+FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
+                       std::vector<std::shared_ptr<Font>>&& fonts, bool isCustomFallback,
+                       bool isLazyCoverage)
         : mLocaleListId(localeListId),
           mVariant(variant),
           mFonts(std::move(fonts)),
           mIsColorEmoji(LocaleListCache::getById(localeListId).getEmojiStyle() ==
                         EmojiStyle::EMOJI),
-          mIsCustomFallback(isCustomFallback) {
+          mIsCustomFallback(isCustomFallback),
+          mIsLazyCoverage(isLazyCoverage),
+          mHasVSTableSummary(false) {
     MINIKIN_ASSERT(!mFonts.empty(), "FontFamily must contain at least one font.");
-    computeCoverage();
+    if (mIsLazyCoverage) {
+        computeCoverageSummary();
+    } else {
+        computeCoverage();
+    }
 }
 
 FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
@@ -64,45 +76,111 @@ FontFamily::FontFamily(uint32_t localeListId, FamilyVariant variant,
           mSupportedAxes(std::move(supportedAxes)),
           mIsColorEmoji(isColorEmoji),
           mIsCustomFallback(isCustomFallback),
+          mIsLazyCoverage(false),
+          mHasVSTableSummary(false),
           mCoverage(std::move(coverage)),
           mCmapFmt14Coverage(std::move(cmapFmt14Coverage)) {}
 
+namespace {
+
+// Reads a coverage serialized with writeCoverage().
+template <typename Reader>
+SparseBitSet readCoverage(Reader* reader, const SparseBitSetTableReader* coverageTable) {
+    if (coverageTable == nullptr) {
+        return SparseBitSet(reader);
+    }
+    uint32_t index = reader->template read<uint32_t>();
+    if constexpr (Reader::kChecked) {
+        if (index >= coverageTable->size()) {
+            reader->setError();
+        }
+        if (reader->hasError()) {
+            return SparseBitSet();
+        }
+    }
+    return coverageTable->get(index);
+}
+
+void writeCoverage(BufferWriter* writer, const SparseBitSet& coverage,
+                   const SparseBitSetTableWriter* coverageTable) {
+    if (coverageTable == nullptr) {
+        coverage.writeTo(writer);
+    } else {
+        writer->write<uint32_t>(coverageTable->indexOf(&coverage));
+    }
+}
+
+}  // namespace
+
 // Read fields other than mFonts, mLocaleList.
 // static
-std::shared_ptr<FontFamily> FontFamily::readFromInternal(BufferReader* reader,
-                                                         std::vector<std::shared_ptr<Font>>&& fonts,
-                                                         uint32_t localeListId) {
+template <typename Reader>
+std::shared_ptr<FontFamily> FontFamily::readFromInternal(
+        Reader* reader, std::vector<std::shared_ptr<Font>>&& fonts, uint32_t localeListId,
+        const SparseBitSetTableReader* coverageTable) {
     // FamilyVariant is uint8_t
     static_assert(sizeof(FamilyVariant) == 1);
-    FamilyVariant variant = reader->read<FamilyVariant>();
+    FamilyVariant variant = reader->template read<FamilyVariant>();
     // AxisTag is uint32_t
     static_assert(sizeof(AxisTag) == 4);
-    const auto& [axesPtr, axesCount] = reader->readArray<AxisTag>();
+    const auto& [axesPtr, axesCount] = reader->template readArray<AxisTag>();
     std::unordered_set<AxisTag> supportedAxes(axesPtr, axesPtr + axesCount);
-    bool isColorEmoji = static_cast<bool>(reader->read<uint8_t>());
-    bool isCustomFallback = static_cast<bool>(reader->read<uint8_t>());
-    SparseBitSet coverage(reader);
+    bool isColorEmoji = static_cast<bool>(reader->template read<uint8_t>());
+    bool isCustomFallback = static_cast<bool>(reader->template read<uint8_t>());
+    SparseBitSet coverage = readCoverage(reader, coverageTable);
     // Read mCmapFmt14Coverage. As it can have null entries, it is stored in the buffer as a sparse
     // array (size, non-null entry count, array of (index, entry)).
-    uint32_t cmapFmt14CoverageSize = reader->read<uint32_t>();
+    uint32_t cmapFmt14CoverageSize = reader->template read<uint32_t>();
+    if constexpr (Reader::kChecked) {
+        // The array is indexed by variation selector index, see getVsIndex().
+        if (cmapFmt14CoverageSize > VS_INDEX_COUNT) {
+            reader->setError();
+            return nullptr;
+        }
+    }
     std::vector<std::unique_ptr<SparseBitSet>> cmapFmt14Coverage(cmapFmt14CoverageSize);
-    uint32_t cmapFmt14CoverageEntryCount = reader->read<uint32_t>();
+    uint32_t cmapFmt14CoverageEntryCount = reader->readCount();
     for (uint32_t i = 0; i < cmapFmt14CoverageEntryCount; i++) {
-        uint32_t index = reader->read<uint32_t>();
-        cmapFmt14Coverage[index] = std::make_unique<SparseBitSet>(reader);
+        uint32_t index = reader->template read<uint32_t>();
+        if constexpr (Reader::kChecked) {
+            if (index >= cmapFmt14CoverageSize) {
+                reader->setError();
+            }
+            if (reader->hasError()) {
+                return nullptr;
+            }
+        }
+        cmapFmt14Coverage[index] =
+                std::make_unique<SparseBitSet>(readCoverage(reader, coverageTable));
+    }
+    if (reader->hasError()) {
+        return nullptr;
     }
     return std::shared_ptr<FontFamily>(new FontFamily(
             localeListId, variant, std::move(fonts), std::move(supportedAxes), isColorEmoji,
             isCustomFallback, std::move(coverage), std::move(cmapFmt14Coverage)));
 }
 
+template std::shared_ptr<FontFamily> FontFamily::readFromInternal<BufferReader>(
+        BufferReader* reader, std::vector<std::shared_ptr<Font>>&& fonts, uint32_t localeListId,
+        const SparseBitSetTableReader* coverageTable);
+template std::shared_ptr<FontFamily> FontFamily::readFromInternal<CheckedBufferReader>(
+        CheckedBufferReader* reader, std::vector<std::shared_ptr<Font>>&& fonts,
+        uint32_t localeListId, const SparseBitSetTableReader* coverageTable);
+
 // static
-uint32_t FontFamily::readLocaleListInternal(BufferReader* reader) {
+template <typename Reader>
+uint32_t FontFamily::readLocaleListInternal(Reader* reader) {
     return LocaleListCache::readFrom(reader);
 }
 
+template uint32_t FontFamily::readLocaleListInternal<BufferReader>(BufferReader* reader);
+template uint32_t FontFamily::readLocaleListInternal<CheckedBufferReader>(
+        CheckedBufferReader* reader);
+
 // Write fields other than mFonts.
-void FontFamily::writeToInternal(BufferWriter* writer) const {
+void FontFamily::writeToInternal(BufferWriter* writer,
+                                 const SparseBitSetTableWriter* coverageTable) const {
     writer->write<FamilyVariant>(mVariant);
     std::vector<AxisTag> axes(mSupportedAxes.begin(), mSupportedAxes.end());
     // Sort axes to be deterministic.
@@ -110,7 +188,9 @@ void FontFamily::writeToInternal(BufferWriter* writer) const {
     writer->writeArray<AxisTag>(axes.data(), axes.size());
     writer->write<uint8_t>(mIsColorEmoji);
     writer->write<uint8_t>(mIsCustomFallback);
-    mCoverage.writeTo(writer);
+    // The serialized family always has the full coverage.
+    ensureCoverage();
+    writeCoverage(writer, mCoverage, coverageTable);
     // Write mCmapFmt14Coverage as a sparse array (size, non-null entry count,
     // array of (index, entry))
     writer->write<uint32_t>(mCmapFmt14Coverage.size());
@@ -122,7 +202,17 @@ void FontFamily::writeToInternal(BufferWriter* writer) const {
     for (size_t i = 0; i < mCmapFmt14Coverage.size(); i++) {
         if (mCmapFmt14Coverage[i] != nullptr) {
             writer->write<uint32_t>(i);
-            mCmapFmt14Coverage[i]->writeTo(writer);
+            writeCoverage(writer, *mCmapFmt14Coverage[i], coverageTable);
+        }
+    }
+}
+
+void FontFamily::addCoveragesTo(SparseBitSetTableWriter* coverageTable) const {
+    ensureCoverage();
+    coverageTable->add(&mCoverage);
+    for (const std::unique_ptr<SparseBitSet>& coverage : mCmapFmt14Coverage) {
+        if (coverage != nullptr) {
+            coverageTable->add(coverage.get());
         }
     }
 }
@@ -167,6 +257,25 @@ FakedFont FontFamily::getClosestMatch(FontStyle style) const {
 }
 
 void FontFamily::computeCoverage() {
+    computeCmapCoverage();
+    computeSupportedAxes();
+}
+
+void FontFamily::computeCoverageSummary() {
+    const std::shared_ptr<Font>& font = getClosestMatch(FontStyle()).font;
+    HbBlob cmapTable(font->baseFont(), MinikinFont::MakeTag('c', 'm', 'a', 'p'));
+    if (cmapTable.get() == nullptr) {
+        ALOGE("Could not get cmap table size!\n");
+    } else {
+        mCoveragePages = CmapCoverage::getCoveragePages(cmapTable.get(), cmapTable.size(),
+                                                        &mHasVSTableSummary);
+    }
+    // The supported axes are needed by FontCollection at construction time, so they are not
+    // deferred. Parsing fvar is cheap compared to building the cmap coverage.
+    computeSupportedAxes();
+}
+
+void FontFamily::computeCmapCoverage() const {
     const std::shared_ptr<Font>& font = getClosestMatch(FontStyle()).font;
     HbBlob cmapTable(font->baseFont(), MinikinFont::MakeTag('c', 'm', 'a', 'p'));
     if (cmapTable.get() == nullptr) {
@@ -175,14 +284,36 @@ void FontFamily::computeCoverage() {
     }
 
     mCoverage = CmapCoverage::getCoverage(cmapTable.get(), cmapTable.size(), &mCmapFmt14Coverage);
+}
 
+void FontFamily::computeSupportedAxes() {
     for (size_t i = 0; i < mFonts.size(); ++i) {
         std::unordered_set<AxisTag> supportedAxes = mFonts[i]->getSupportedAxes();
         mSupportedAxes.insert(supportedAxes.begin(), supportedAxes.end());
     }
 }
 
+uint32_t FontFamily::getCoverageLength() const {
+    if (mIsLazyCoverage) {
+        return mCoveragePages.length() << CmapCoverage::kLogCharsPerPage;
+    }
+    return mCoverage.length();
+}
+
+uint32_t FontFamily::nextCoveredCharOrPage(uint32_t fromChar) const {
+    if (mIsLazyCoverage) {
+        const uint32_t page =
+                mCoveragePages.nextSetBit(fromChar >> CmapCoverage::kLogCharsPerPage);
+        if (page == SparseBitSet::kNotFound) {
+            return SparseBitSet::kNotFound;
+        }
+        return std::max(fromChar, page << CmapCoverage::kLogCharsPerPage);
+    }
+    return mCoverage.nextSetBit(fromChar);
+}
+
 bool FontFamily::hasGlyph(uint32_t codepoint, uint32_t variationSelector) const {
+    ensureCoverage();
     if (variationSelector == 0) {
         return mCoverage.get(codepoint);
     }
@@ -248,8 +379,8 @@ std::shared_ptr<FontFamily> FontFamily::createFamilyWithVariation(
         }
     }
 
-    return std::shared_ptr<FontFamily>(
-            new FontFamily(mLocaleListId, mVariant, std::move(fonts), mIsCustomFallback));
+    return std::shared_ptr<FontFamily>(new FontFamily(mLocaleListId, mVariant, std::move(fonts),
+                                                      mIsCustomFallback, mIsLazyCoverage));
 }
 
 }  // namespace minikin
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/FontMapFile.h"
+
+#include <cstring>
+
+#include <log/log.h>
+
+#include "minikin/Hasher.h"
+
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+// static
+uint32_t FontMapFile::computeChecksum(const void* data, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    Hasher hasher;
+    hasher.update(static_cast<uint64_t>(size));
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hasher.update(word);
+    }
+    uint32_t tail = 0;
+    for (size_t shift = 0; i < size; i++, shift += 8) {
+        tail |= static_cast<uint32_t>(bytes[i]) << shift;
+    }
+    hasher.update(tail);
+    return hasher.hash();
+}
+
+// static
+void FontMapFile::writeHeader(void* buffer, size_t payloadSize) {
+    MINIKIN_ASSERT(reinterpret_cast<uintptr_t>(buffer) % kRequiredAlignment == 0,
+                   "The buffer must be aligned to %u", kRequiredAlignment);
+    LOG_ALWAYS_FATAL_IF(payloadSize > UINT32_MAX - kPayloadOffset, "Font map is too large.");
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(buffer);
+    // Clear the padding between the header and the payload to make the output deterministic.
+    memset(bytes, 0, kPayloadOffset);
+    FontMapFileHeader header = {};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.payloadOffset = kPayloadOffset;
+    header.payloadSize = static_cast<uint32_t>(payloadSize);
+    header.checksum = computeChecksum(bytes + kPayloadOffset, payloadSize);
+    header.reserved = 0;
+    memcpy(bytes, &header, sizeof(header));
+}
+
+// static
+const void* FontMapFile::getPayload(const void* data, size_t size, bool verifyChecksum) {
+    if (data == nullptr || size < kPayloadOffset) {
+        ALOGE("Font map file is too small.");
+        return nullptr;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % kRequiredAlignment != 0) {
+        ALOGE("Font map file is not aligned.");
+        return nullptr;
+    }
+    const FontMapFileHeader* header = reinterpret_cast<const FontMapFileHeader*>(data);
+    if (header->magic != kMagic) {
+        ALOGE("Font map file has an invalid magic number.");
+        return nullptr;
+    }
+    if (header->version != kVersion) {
+        ALOGE("Unsupported font map file version: %u", header->version);
+        return nullptr;
+    }
+    if (header->payloadOffset != kPayloadOffset || header->reserved != 0) {
+        ALOGE("Font map file has an invalid header.");
+        return nullptr;
+    }
+    if (header->payloadSize > size - kPayloadOffset) {
+        ALOGE("Font map file is truncated.");
+        return nullptr;
+    }
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(data) + kPayloadOffset;
+    if (verifyChecksum && computeChecksum(payload, header->payloadSize) != header->checksum) {
+        ALOGE("Font map file checksum mismatch.");
+        return nullptr;
+    }
+    return payload;
+}
+
+}  // namespace minikin
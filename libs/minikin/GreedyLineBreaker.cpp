@@ -78,7 +78,7 @@ private:
     void updateLineWidth(uint16_t c, float width);
 
     // Break line if current line exceeds the line limit.
-    void processLineBreak(uint32_t offset, WordBreaker* breaker, bool doHyphenation);
+    void processLineBreak(uint32_t offset, WordBreakIterator* breaker, bool doHyphenation);
 
     // Try to break with previous word boundary.
     // Returns false if unable to break by word boundary.
@@ -89,7 +89,7 @@ private:
     //
     // This method keeps hyphenation until the line width after line break meets the line width
     // limit.
-    bool tryLineBreakWithHyphenation(const Range& range, WordBreaker* breaker);
+    bool tryLineBreakWithHyphenation(const Range& range, WordBreakIterator* breaker);
 
     // Do line break with each characters.
     //
@@ -160,7 +160,8 @@ bool GreedyLineBreaker::tryLineBreakWithWordBreak() {
     return true;
 }
 
-bool GreedyLineBreaker::tryLineBreakWithHyphenation(const Range& range, WordBreaker* breaker) {
+bool GreedyLineBreaker::tryLineBreakWithHyphenation(const Range& range,
+                                                    WordBreakIterator* breaker) {
     if (!mEnableHyphenation || mHyphenator == nullptr) {
         return false;
     }
@@ -294,7 +295,7 @@ void GreedyLineBreaker::updateLineWidth(uint16_t c, float width) {
     }
 }
 
-void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreaker* breaker,
+void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreakIterator* breaker,
                                          bool doHyphenation) {
     while (mLineWidth > mLineWidthLimit) {
         const Range lineRange(getPrevLineBreakOffset(), offset);  // The range we need to address.
@@ -320,8 +321,7 @@ void GreedyLineBreaker::processLineBreak(uint32_t offset, WordBreaker* breaker,
 }
 
 void GreedyLineBreaker::process() {
-    WordBreaker wordBreaker;
-    wordBreaker.setText(mTextBuf.data(), mTextBuf.size());
+    WordBreakIterator wordBreaker(mTextBuf, &mMeasuredText.wordBreaks);
 
     // Following two will be initialized after the first iteration.
     uint32_t localeListId = LocaleListCache::kInvalidListId;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "HyphenationCache.h"
+
+#include <algorithm>
+
+namespace minikin {
+
+HyphenationCache::HyphenationCache(uint32_t maxEntries) {
+    mShards.reserve(kShardCount);
+    for (uint32_t i = 0; i < kShardCount; i++) {
+        mShards.push_back(std::make_unique<Shard>(std::max(1u, maxEntries / kShardCount)));
+    }
+}
+
+void HyphenationCache::hyphenate(const Hyphenator& hyphenator, const U16StringPiece& word,
+                                 HyphenationType* out) {
+    const HyphenationCacheKey key(hyphenator, word);
+    Shard& shard = *mShards[key.hash() % kShardCount];
+    if (shard.get(key, out)) {
+        mHitCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    mMissCount.fetch_add(1, std::memory_order_relaxed);
+    // Hyphenate without the lock. Don't care even if another thread does the same word.
+    hyphenator.hyphenate(word, out);
+    shard.put(key, out);
+}
+
+void HyphenationCache::clear() {
+    for (const std::unique_ptr<Shard>& shard : mShards) {
+        shard->clear();
+    }
+    mHitCount = 0;
+    mMissCount = 0;
+}
+
+float HyphenationCache::getHitRate() const {
+    const uint64_t hitCount = getHitCount();
+    const uint64_t lookupCount = hitCount + getMissCount();
+    return lookupCount == 0 ? 0.0f : static_cast<float>(hitCount) / lookupCount;
+}
+
+bool HyphenationCache::Shard::get(const HyphenationCacheKey& key, HyphenationType* out) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const Value* value = mCache.get(key);
+    if (value == nullptr) {
+        return false;
+    }
+    std::copy(value->begin(), value->end(), out);
+    return true;
+}
+
+void HyphenationCache::Shard::put(HyphenationCacheKey key, const HyphenationType* result) {
+    key.copyText();
+    Value* value = new Value(result, result + key.size());
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mCache.put(key, value)) {
+        // Another thread has cached the same word in the meantime.
+        key.freeText();
+        delete value;
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_HYPHENATION_CACHE_H
+#define MINIKIN_HYPHENATION_CACHE_H
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <utils/LruCache.h>
+
+#include "minikin/Hasher.h"
+#include "minikin/Hyphenator.h"
+#include "minikin/Macros.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+class HyphenationCacheKey {
+public:
+    HyphenationCacheKey(const Hyphenator& hyphenator, const U16StringPiece& word)
+            : mChars(word.data()),
+              mNchars(word.size()),
+              mHyphenatorId(hyphenator.getId()),
+              mHash(Hasher().update(mHyphenatorId).updateShorts(mChars, mNchars).hash()) {}
+
+    bool operator==(const HyphenationCacheKey& o) const {
+        return mHyphenatorId == o.mHyphenatorId && mNchars == o.mNchars &&
+               !memcmp(mChars, o.mChars, mNchars * sizeof(uint16_t));
+    }
+
+    android::hash_t hash() const { return mHash; }
+    uint32_t size() const { return mNchars; }
+
+    void copyText() {
+        uint16_t* charsCopy = new uint16_t[mNchars];
+        memcpy(charsCopy, mChars, mNchars * sizeof(uint16_t));
+        mChars = charsCopy;
+    }
+    void freeText() {
+        delete[] mChars;
+        mChars = nullptr;
+    }
+
+private:
+    const uint16_t* mChars;
+    uint32_t mNchars;
+    uint32_t mHyphenatorId;
+    android::hash_t mHash;
+};
+
+inline android::hash_t hash_type(const HyphenationCacheKey& key) {
+    return key.hash();
+}
+
+// A cache of hyphenation results of words, keyed by the hyphenator and the word. Natural text
+// repeats words a lot, so most words are hyphenated by a lookup. The entries are spread over
+// shards with their own locks so that concurrent line breakers rarely wait for each other.
+class HyphenationCache {
+public:
+    // Fills out with the hyphenation of the word, same as Hyphenator::hyphenate.
+    void hyphenate(const Hyphenator& hyphenator, const U16StringPiece& word, HyphenationType* out);
+
+    void clear();
+
+    // Hit statistics since the process start or the last clear().
+    uint64_t getHitCount() const { return mHitCount.load(std::memory_order_relaxed); }
+    uint64_t getMissCount() const { return mMissCount.load(std::memory_order_relaxed); }
+    // Returns the ratio of lookups answered from the cache, or 0 if there were no lookups.
+    float getHitRate() const;
+
+    static HyphenationCache& getInstance() {
+        static HyphenationCache cache(kMaxEntries);
+        return cache;
+    }
+
+protected:
+    HyphenationCache(uint32_t maxEntries);
+
+private:
+    using Value = std::vector<HyphenationType>;
+
+    class Shard : private android::OnEntryRemoved<HyphenationCacheKey, Value*> {
+    public:
+        Shard(uint32_t maxEntries) : mCache(maxEntries) { mCache.setOnEntryRemovedListener(this); }
+        ~Shard() { clear(); }
+
+        // Copies the cached result into out. Returns false if the word is not cached.
+        bool get(const HyphenationCacheKey& key, HyphenationType* out);
+        void put(HyphenationCacheKey key, const HyphenationType* result);
+        void clear() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCache.clear();
+        }
+
+    private:
+        // callback for OnEntryRemoved
+        void operator()(HyphenationCacheKey& key, Value*& value) {
+            key.freeText();
+            delete value;
+        }
+
+        std::mutex mMutex;
+        android::LruCache<HyphenationCacheKey, Value*> mCache GUARDED_BY(mMutex);
+    };
+
+    static const uint32_t kShardCount = 8;
+    static const uint32_t kMaxEntries = 4096;
+
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::atomic<uint64_t> mHitCount = {0};
+    std::atomic<uint64_t> mMissCount = {0};
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(HyphenationCache);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_HYPHENATION_CACHE_H
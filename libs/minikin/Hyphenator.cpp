@@ -17,12 +17,16 @@
 #include "minikin/Hyphenator.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <unicode/uchar.h>
+#include <unicode/unorm2.h>
 #include <unicode/uscript.h>
+#include <unicode/utf16.h>
 
 #include "minikin/Characters.h"
 
@@ -46,6 +50,23 @@ struct AlphabetTable1 {
     static uint32_t value(uint32_t entry) { return entry & 0x7ff; }
 };
 
+struct AlphabetTable2 {
+    uint32_t version;
+    uint32_t n_pages;
+    uint32_t n_blocks;
+    // actually flexible array: the block index of each page, followed by the blocks
+    uint16_t data[1];
+
+    uint32_t value(uint32_t codepoint) const {
+        const uint32_t page = codepoint >> 8;
+        if (page >= n_pages) {
+            return 0;
+        }
+        const uint16_t* blocks = data + n_pages;
+        return blocks[(static_cast<uint32_t>(data[page]) << 8) | (codepoint & 0xff)];
+    }
+};
+
 struct Trie {
     uint32_t version;
     uint32_t char_mask;
@@ -71,6 +92,29 @@ struct Pattern {
     }
 };
 
+// Aho-Corasick automaton over the patterns, present since version 1.
+struct Automaton {
+    uint32_t version;
+    uint32_t char_mask;
+    uint32_t link_shift;
+    uint32_t link_mask;
+    uint32_t n_states;
+    uint32_t n_entries;
+
+    struct State {
+        uint32_t base;     // index of the first goto entry of the state
+        uint32_t fail;     // the state of the longest proper suffix
+        uint32_t pattern;  // index into the pattern table, 0 if none
+        uint32_t output;   // the nearest state with a pattern along the failure links, 0 if none
+    };
+    State states[1];  // actually flexible array, size is n_states
+
+    // Each goto entry is (link << link_shift) | (char + 1). There are n_entries entries.
+    const uint32_t* gotoTable() const {
+        return reinterpret_cast<const uint32_t*>(states + n_states);
+    }
+};
+
 struct Header {
     uint32_t magic;
     uint32_t version;
@@ -78,6 +122,7 @@ struct Header {
     uint32_t trie_offset;
     uint32_t pattern_offset;
     uint32_t file_size;
+    uint32_t automaton_offset;  // Only present since version 1.
 
     // accessors
     const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(this); }
@@ -90,12 +135,132 @@ struct Header {
     const AlphabetTable1* alphabetTable1() const {
         return reinterpret_cast<const AlphabetTable1*>(bytes() + alphabet_offset);
     }
+    const AlphabetTable2* alphabetTable2() const {
+        return reinterpret_cast<const AlphabetTable2*>(bytes() + alphabet_offset);
+    }
     const Trie* trieTable() const { return reinterpret_cast<const Trie*>(bytes() + trie_offset); }
     const Pattern* patternTable() const {
         return reinterpret_cast<const Pattern*>(bytes() + pattern_offset);
     }
+    // Returns nullptr for version 0 files, which only have the trie.
+    const Automaton* automaton() const {
+        return version >= 1 ? reinterpret_cast<const Automaton*>(bytes() + automaton_offset)
+                            : nullptr;
+    }
 };
 
+static std::atomic<uint32_t> gNextHyphenatorId = {0};
+
+constexpr uint32_t HYB_MAGIC = 0x62ad7968;
+constexpr uint32_t HYB_MAX_VERSION = 1;
+
+// Returns true if the table of the given size fits in [offset, end) of the file. The computation
+// is done in 64 bits so that broken values can't overflow.
+static bool fitsIn(uint64_t offset, uint64_t end, uint64_t tableSize) {
+    return offset % 4 == 0 && offset <= end && tableSize <= end - offset;
+}
+
+// static
+bool Hyphenator::isValidBinary(const uint8_t* data, size_t size) {
+    if (data == nullptr || reinterpret_cast<uintptr_t>(data) % 4 != 0 ||
+        size < offsetof(Header, automaton_offset)) {
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (header->magic != HYB_MAGIC || header->version > HYB_MAX_VERSION ||
+        header->file_size > size) {
+        return false;
+    }
+    const uint64_t headerSize =
+            header->version == 0 ? offsetof(Header, automaton_offset) : sizeof(Header);
+    const uint64_t fileSize = header->file_size;
+    const uint64_t patternEnd = header->version == 0 ? fileSize : header->automaton_offset;
+    if (headerSize > fileSize || header->alphabet_offset < headerSize ||
+        header->trie_offset < header->alphabet_offset ||
+        header->pattern_offset < header->trie_offset || patternEnd < header->pattern_offset) {
+        return false;
+    }
+
+    // Alphabet
+    const uint64_t alphabetOffset = header->alphabet_offset;
+    const uint64_t alphabetEnd = header->trie_offset;
+    if (!fitsIn(alphabetOffset, alphabetEnd, sizeof(uint32_t))) {
+        return false;
+    }
+    switch (header->alphabetVersion()) {
+        case 0: {
+            const AlphabetTable0* alphabet = header->alphabetTable0();
+            if (!fitsIn(alphabetOffset, alphabetEnd, offsetof(AlphabetTable0, data)) ||
+                alphabet->max_codepoint < alphabet->min_codepoint ||
+                !fitsIn(alphabetOffset, alphabetEnd,
+                        offsetof(AlphabetTable0, data) +
+                                (uint64_t)(alphabet->max_codepoint - alphabet->min_codepoint))) {
+                return false;
+            }
+            break;
+        }
+        case 1: {
+            const AlphabetTable1* alphabet = header->alphabetTable1();
+            if (!fitsIn(alphabetOffset, alphabetEnd, offsetof(AlphabetTable1, data)) ||
+                !fitsIn(alphabetOffset, alphabetEnd,
+                        offsetof(AlphabetTable1, data) + 4 * (uint64_t)alphabet->n_entries)) {
+                return false;
+            }
+            break;
+        }
+        case 2: {
+            const AlphabetTable2* alphabet = header->alphabetTable2();
+            if (!fitsIn(alphabetOffset, alphabetEnd, offsetof(AlphabetTable2, data)) ||
+                alphabet->n_blocks == 0 ||
+                !fitsIn(alphabetOffset, alphabetEnd,
+                        offsetof(AlphabetTable2, data) + 2 * (uint64_t)alphabet->n_pages +
+                                512 * (uint64_t)alphabet->n_blocks)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < alphabet->n_pages; i++) {
+                if (alphabet->data[i] >= alphabet->n_blocks) {
+                    return false;
+                }
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+
+    // Trie
+    const Trie* trie = header->trieTable();
+    if (!fitsIn(header->trie_offset, header->pattern_offset, offsetof(Trie, data)) ||
+        !fitsIn(header->trie_offset, header->pattern_offset,
+                offsetof(Trie, data) + 4 * (uint64_t)trie->n_entries)) {
+        return false;
+    }
+
+    // Pattern
+    const Pattern* pattern = header->patternTable();
+    if (!fitsIn(header->pattern_offset, patternEnd, offsetof(Pattern, data)) ||
+        !fitsIn(header->pattern_offset, patternEnd,
+                offsetof(Pattern, data) + 4 * (uint64_t)pattern->n_entries) ||
+        !fitsIn(header->pattern_offset, patternEnd,
+                (uint64_t)pattern->pattern_offset + pattern->pattern_size)) {
+        return false;
+    }
+
+    // Automaton
+    if (header->version >= 1) {
+        const Automaton* automaton = header->automaton();
+        if (!fitsIn(header->automaton_offset, fileSize, offsetof(Automaton, states)) ||
+            automaton->n_states == 0 ||
+            !fitsIn(header->automaton_offset, fileSize,
+                    offsetof(Automaton, states) +
+                            sizeof(Automaton::State) * (uint64_t)automaton->n_states +
+                            4 * (uint64_t)automaton->n_entries)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // static
 Hyphenator* Hyphenator::loadBinary(const uint8_t* patternData, size_t minPrefix, size_t minSuffix,
                                    const std::string& locale) {
@@ -115,7 +280,8 @@ Hyphenator::Hyphenator(const uint8_t* patternData, size_t minPrefix, size_t minS
         : mPatternData(patternData),
           mMinPrefix(minPrefix),
           mMinSuffix(minSuffix),
-          mHyphenationLocale(hyphenLocale) {}
+          mHyphenationLocale(hyphenLocale),
+          mId(gNextHyphenatorId++) {}
 
 void Hyphenator::hyphenate(const U16StringPiece& word, HyphenationType* out) const {
     const size_t len = word.size();
@@ -128,8 +294,9 @@ void Hyphenator::hyphenate(const U16StringPiece& word, HyphenationType* out) con
             hyphenateFromCodes(alpha_codes, paddedLen, hyphenValue, out);
             return;
         }
-        // TODO: try NFC normalization
-        // TODO: handle non-BMP Unicode (requires remapping of offsets)
+        if (hyphenateNormalized(word, out)) {
+            return;
+        }
     }
     // Note that we will always get here if the word contains a hyphen or a soft hyphen, because the
     // alphabet is not expected to contain a hyphen or a soft hyphen character, so alphabetLookup
@@ -137,6 +304,18 @@ void Hyphenator::hyphenate(const U16StringPiece& word, HyphenationType* out) con
     hyphenateWithNoPatterns(word, out);
 }
 
+void Hyphenator::hyphenate(const U16StringPiece& text, const std::vector<Range>& words,
+                           HyphenationType* out) const {
+    // Spaces and punctuation between the words are never hyphenated.
+    std::fill(out, out + text.size(), HyphenationType::DONT_BREAK);
+    for (const Range& range : words) {
+        if (range.isEmpty()) {
+            continue;  // Nothing to hyphenate, and out may end at the range.
+        }
+        hyphenate(text.substr(range), out + range.getStart());
+    }
+}
+
 // This function determines whether a character is like U+2010 HYPHEN in
 // line breaking and usage: a character immediately after which line breaks
 // are allowed, but words containing it should not be automatically
@@ -204,8 +383,7 @@ static HyphenationType hyphenationTypeBasedOnScript(uint32_t codePoint) {
     // to maqaf for Hebrew, we can simply add a condition here.
     const UScriptCode script = getScript(codePoint);
     if (script == USCRIPT_KANNADA || script == USCRIPT_MALAYALAM || script == USCRIPT_TAMIL ||
-        script == USCRIPT_TELUGU) {
-        // Grantha is not included, since we don't support non-BMP hyphenation yet.
+        script == USCRIPT_TELUGU || script == USCRIPT_GRANTHA) {
         return HyphenationType::BREAK_AND_DONT_INSERT_HYPHEN;
     } else if (script == USCRIPT_ARMENIAN) {
         return HyphenationType::BREAK_AND_INSERT_ARMENIAN_HYPHEN;
@@ -248,6 +426,9 @@ static inline HyphenationType getHyphTypeForArabic(const U16StringPiece& word, s
 // that didn't match patterns, especially words that contain hyphens or soft hyphens (See sections
 // 5.3, Use of Hyphen, and 5.4, Use of Soft Hyphen).
 void Hyphenator::hyphenateWithNoPatterns(const U16StringPiece& word, HyphenationType* out) const {
+    if (word.size() == 0) {
+        return;  // out may have no room at all, e.g. for an empty line of a word list.
+    }
     out[0] = HyphenationType::DONT_BREAK;
     for (size_t i = 1; i < word.size(); i++) {
         const uint16_t prevChar = word[i - 1];
@@ -288,58 +469,141 @@ void Hyphenator::hyphenateWithNoPatterns(const U16StringPiece& word, Hyphenation
     }
 }
 
-HyphenationType Hyphenator::alphabetLookup(uint16_t* alpha_codes,
-                                           const U16StringPiece& word) const {
-    const Header* header = getHeader();
+// Maps the characters to the alphabet codes with the lookup function, which returns 0 for the
+// characters not in the alphabet. Char is uint16_t for the code units of a word, or uint32_t for
+// the code points of a normalized word.
+template <typename Char, typename Lookup>
+static HyphenationType mapToCodes(uint16_t* alpha_codes, const Char* word, size_t len,
+                                  Lookup lookup) {
     HyphenationType result = HyphenationType::BREAK_AND_INSERT_HYPHEN;
+    alpha_codes[0] = 0;  // word start
+    for (size_t i = 0; i < len; i++) {
+        uint32_t c = word[i];
+        uint32_t code = lookup(c);
+        if (code == 0) {
+            return HyphenationType::DONT_BREAK;
+        }
+        if (result == HyphenationType::BREAK_AND_INSERT_HYPHEN) {
+            result = hyphenationTypeBasedOnScript(c);
+        }
+        alpha_codes[i + 1] = code;
+    }
+    alpha_codes[len + 1] = 0;  // word termination
+    return result;
+}
+
+template <typename Char>
+static HyphenationType lookupAlphabet(const Header* header, uint16_t* alpha_codes,
+                                      const Char* word, size_t len) {
     // TODO: check header magic
     uint32_t alphabetVersion = header->alphabetVersion();
     if (alphabetVersion == 0) {
         const AlphabetTable0* alphabet = header->alphabetTable0();
         uint32_t min_codepoint = alphabet->min_codepoint;
         uint32_t max_codepoint = alphabet->max_codepoint;
-        alpha_codes[0] = 0;  // word start
-        for (size_t i = 0; i < word.size(); i++) {
-            uint16_t c = word[i];
+        return mapToCodes(alpha_codes, word, len, [&](uint32_t c) -> uint32_t {
             if (c < min_codepoint || c >= max_codepoint) {
-                return HyphenationType::DONT_BREAK;
+                return 0;
             }
-            uint8_t code = alphabet->data[c - min_codepoint];
-            if (code == 0) {
-                return HyphenationType::DONT_BREAK;
-            }
-            if (result == HyphenationType::BREAK_AND_INSERT_HYPHEN) {
-                result = hyphenationTypeBasedOnScript(c);
-            }
-            alpha_codes[i + 1] = code;
-        }
-        alpha_codes[word.size() + 1] = 0;  // word termination
-        return result;
+            return alphabet->data[c - min_codepoint];
+        });
     } else if (alphabetVersion == 1) {
         const AlphabetTable1* alphabet = header->alphabetTable1();
         size_t n_entries = alphabet->n_entries;
         const uint32_t* begin = alphabet->data;
         const uint32_t* end = begin + n_entries;
-        alpha_codes[0] = 0;
-        for (size_t i = 0; i < word.size(); i++) {
-            uint16_t c = word[i];
+        return mapToCodes(alpha_codes, word, len, [&](uint32_t c) -> uint32_t {
             auto p = std::lower_bound(begin, end, c << 11);
-            if (p == end) {
-                return HyphenationType::DONT_BREAK;
+            if (p == end || AlphabetTable1::codepoint(*p) != c) {
+                return 0;
             }
-            uint32_t entry = *p;
-            if (AlphabetTable1::codepoint(entry) != c) {
-                return HyphenationType::DONT_BREAK;
+            return AlphabetTable1::value(*p);
+        });
+    } else if (alphabetVersion == 2) {
+        const AlphabetTable2* alphabet = header->alphabetTable2();
+        return mapToCodes(alpha_codes, word, len,
+                          [&](uint32_t c) -> uint32_t { return alphabet->value(c); });
+    }
+    return HyphenationType::DONT_BREAK;
+}
+
+HyphenationType Hyphenator::alphabetLookup(uint16_t* alpha_codes,
+                                           const U16StringPiece& word) const {
+    return lookupAlphabet(getHeader(), alpha_codes, word.data(), word.size());
+}
+
+bool Hyphenator::hyphenateNormalized(const U16StringPiece& word, HyphenationType* out) const {
+    UErrorCode status = U_ZERO_ERROR;
+    const UNormalizer2* nfc = unorm2_getNFCInstance(&status);
+    if (U_FAILURE(status)) {
+        return false;
+    }
+    const UChar* chars = reinterpret_cast<const UChar*>(word.data());
+    const int32_t len = word.size();
+    const bool hasSurrogate =
+            std::any_of(chars, chars + len, [](UChar c) { return U16_IS_SURROGATE(c); });
+    if (!hasSurrogate && unorm2_quickCheck(nfc, chars, len, &status) == UNORM_YES) {
+        // Neither normalization nor code points change the lookup result. This is the case for
+        // most words failing the lookup, e.g. words with hyphens.
+        return false;
+    }
+
+    // Normalize segment by segment, so that each code point of the normalized word is known to
+    // start a segment of the original word, or to be inside of one.
+    constexpr uint16_t kInsideSegment = UINT16_MAX;
+    uint32_t codePoints[MAX_HYPHENATED_SIZE];
+    uint16_t offsets[MAX_HYPHENATED_SIZE];
+    size_t count = 0;
+    int32_t segmentStart = 0;
+    while (segmentStart < len) {
+        int32_t segmentEnd = segmentStart;
+        UChar32 c;
+        U16_NEXT(chars, segmentEnd, len, c);
+        while (segmentEnd < len) {
+            int32_t next = segmentEnd;
+            U16_NEXT(chars, next, len, c);
+            if (unorm2_hasBoundaryBefore(nfc, c)) {
+                break;
             }
-            if (result == HyphenationType::BREAK_AND_INSERT_HYPHEN) {
-                result = hyphenationTypeBasedOnScript(c);
+            segmentEnd = next;
+        }
+        UChar normalized[MAX_HYPHENATED_SIZE];
+        const int32_t normalizedLen =
+                unorm2_normalize(nfc, chars + segmentStart, segmentEnd - segmentStart,
+                                 normalized, MAX_HYPHENATED_SIZE, &status);
+        if (U_FAILURE(status)) {
+            return false;
+        }
+        for (int32_t i = 0; i < normalizedLen;) {
+            if (count + 2 > MAX_HYPHENATED_SIZE) {
+                return false;
             }
-            alpha_codes[i + 1] = AlphabetTable1::value(entry);
+            offsets[count] = i == 0 ? segmentStart : kInsideSegment;
+            U16_NEXT(normalized, i, normalizedLen, c);
+            codePoints[count++] = c;
         }
-        alpha_codes[word.size() + 1] = 0;
-        return result;
+        segmentStart = segmentEnd;
     }
-    return HyphenationType::DONT_BREAK;
+    if (count < mMinPrefix + mMinSuffix) {
+        return false;
+    }
+
+    uint16_t alpha_codes[MAX_HYPHENATED_SIZE];
+    const HyphenationType hyphenValue =
+            lookupAlphabet(getHeader(), alpha_codes, codePoints, count);
+    if (hyphenValue == HyphenationType::DONT_BREAK) {
+        return false;
+    }
+    HyphenationType result[MAX_HYPHENATED_SIZE] = {};
+    hyphenateFromCodes(alpha_codes, count + 2, hyphenValue, result);
+    // Breaks inside of a segment or a surrogate pair are dropped.
+    std::fill(out, out + len, HyphenationType::DONT_BREAK);
+    for (size_t i = 0; i < count; i++) {
+        if (offsets[i] != kInsideSegment) {
+            out[offsets[i]] = result[i];
+        }
+    }
+    return true;
 }
 
 /**
@@ -354,38 +618,69 @@ void Hyphenator::hyphenateFromCodes(const uint16_t* codes, size_t len, Hyphenati
     uint8_t* buffer = reinterpret_cast<uint8_t*>(out);
 
     const Header* header = getHeader();
-    const Trie* trie = header->trieTable();
     const Pattern* pattern = header->patternTable();
-    uint32_t char_mask = trie->char_mask;
-    uint32_t link_shift = trie->link_shift;
-    uint32_t link_mask = trie->link_mask;
-    uint32_t pattern_shift = trie->pattern_shift;
     size_t maxOffset = len - mMinSuffix - 1;
-    for (size_t i = 0; i < len - 1; i++) {
-        uint32_t node = 0;  // index into Trie table
-        for (size_t j = i; j < len; j++) {
-            uint16_t c = codes[j];
-            uint32_t entry = trie->data[node + c];
-            if ((entry & char_mask) == c) {
-                node = (entry & link_mask) >> link_shift;
-            } else {
-                break;
+    // pat_ix contains a 3-tuple of length, shift (number of trailing zeros), and an offset into
+    // the buf pool. This is the pattern for a substring of codes ending at j, which we combine
+    // (via point-wise max) into the buffer vector.
+    auto applyPattern = [&](uint32_t pat_ix, size_t j) {
+        uint32_t pat_entry = pattern->data[pat_ix];
+        int pat_len = Pattern::len(pat_entry);
+        int pat_shift = Pattern::shift(pat_entry);
+        const uint8_t* pat_buf = pattern->buf(pat_entry);
+        int offset = j + 1 - (pat_len + pat_shift);
+        // offset is the index within buffer that lines up with the start of pat_buf
+        int start = std::max((int)mMinPrefix - offset, 0);
+        int end = std::min(pat_len, (int)maxOffset - offset);
+        for (int k = start; k < end; k++) {
+            buffer[offset + k] = std::max(buffer[offset + k], pat_buf[k]);
+        }
+    };
+
+    if (const Automaton* automaton = header->automaton()) {
+        // Find all the patterns in one pass over the codes.
+        const Automaton::State* states = automaton->states;
+        const uint32_t* gotoTable = automaton->gotoTable();
+        uint32_t char_mask = automaton->char_mask;
+        uint32_t link_shift = automaton->link_shift;
+        uint32_t link_mask = automaton->link_mask;
+        uint32_t state = 0;
+        for (size_t j = 0; j < len; j++) {
+            const uint32_t c = codes[j];
+            while (true) {
+                uint32_t entry = gotoTable[states[state].base + c];
+                if ((entry & char_mask) == c + 1) {
+                    state = (entry & link_mask) >> link_shift;
+                    break;
+                } else if (state == 0) {
+                    break;  // No pattern starts with c, stay at the root.
+                }
+                state = states[state].fail;
+            }
+            uint32_t match = states[state].pattern != 0 ? state : states[state].output;
+            for (; match != 0; match = states[match].output) {
+                applyPattern(states[match].pattern, j);
             }
-            uint32_t pat_ix = trie->data[node] >> pattern_shift;
-            // pat_ix contains a 3-tuple of length, shift (number of trailing zeros), and an offset
-            // into the buf pool. This is the pattern for the substring (i..j) we just matched,
-            // which we combine (via point-wise max) into the buffer vector.
-            if (pat_ix != 0) {
-                uint32_t pat_entry = pattern->data[pat_ix];
-                int pat_len = Pattern::len(pat_entry);
-                int pat_shift = Pattern::shift(pat_entry);
-                const uint8_t* pat_buf = pattern->buf(pat_entry);
-                int offset = j + 1 - (pat_len + pat_shift);
-                // offset is the index within buffer that lines up with the start of pat_buf
-                int start = std::max((int)mMinPrefix - offset, 0);
-                int end = std::min(pat_len, (int)maxOffset - offset);
-                for (int k = start; k < end; k++) {
-                    buffer[offset + k] = std::max(buffer[offset + k], pat_buf[k]);
+        }
+    } else {
+        const Trie* trie = header->trieTable();
+        uint32_t char_mask = trie->char_mask;
+        uint32_t link_shift = trie->link_shift;
+        uint32_t link_mask = trie->link_mask;
+        uint32_t pattern_shift = trie->pattern_shift;
+        for (size_t i = 0; i < len - 1; i++) {
+            uint32_t node = 0;  // index into Trie table
+            for (size_t j = i; j < len; j++) {
+                uint16_t c = codes[j];
+                uint32_t entry = trie->data[node + c];
+                if ((entry & char_mask) == c) {
+                    node = (entry & link_mask) >> link_shift;
+                } else {
+                    break;
+                }
+                uint32_t pat_ix = trie->data[node] >> pattern_shift;
+                if (pat_ix != 0) {
+                    applyPattern(pat_ix, j);
                 }
             }
         }
@@ -16,6 +16,9 @@
 
 #include "HyphenatorMap.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
 
@@ -29,14 +32,29 @@ constexpr SubtagBits VARIANT = SubtagBits::VARIANT;
 
 constexpr int DEFAULT_MIN_PREFIX = 2;
 constexpr int DEFAULT_MAX_PREFIX = 2;
+
+std::atomic<uint64_t> gNextSnapshotGeneration = {1};
+
+// The last lookup result of this thread. Line breaking looks up the same locale over and over.
+struct LastLookup {
+    uint64_t generation = 0;  // 0 is never used by a snapshot.
+    uint64_t id = 0;
+    const Hyphenator* hyphenator = nullptr;
+};
+thread_local LastLookup tLastLookup;
 }  // namespace
 
-// Following two function's implementations are here since Hyphenator.cpp can't include
+// Following three function's implementations are here since Hyphenator.cpp can't include
 // HyphenatorMap.h due to harfbuzz dependency on the host binary.
 void addHyphenator(const std::string& localeStr, const Hyphenator* hyphenator) {
     HyphenatorMap::add(localeStr, hyphenator);
 }
 
+void addHyphenatorFile(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                       size_t minSuffix) {
+    HyphenatorMap::addFile(localeStr, path, minPrefix, minSuffix);
+}
+
 void addHyphenatorAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr) {
     HyphenatorMap::addAlias(fromLocaleStr, toLocaleStr);
 }
@@ -48,34 +66,136 @@ HyphenatorMap::HyphenatorMap()
 void HyphenatorMap::addInternal(const std::string& localeStr, const Hyphenator* hyphenator) {
     const Locale locale(localeStr);
     std::lock_guard<std::mutex> lock(mMutex);
-    // Overwrite even if there is already a fallback entry.
     mMap[locale.getIdentifier()] = hyphenator;
+    mPendingFiles.erase(locale.getIdentifier());
+    onRegistrationChanged();
+}
+
+void HyphenatorMap::addFileInternal(const std::string& localeStr, const std::string& path,
+                                    size_t minPrefix, size_t minSuffix) {
+    const Locale locale(localeStr);
+    // Hyphenator only needs the language to pick the language specific rules.
+    const std::string language = localeStr.substr(0, localeStr.find_first_of("-_"));
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPendingFiles[locale.getIdentifier()] =
+            std::make_shared<PendingFile>(PendingFile{path, minPrefix, minSuffix, language});
+    mMap.erase(locale.getIdentifier());
+    onRegistrationChanged();
 }
 
 void HyphenatorMap::clearInternal() {
     std::lock_guard<std::mutex> lock(mMutex);
     mMap.clear();
+    mPendingFiles.clear();
+    onRegistrationChanged();
+}
+
+void HyphenatorMap::onRegistrationChanged() {
+    // A new registration may be a better match for the locales resolved by fallback.
+    mFallbacks.clear();
+    setSnapshot(nullptr);
+}
+
+void HyphenatorMap::setSnapshot(std::unique_ptr<const Snapshot> snapshot) {
+    mGeneration.store(snapshot != nullptr ? snapshot->generation : 0, std::memory_order_release);
+    mSnapshot.store(snapshot.get(), std::memory_order_seq_cst);
+    if (snapshot != nullptr) {
+        mSnapshots.push_back(std::move(snapshot));
+    }
+    reclaimSnapshots();
 }
+
+void HyphenatorMap::reclaimSnapshots() {
+    const Snapshot* current = mSnapshot.load(std::memory_order_relaxed);
+    if (mSnapshots.empty() || (mSnapshots.size() == 1 && mSnapshots[0].get() == current)) {
+        return;
+    }
+    // A lookup counts itself before it loads mSnapshot. If there is no such lookup after the
+    // current snapshot is stored, the ones from now on can only read the current snapshot.
+    if (mReaderCount.load(std::memory_order_seq_cst) != 0) {
+        return;  // Try again on the next change.
+    }
+    mSnapshots.erase(std::remove_if(mSnapshots.begin(), mSnapshots.end(),
+                                    [current](const std::unique_ptr<const Snapshot>& snapshot) {
+                                        return snapshot.get() != current;
+                                    }),
+                     mSnapshots.end());
+}
+
+size_t HyphenatorMap::getSnapshotCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSnapshots.size();
+}
+
 void HyphenatorMap::addAliasInternal(const std::string& fromLocaleStr,
                                      const std::string& toLocaleStr) {
     const Locale fromLocale(fromLocaleStr);
     const Locale toLocale(toLocaleStr);
     std::lock_guard<std::mutex> lock(mMutex);
     auto it = mMap.find(toLocale.getIdentifier());
-    if (it == mMap.end()) {
-        ALOGE("Target Hyphenator not found.");
-        return;
+    if (it != mMap.end()) {
+        mMap[fromLocale.getIdentifier()] = it->second;
+        mPendingFiles.erase(fromLocale.getIdentifier());
+    } else {
+        auto pendingIt = mPendingFiles.find(toLocale.getIdentifier());
+        if (pendingIt == mPendingFiles.end()) {
+            ALOGE("Target Hyphenator not found.");
+            return;
+        }
+        mPendingFiles[fromLocale.getIdentifier()] = pendingIt->second;
+        mMap.erase(fromLocale.getIdentifier());
     }
-    // Overwrite even if there is already a fallback entry.
-    mMap[fromLocale.getIdentifier()] = it->second;
+    onRegistrationChanged();
 }
 
 const Hyphenator* HyphenatorMap::lookupInternal(const Locale& locale) {
     const uint64_t id = locale.getIdentifier();
-    std::lock_guard<std::mutex> lock(mMutex);
+    LastLookup& last = tLastLookup;
+    const uint64_t generation = mGeneration.load(std::memory_order_acquire);
+    if (generation != 0 && last.generation == generation && last.id == id) {
+        return last.hyphenator;
+    }
+
+    const Hyphenator* result = nullptr;
+    mReaderCount.fetch_add(1, std::memory_order_seq_cst);
+    const Snapshot* snapshot = mSnapshot.load(std::memory_order_seq_cst);
+    if (snapshot != nullptr) {
+        result = snapshot->find(id);
+        if (result != nullptr) {
+            last = {snapshot->generation, id, result};
+        }
+    }
+    mReaderCount.fetch_sub(1, std::memory_order_release);
+    return result != nullptr ? result : lookupSlow(locale);
+}
+
+const Hyphenator* HyphenatorMap::lookupSlow(const Locale& locale) {
+    while (true) {
+        std::shared_ptr<PendingFile> file;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            file = findPendingFile(locale);
+            if (file == nullptr) {
+                return lookupLocked(locale);
+            }
+        }
+        // Map the file without blocking the other lookups on the I/O. If another lookup maps it
+        // at the same time, only one of the mappings is installed.
+        std::unique_ptr<MappedFile> mappedFile = mapPendingFile(*file);
+        std::lock_guard<std::mutex> lock(mMutex);
+        installPendingFile(file, std::move(mappedFile));
+    }
+}
+
+const Hyphenator* HyphenatorMap::lookupLocked(const Locale& locale) {
+    const uint64_t id = locale.getIdentifier();
     const Hyphenator* result = lookupByIdentifier(id);
     if (result != nullptr) {
-        return result;  // Found with exact match.
+        goto publish_and_return;  // Found with exact match.
+    }
+    if (auto it = mFallbacks.find(id); it != mFallbacks.end()) {
+        result = it->second;
+        goto publish_and_return;  // Resolved before.
     }
 
     // First, try with dropping emoji extensions.
@@ -108,16 +228,106 @@ const Hyphenator* HyphenatorMap::lookupInternal(const Locale& locale) {
     result = mSoftHyphenOnlyHyphenator;
 
 insert_result_and_return:
-    mMap.insert(std::make_pair(id, result));
+    mFallbacks.insert(std::make_pair(id, result));
+    setSnapshot(std::make_unique<Snapshot>(gNextSnapshotGeneration++, mMap, mFallbacks));
     return result;
+
+publish_and_return:
+    if (mSnapshot.load(std::memory_order_relaxed) == nullptr) {
+        setSnapshot(std::make_unique<Snapshot>(gNextSnapshotGeneration++, mMap, mFallbacks));
+    } else {
+        reclaimSnapshots();
+    }
+    return result;
+}
+
+HyphenatorMap::Snapshot::Snapshot(uint64_t generation, const HyphenatorTable& registrations,
+                                  const HyphenatorTable& fallbacks)
+        : generation(generation) {
+    entries.reserve(registrations.size() + fallbacks.size());
+    std::merge(registrations.begin(), registrations.end(), fallbacks.begin(), fallbacks.end(),
+               std::back_inserter(entries));
+}
+
+const Hyphenator* HyphenatorMap::Snapshot::find(uint64_t id) const {
+    auto it = std::lower_bound(
+            entries.begin(), entries.end(), id,
+            [](const std::pair<uint64_t, const Hyphenator*>& entry, uint64_t key) {
+                return entry.first < key;
+            });
+    return it != entries.end() && it->first == id ? it->second : nullptr;
+}
+
+std::shared_ptr<HyphenatorMap::PendingFile> HyphenatorMap::findPendingFile(const Locale& locale) {
+    const uint64_t id = locale.getIdentifier();
+    if (mMap.find(id) != mMap.end() || mFallbacks.find(id) != mFallbacks.end()) {
+        return nullptr;
+    }
+    if (auto it = mPendingFiles.find(id); it != mPendingFiles.end()) {
+        return it->second;
+    }
+    // Same order as the rules in lookupLocked.
+    for (SubtagBits bits : {LANGUAGE | REGION | SCRIPT | VARIANT, LANGUAGE | REGION | VARIANT,
+                            LANGUAGE | VARIANT, LANGUAGE, SCRIPT}) {
+        const Locale partialLocale = locale.getPartialLocale(bits);
+        if (!partialLocale.isSupported() || partialLocale == locale) {
+            continue;
+        }
+        const uint64_t partialId = partialLocale.getIdentifier();
+        if (mMap.find(partialId) != mMap.end()) {
+            return nullptr;
+        }
+        if (auto it = mPendingFiles.find(partialId); it != mPendingFiles.end()) {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+// static
+std::unique_ptr<MappedFile> HyphenatorMap::mapPendingFile(const PendingFile& file) {
+    std::unique_ptr<MappedFile> mappedFile = MappedFile::open(file.path);
+    if (mappedFile == nullptr) {
+        return nullptr;
+    }
+    if (!Hyphenator::isValidBinary(static_cast<const uint8_t*>(mappedFile->data()),
+                                   mappedFile->size())) {
+        ALOGE("Invalid hyphenation pattern file: %s", file.path.c_str());
+        return nullptr;
+    }
+    return mappedFile;
+}
+
+void HyphenatorMap::installPendingFile(const std::shared_ptr<PendingFile>& file,
+                                       std::unique_ptr<MappedFile> mappedFile) {
+    const Hyphenator* hyphenator = nullptr;
+    // Resolve all the locales sharing the file at once, so that the file is mapped only once.
+    for (auto it = mPendingFiles.begin(); it != mPendingFiles.end();) {
+        if (it->second != file) {
+            it++;
+            continue;
+        }
+        if (hyphenator == nullptr && mappedFile != nullptr) {
+            hyphenator = Hyphenator::loadBinary(static_cast<const uint8_t*>(mappedFile->data()),
+                                                file->minPrefix, file->minSuffix, file->language);
+            mMappedFiles.push_back(std::move(mappedFile));
+        }
+        if (hyphenator != nullptr) {
+            mMap[it->first] = hyphenator;
+        }
+        it = mPendingFiles.erase(it);
+    }
+    // The fallbacks resolved before did not reach the file, since they would have loaded it, so
+    // they are kept. The locales of the file are published with the next snapshot.
+    setSnapshot(nullptr);
 }
 
-const Hyphenator* HyphenatorMap::lookupByIdentifier(uint64_t id) const {
+const Hyphenator* HyphenatorMap::lookupByIdentifier(uint64_t id) {
     auto it = mMap.find(id);
-    return it == mMap.end() ? nullptr : it->second;
+    return it != mMap.end() ? it->second : nullptr;
 }
 
-const Hyphenator* HyphenatorMap::lookupBySubtag(const Locale& locale, SubtagBits bits) const {
+const Hyphenator* HyphenatorMap::lookupBySubtag(const Locale& locale, SubtagBits bits) {
     const Locale partialLocale = locale.getPartialLocale(bits);
     if (!partialLocale.isSupported() || partialLocale == locale) {
         return nullptr;  // Skip the partial locale result in the same locale or not supported.
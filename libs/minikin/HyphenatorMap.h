@@ -17,11 +17,15 @@
 #ifndef MINIKIN_HYPHENATOR_MAP_H
 #define MINIKIN_HYPHENATOR_MAP_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "minikin/Hyphenator.h"
 #include "minikin/Macros.h"
+#include "minikin/MappedFile.h"
 
 #include "Locale.h"
 
@@ -35,6 +39,14 @@ public:
         getInstance().addInternal(localeStr, hyphenator);
     }
 
+    // Registers the hyb file for the locale without reading it. The file is mapped and its header
+    // is validated by the first lookup which resolves to the locale. If it fails, the locale is
+    // unregistered.
+    static void addFile(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                        size_t minSuffix) {
+        getInstance().addFileInternal(localeStr, path, minPrefix, minSuffix);
+    }
+
     static void addAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr) {
         getInstance().addAliasInternal(fromLocaleStr, toLocaleStr);
     }
@@ -52,16 +64,23 @@ public:
     // 4. If not found, try again with language + variant.
     // 5. If not found, try again with language.
     // 6. If not found, try again with script.
+    //
+    // Lookups of locales seen before do not take a lock. The results, including the fallbacks, are
+    // read from an immutable snapshot of the map which is replaced on changes.
     static const Hyphenator* lookup(const Locale& locale) {
         return getInstance().lookupInternal(locale);
     }
 
 protected:
-    // The following five methods are protected for testing purposes.
+    // The following seven methods are protected for testing purposes.
     HyphenatorMap();  // Use getInstance() instead.
     void addInternal(const std::string& localeStr, const Hyphenator* hyphenator);
+    void addFileInternal(const std::string& localeStr, const std::string& path, size_t minPrefix,
+                         size_t minSuffix);
     void addAliasInternal(const std::string& fromLocaleStr, const std::string& toLocaleStr);
     const Hyphenator* lookupInternal(const Locale& locale);
+    // Returns the number of the snapshots kept alive, including the current one.
+    size_t getSnapshotCount();
 
 private:
     static HyphenatorMap& getInstance() {  // Singleton.
@@ -69,14 +88,80 @@ private:
         return map;
     }
 
+    using HyphenatorTable = std::map<uint64_t, const Hyphenator*>;
+
+    // A hyb file registered with addFile and not looked up yet.
+    struct PendingFile {
+        std::string path;
+        size_t minPrefix;
+        size_t minSuffix;
+        std::string language;
+    };
+
+    // An immutable copy of the registrations and the fallback results. A replaced snapshot is
+    // deleted once no lookup is reading a snapshot, since it may still be reading the replaced one.
+    struct Snapshot {
+        Snapshot(uint64_t generation, const HyphenatorTable& registrations,
+                 const HyphenatorTable& fallbacks);
+
+        // Returns nullptr if the identifier is not in the snapshot.
+        const Hyphenator* find(uint64_t id) const;
+
+        // Unique among all the snapshots of all the maps.
+        const uint64_t generation;
+        // Sorted by the locale identifier.
+        std::vector<std::pair<uint64_t, const Hyphenator*>> entries;
+    };
+
     void clearInternal();
 
-    const Hyphenator* lookupByIdentifier(uint64_t id) const EXCLUSIVE_LOCKS_REQUIRED(mMutex);
-    const Hyphenator* lookupBySubtag(const Locale& locale, SubtagBits bits) const
+    // Maps the files the locale resolves to, then looks it up with lookupLocked.
+    const Hyphenator* lookupSlow(const Locale& locale);
+    // Resolves the locale with the fallback rules, memoizes the result and publishes a snapshot.
+    // The rules must not reach a pending file.
+    const Hyphenator* lookupLocked(const Locale& locale) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Drops the fallback results and makes the next lookup publish a new snapshot.
+    void onRegistrationChanged() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Replaces the current snapshot, which may be nullptr to make the next lookup publish one.
+    void setSnapshot(std::unique_ptr<const Snapshot> snapshot) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Deletes the replaced snapshots if no lookup is reading one.
+    void reclaimSnapshots() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Returns the first pending file the fallback rules reach for the locale before a registered
+    // hyphenator, or nullptr if there is none.
+    std::shared_ptr<PendingFile> findPendingFile(const Locale& locale)
+            EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Maps and validates the file. Returns nullptr if it fails. Called without the lock.
+    static std::unique_ptr<MappedFile> mapPendingFile(const PendingFile& file);
+    // Moves all the locales registered with the file to mMap, or unregisters them if mappedFile
+    // is nullptr. Does nothing if the file is not pending anymore.
+    void installPendingFile(const std::shared_ptr<PendingFile>& file,
+                            std::unique_ptr<MappedFile> mappedFile) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    const Hyphenator* lookupByIdentifier(uint64_t id) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    const Hyphenator* lookupBySubtag(const Locale& locale, SubtagBits bits)
             EXCLUSIVE_LOCKS_REQUIRED(mMutex);
 
     const Hyphenator* mSoftHyphenOnlyHyphenator;
-    std::map<uint64_t, const Hyphenator*> mMap GUARDED_BY(mMutex);
+    HyphenatorTable mMap GUARDED_BY(mMutex);
+    // The registrations whose files are not mapped yet. Aliases share the PendingFile.
+    std::map<uint64_t, std::shared_ptr<PendingFile>> mPendingFiles GUARDED_BY(mMutex);
+    // The hyphenators loaded from the files are never released, same as the registered ones.
+    std::vector<std::unique_ptr<MappedFile>> mMappedFiles GUARDED_BY(mMutex);
+    // The memoized results of the lookups which needed the fallback rules.
+    HyphenatorTable mFallbacks GUARDED_BY(mMutex);
+
+    // The snapshot of the current tables, or nullptr if they were modified since the last one.
+    // Registrations usually come in a batch at startup, so the snapshot is built lazily by the
+    // next lookup instead of on every registration.
+    std::atomic<const Snapshot*> mSnapshot = {nullptr};
+    // The generation of mSnapshot, or 0 if it is nullptr. Lets a lookup of the same locale as the
+    // last one of the thread skip the snapshot.
+    std::atomic<uint64_t> mGeneration = {0};
+    // The number of the lookups reading a snapshot.
+    std::atomic<uint32_t> mReaderCount = {0};
+    // The current snapshot and the replaced ones which may still be read.
+    std::vector<std::unique_ptr<const Snapshot>> mSnapshots GUARDED_BY(mMutex);
 
     std::mutex mMutex;
 };
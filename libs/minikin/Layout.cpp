@@ -147,13 +147,21 @@ float Layout::doLayoutWord(const uint16_t* buf, size_t start, size_t count, size
 }
 
 void Layout::appendLayout(const LayoutPiece& src, size_t start, float extraAdvance) {
+    appendLayoutPiece(src, start, extraAdvance);
+}
+
+void Layout::appendLayout(const LayoutPieceView& src, size_t start, float extraAdvance) {
+    appendLayoutPiece(src, start, extraAdvance);
+}
+
+template <typename Piece>
+void Layout::appendLayoutPiece(const Piece& src, size_t start, float extraAdvance) {
     for (size_t i = 0; i < src.glyphCount(); i++) {
         mGlyphs.emplace_back(src.fontAt(i), src.glyphIdAt(i), mAdvance + src.pointAt(i).x,
                              src.pointAt(i).y);
     }
-    const std::vector<float>& advances = src.advances();
-    for (size_t i = 0; i < advances.size(); i++) {
-        mAdvances[i + start] = advances[i];
+    for (size_t i = 0; i < src.advanceCount(); i++) {
+        mAdvances[i + start] = src.advanceAt(i);
         if (i == 0) {
             mAdvances[start] += extraAdvance;
         }
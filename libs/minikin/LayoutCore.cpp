@@ -203,38 +203,14 @@ static void addFeatures(const std::string& str, std::vector<hb_feature_t>* featu
     }
 }
 
-static inline hb_codepoint_t determineHyphenChar(hb_codepoint_t preferredHyphen, hb_font_t* font) {
-    hb_codepoint_t glyph;
-    if (preferredHyphen == 0x058A    /* ARMENIAN_HYPHEN */
-        || preferredHyphen == 0x05BE /* HEBREW PUNCTUATION MAQAF */
-        || preferredHyphen == 0x1400 /* CANADIAN SYLLABIC HYPHEN */) {
-        if (hb_font_get_nominal_glyph(font, preferredHyphen, &glyph)) {
-            return preferredHyphen;
-        } else {
-            // The original hyphen requested was not supported. Let's try and see if the
-            // Unicode hyphen is supported.
-            preferredHyphen = CHAR_HYPHEN;
-        }
-    }
-    if (preferredHyphen == CHAR_HYPHEN) { /* HYPHEN */
-        // Fallback to ASCII HYPHEN-MINUS if the font didn't have a glyph for the preferred hyphen.
-        // Note that we intentionally don't do anything special if the font doesn't have a
-        // HYPHEN-MINUS either, so a tofu could be shown, hinting towards something missing.
-        if (!hb_font_get_nominal_glyph(font, preferredHyphen, &glyph)) {
-            return 0x002D;  // HYPHEN-MINUS
-        }
-    }
-    return preferredHyphen;
-}
-
 template <typename HyphenEdit>
-static inline void addHyphenToHbBuffer(const HbBufferUniquePtr& buffer, const HbFontUniquePtr& font,
+static inline void addHyphenToHbBuffer(const HbBufferUniquePtr& buffer, const Font& font,
                                        HyphenEdit hyphen, uint32_t cluster) {
     const uint32_t* chars;
     size_t size;
     std::tie(chars, size) = getHyphenString(hyphen);
     for (size_t i = 0; i < size; i++) {
-        hb_buffer_add(buffer.get(), determineHyphenChar(chars[i], font.get()), cluster);
+        hb_buffer_add(buffer.get(), font.getHyphenChar(chars[i]), cluster);
     }
 }
 
@@ -244,7 +220,7 @@ static inline uint32_t addToHbBuffer(const HbBufferUniquePtr& buffer, const uint
                                      size_t start, size_t count, size_t bufSize,
                                      ssize_t scriptRunStart, ssize_t scriptRunEnd,
                                      StartHyphenEdit inStartHyphen, EndHyphenEdit inEndHyphen,
-                                     const HbFontUniquePtr& hbFont) {
+                                     const Font& font) {
     // Only hyphenate the very first script run for starting hyphens.
     const StartHyphenEdit startHyphen =
             (scriptRunStart == 0) ? inStartHyphen : StartHyphenEdit::NO_EDIT;
@@ -269,7 +245,7 @@ static inline uint32_t addToHbBuffer(const HbBufferUniquePtr& buffer, const uint
     if (isInsertion(startHyphen)) {
         // A cluster value of zero guarantees that the inserted hyphen will be in the same
         // cluster with the next codepoint, since there is no pre-context.
-        addHyphenToHbBuffer(buffer, hbFont, startHyphen, 0 /* cluster */);
+        addHyphenToHbBuffer(buffer, font, startHyphen, 0 /* cluster */);
     }
 
     const uint16_t* hbText;
@@ -329,7 +305,7 @@ static inline uint32_t addToHbBuffer(const HbBufferUniquePtr& buffer, const uint
         } else {
             hyphenCluster = cpInfo[numCodepoints - 1].cluster + (uint32_t)hasEndReplacement;
         }
-        addHyphenToHbBuffer(buffer, hbFont, endHyphen, hyphenCluster);
+        addHyphenToHbBuffer(buffer, font, endHyphen, hyphenCluster);
         // Since we have just added to the buffer, cpInfo no longer necessarily points to
         // the right place. Refresh it.
         cpInfo = hb_buffer_get_glyph_infos(buffer.get(), nullptr /* we don't need the size */);
@@ -348,6 +324,9 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
     const size_t bufSize = textBuf.size();
 
     mAdvances.resize(count, 0);  // Need zero filling.
+    // Code units which start a cluster, and clusters which HarfBuzz marked unsafe to break at.
+    std::vector<bool> clusterStarts(count, false);
+    std::vector<bool> unsafeClusters(count, false);
 
     // Usually the number of glyphs are less than number of code units.
     mFontIndices.reserve(count);
@@ -465,7 +444,7 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
 
             const uint32_t clusterStart =
                     addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart, scriptRunEnd,
-                                  startHyphen, endHyphen, hbFont);
+                                  startHyphen, endHyphen, *fakedFont.font);
 
             hb_shape(hbFont.get(), buffer.get(), features.empty() ? NULL : &features[0],
                      features.size());
@@ -504,6 +483,10 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
 
                 if (clusterBaseIndex < count) {
                     mAdvances[clusterBaseIndex] += xAdvance;
+                    clusterStarts[clusterBaseIndex] = true;
+                    if (hb_glyph_info_get_glyph_flags(&info[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK) {
+                        unsafeClusters[clusterBaseIndex] = true;
+                    }
                 } else {
                     ALOGE("cluster %zu (start %zu) out of bounds of count %zu", clusterBaseIndex,
                           start, count);
@@ -516,6 +499,10 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
             }
         }
     }
+    mSafeToBreak.resize(count, false);
+    for (size_t i = 0; i < count; ++i) {
+        mSafeToBreak[i] = i == 0 || (clusterStarts[i] && !unsafeClusters[i]);
+    }
     mFontIndices.shrink_to_fit();
     mGlyphIds.shrink_to_fit();
     mPoints.shrink_to_fit();
@@ -16,6 +16,8 @@
 
 #include "LineBreakerUtil.h"
 
+#include "HyphenationCache.h"
+
 namespace minikin {
 
 // Very long words trigger O(n^2) behavior in hyphenation, so we disable hyphenation for
@@ -39,7 +41,8 @@ std::vector<HyphenationType> hyphenate(const U16StringPiece& str, const Hyphenat
                 // A word just ended. Hyphenate it.
                 const U16StringPiece word = str.substr(Range(wordStart, i));
                 if (word.size() <= LONGEST_HYPHENATED_WORD) {
-                    hyphenator.hyphenate(word, out.data() + wordStart);
+                    HyphenationCache::getInstance().hyphenate(hyphenator, word,
+                                                              out.data() + wordStart);
                 } else {  // Word is too long. Inefficient to hyphenate.
                     out.insert(out.end(), word.size(), HyphenationType::DONT_BREAK);
                 }
@@ -75,28 +75,100 @@ inline void populateHyphenationPoints(
 
     const std::vector<HyphenationType> hyphenResult =
             hyphenate(textBuf.substr(hyphenationTargetRange), hyphenator);
+    std::vector<HyphenSplit> splits;
     for (uint32_t i = hyphenationTargetRange.getStart(); i < hyphenationTargetRange.getEnd(); ++i) {
         const HyphenationType hyph = hyphenResult[hyphenationTargetRange.toRangeOffset(i)];
         if (hyph == HyphenationType::DONT_BREAK) {
             continue;  // Not a hyphenation point.
         }
+        splits.emplace_back(i, editForNextLine(hyph), editForThisLine(hyph));
+    }
+    if (splits.empty()) {
+        return;
+    }
 
-        auto hyphenPart = contextRange.split(i);
-        U16StringPiece firstText = textBuf.substr(hyphenPart.first);
-        U16StringPiece secondText = textBuf.substr(hyphenPart.second);
-        const float first =
-                run.measureHyphenPiece(firstText, Range(0, firstText.size()),
-                                       StartHyphenEdit::NO_EDIT /* start hyphen edit */,
-                                       editForThisLine(hyph) /* end hyphen edit */, pieces);
-        const float second =
-                run.measureHyphenPiece(secondText, Range(0, secondText.size()),
-                                       editForNextLine(hyph) /* start hyphen edit */,
-                                       EndHyphenEdit::NO_EDIT /* end hyphen edit */, pieces);
-
-        out->emplace_back(i, hyph, first, second);
+    // The pieces of all the hyphenation points are measured together, so that the run can share
+    // the work for the whole word among them.
+    const std::vector<std::pair<float, float>> widths =
+            run.measureHyphenPieces(textBuf, contextRange, splits, pieces);
+    for (size_t i = 0; i < splits.size(); ++i) {
+        const uint32_t offset = splits[i].offset;
+        out->emplace_back(offset, hyphenResult[hyphenationTargetRange.toRangeOffset(offset)],
+                          widths[i].first, widths[i].second);
     }
 }
 
+// Iterates word breaks for the line breakers. If the word break points are precomputed in the
+// MeasuredText, replays them without touching ICU. Otherwise iterates them with a WordBreaker.
+//
+// The precomputed breaks follow the iteration of GreedyLineBreaker, which advances to the next
+// break as soon as it reaches the current one. CharProcessor only advances past a break when it
+// feeds the character at it, so a locale change on a break in an email address or URL, where a
+// WordBreaker keeps its current break, replays that break before going on from the locale change.
+class WordBreakIterator {
+public:
+    // precomputed may be null or empty if the word break points are not precomputed.
+    WordBreakIterator(const U16StringPiece& text, const std::vector<WordBreakPoint>* precomputed)
+            : mPrecomputed(precomputed != nullptr && !precomputed->empty() ? precomputed
+                                                                            : nullptr) {
+        if (mPrecomputed == nullptr) {
+            mBreaker.setText(text.data(), text.size());
+        }
+    }
+
+    // Must be called with the same locale changes as MeasuredText::computeWordBreaks.
+    uint32_t followingWithLocale(const Locale& locale, uint32_t from) {
+        if (mPrecomputed == nullptr) {
+            return mBreaker.followingWithLocale(locale, from);
+        }
+        MINIKIN_ASSERT(mNextLocaleStart < mPrecomputed->size(),
+                       "More locale changes than the precomputed ones");
+        const size_t localeStart = mNextLocaleStart;
+        do {
+            mNextLocaleStart++;
+        } while (mNextLocaleStart < mPrecomputed->size() &&
+                 !(*mPrecomputed)[mNextLocaleStart].isLocaleStart);
+        if (localeStart > 0 && current().offset == from && current().inEmailOrUrl) {
+            // The caller has not advanced past the break at from yet. The next break after it is
+            // the one at the locale change.
+            mPendingLocaleStart = localeStart;
+        } else {
+            mIndex = localeStart;
+        }
+        return current().offset;
+    }
+
+    uint32_t next() {
+        if (mPrecomputed == nullptr) {
+            return mBreaker.next();
+        }
+        if (mPendingLocaleStart != 0) {
+            mIndex = mPendingLocaleStart;
+            mPendingLocaleStart = 0;
+        } else if (mIndex + 1 < mNextLocaleStart) {
+            mIndex++;
+        }
+        return current().offset;
+    }
+
+    inline Range wordRange() const {
+        return mPrecomputed == nullptr ? mBreaker.wordRange() : current().wordRange;
+    }
+
+    inline int breakBadness() const {
+        return mPrecomputed == nullptr ? mBreaker.breakBadness() : current().breakBadness;
+    }
+
+private:
+    inline const WordBreakPoint& current() const { return (*mPrecomputed)[mIndex]; }
+
+    const std::vector<WordBreakPoint>* mPrecomputed;
+    size_t mIndex = 0;
+    size_t mNextLocaleStart = 0;  // The index of the first break after the next locale change.
+    size_t mPendingLocaleStart = 0;  // Non-zero if next() goes on from this locale change.
+    WordBreaker mBreaker;
+};
+
 // Processes and retrieve informations from characters in the paragraph.
 struct CharProcessor {
     // The number of spaces.
@@ -143,7 +215,11 @@ struct CharProcessor {
     // Returns the break penalty for the current word break point.
     inline int wordBreakPenalty() const { return breaker.breakBadness(); }
 
-    CharProcessor(const U16StringPiece& text) { breaker.setText(text.data(), text.size()); }
+    CharProcessor(const U16StringPiece& text) : breaker(text, nullptr) {}
+
+    // Uses the word break points precomputed in the MeasuredText, if any.
+    CharProcessor(const U16StringPiece& text, const MeasuredText& measured)
+            : breaker(text, &measured.wordBreaks) {}
 
     // The user of CharProcessor must call updateLocaleIfNecessary with valid locale at least one
     // time before feeding characters.
@@ -185,7 +261,7 @@ private:
     // The current locale list id.
     uint32_t localeListId = LocaleListCache::kInvalidListId;
 
-    WordBreaker breaker;
+    WordBreakIterator breaker;
 };
 }  // namespace minikin
 
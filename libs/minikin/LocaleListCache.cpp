@@ -153,17 +153,22 @@ uint32_t LocaleListCache::getIdInternal(std::vector<Locale>&& locales) {
     return nextId;
 }
 
-uint32_t LocaleListCache::readFromInternal(BufferReader* reader) {
-    uint32_t size = reader->read<uint32_t>();
+template <typename Reader>
+uint32_t LocaleListCache::readFromInternal(Reader* reader) {
+    uint32_t size = reader->readCount();
     std::vector<Locale> locales;
     locales.reserve(size);
     for (uint32_t i = 0; i < size; i++) {
-        locales.emplace_back(reader->read<uint64_t>());
+        locales.emplace_back(reader->template read<uint64_t>());
     }
     std::lock_guard<std::mutex> lock(mMutex);
     return getIdInternal(std::move(locales));
 }
 
+template uint32_t LocaleListCache::readFromInternal<BufferReader>(BufferReader* reader);
+template uint32_t LocaleListCache::readFromInternal<CheckedBufferReader>(
+        CheckedBufferReader* reader);
+
 void LocaleListCache::writeToInternal(BufferWriter* writer, uint32_t id) {
     const LocaleList& localeList = getByIdInternal(id);
     writer->write<uint32_t>(localeList.size());
@@ -38,7 +38,8 @@ public:
     }
 
     // Returns the locale list ID for the LocaleList serialized in the buffer.
-    static inline uint32_t readFrom(BufferReader* reader) {
+    template <typename Reader>
+    static inline uint32_t readFrom(Reader* reader) {
         return getInstance().readFromInternal(reader);
     }
 
@@ -60,7 +61,8 @@ private:
 
     uint32_t getIdInternal(const std::string& locales);
     uint32_t getIdInternal(std::vector<Locale>&& locales) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
-    uint32_t readFromInternal(BufferReader* reader);
+    template <typename Reader>
+    uint32_t readFromInternal(Reader* reader);
     void writeToInternal(BufferWriter* writer, uint32_t id);
     const LocaleList& getByIdInternal(uint32_t id);
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <log/log.h>
+
+namespace minikin {
+
+// static
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return nullptr;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        ALOGE("Failed to open %s", path.c_str());
+        return nullptr;
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps a reference to the file. No need to keep the file descriptor.
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map %s", path.c_str());
+        return nullptr;
+    }
+    return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    munmap(mData, mSize);
+#endif
+}
+
+}  // namespace minikin
@@ -17,37 +17,47 @@
 #define LOG_TAG "Minikin"
 #include "minikin/MeasuredText.h"
 
+#include <numeric>
+
 #include "minikin/Layout.h"
 
 #include "BidiUtils.h"
 #include "LayoutSplitter.h"
 #include "LayoutUtils.h"
 #include "LineBreakerUtil.h"
+#include "ParallelUtils.h"
 
 namespace minikin {
 
 // Helper class for composing character advances.
 class AdvancesCompositor {
 public:
-    AdvancesCompositor(std::vector<float>* outAdvances, LayoutPieces* outPieces)
-            : mOutAdvances(outAdvances), mOutPieces(outPieces) {}
+    AdvancesCompositor(const U16StringPiece& textBuf, std::vector<float>* outAdvances,
+                       LayoutPieces* outPieces)
+            : mTextBuf(textBuf), mOutAdvances(outAdvances), mOutPieces(outPieces) {}
 
-    void setNextRange(const Range& range, bool dir) {
+    void setNextRange(const Range& range, const Range& context, bool dir) {
         mRange = range;
+        mContext = context;
         mDir = dir;
     }
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-        const std::vector<float>& advances = layoutPiece.advances();
-        std::copy(advances.begin(), advances.end(), mOutAdvances->begin() + mRange.getStart());
+    template <typename Piece>
+    void operator()(const Piece& layoutPiece, const MinikinPaint& paint) {
+        for (uint32_t i = 0; i < layoutPiece.advanceCount(); i++) {
+            (*mOutAdvances)[mRange.getStart() + i] = layoutPiece.advanceAt(i);
+        }
 
         if (mOutPieces != nullptr) {
-            mOutPieces->insert(mRange, 0 /* no edit */, layoutPiece, mDir, paint);
+            mOutPieces->insert(mTextBuf, mRange, mContext, 0 /* no edit */, layoutPiece, mDir,
+                               paint);
         }
     }
 
 private:
+    const U16StringPiece& mTextBuf;
     Range mRange;
+    Range mContext;
     bool mDir;
     std::vector<float>* mOutAdvances;
     LayoutPieces* mOutPieces;
@@ -55,13 +65,19 @@ private:
 
 void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* advances,
                           LayoutPieces* precomputed, LayoutPieces* outPieces) const {
-    AdvancesCompositor compositor(advances, outPieces);
+    getMetricsInRange(textBuf, mRange, advances, precomputed, outPieces);
+}
+
+void StyleRun::getMetricsInRange(const U16StringPiece& textBuf, const Range& range,
+                                 std::vector<float>* advances, LayoutPieces* precomputed,
+                                 LayoutPieces* outPieces) const {
+    AdvancesCompositor compositor(textBuf, advances, outPieces);
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
     const uint32_t paintId =
             (precomputed == nullptr) ? LayoutPieces::kNoPaintId : precomputed->findPaintId(mPaint);
-    for (const BidiText::RunInfo info : BidiText(textBuf, mRange, bidiFlag)) {
+    for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
-            compositor.setNextRange(piece, info.isRtl);
+            compositor.setNextRange(piece, context, info.isRtl);
             if (paintId == LayoutPieces::kNoPaintId) {
                 LayoutCache::getInstance().getOrCreate(
                         textBuf.substr(context), piece - context.getStart(), mPaint, info.isRtl,
@@ -78,26 +94,35 @@ void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* adv
 // Helper class for composing total amount of advance
 class TotalAdvanceCompositor {
 public:
-    TotalAdvanceCompositor(LayoutPieces* outPieces) : mTotalAdvance(0), mOutPieces(outPieces) {}
+    // textOffset is the offset of textBuf in the paragraph, which the pieces are recorded at.
+    TotalAdvanceCompositor(const U16StringPiece& textBuf, uint32_t textOffset,
+                           LayoutPieces* outPieces)
+            : mTextBuf(textBuf), mTextOffset(textOffset), mTotalAdvance(0), mOutPieces(outPieces) {}
 
-    void setNextContext(const Range& range, HyphenEdit edit, bool dir) {
+    void setNextContext(const Range& range, const Range& context, HyphenEdit edit, bool dir) {
         mRange = range;
+        mContext = context;
         mEdit = edit;
         mDir = dir;
     }
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
+    template <typename Piece>
+    void operator()(const Piece& layoutPiece, const MinikinPaint& paint) {
         mTotalAdvance += layoutPiece.advance();
         if (mOutPieces != nullptr) {
-            mOutPieces->insert(mRange, mEdit, layoutPiece, mDir, paint);
+            mOutPieces->insert(mTextBuf, mRange, mContext, mEdit, layoutPiece, mDir, paint,
+                               mTextOffset);
         }
     }
 
     float advance() const { return mTotalAdvance; }
 
 private:
+    const U16StringPiece& mTextBuf;
+    uint32_t mTextOffset;
     float mTotalAdvance;
     Range mRange;
+    Range mContext;
     HyphenEdit mEdit;
     bool mDir;
     LayoutPieces* mOutPieces;
@@ -106,7 +131,13 @@ private:
 float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& range,
                                    StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
                                    LayoutPieces* pieces) const {
-    TotalAdvanceCompositor compositor(pieces);
+    return measureHyphenPiece(textBuf, 0 /* textOffset */, range, startHyphen, endHyphen, pieces);
+}
+
+float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, uint32_t textOffset,
+                                   const Range& range, StartHyphenEdit startHyphen,
+                                   EndHyphenEdit endHyphen, LayoutPieces* pieces) const {
+    TotalAdvanceCompositor compositor(textBuf, textOffset, pieces);
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
     for (const BidiText::RunInfo info : BidiText(textBuf, range, bidiFlag)) {
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
@@ -115,7 +146,8 @@ float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& r
             const EndHyphenEdit endEdit =
                     piece.getEnd() == range.getEnd() ? endHyphen : EndHyphenEdit::NO_EDIT;
 
-            compositor.setNextContext(piece, packHyphenEdit(startEdit, endEdit), info.isRtl);
+            compositor.setNextContext(piece, context, packHyphenEdit(startEdit, endEdit),
+                                      info.isRtl);
             LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
                                                    piece - context.getStart(), mPaint, info.isRtl,
                                                    startEdit, endEdit, compositor);
@@ -124,11 +156,121 @@ float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& r
     return compositor.advance();
 }
 
+std::vector<std::pair<float, float>> StyleRun::measureHyphenPieces(
+        const U16StringPiece& textBuf, const Range& range, const std::vector<HyphenSplit>& splits,
+        LayoutPieces* pieces) const {
+    // The hyphenated pieces have to be shaped anyway if they are kept for drawing. Each piece is
+    // shaped on its own text, but recorded at its offset in the paragraph, so that an edit of the
+    // paragraph can tell which of them it replaces.
+    if (pieces != nullptr) {
+        std::vector<std::pair<float, float>> widths;
+        widths.reserve(splits.size());
+        for (const HyphenSplit& split : splits) {
+            const auto [firstRange, secondRange] = range.split(split.offset);
+            const U16StringPiece firstText = textBuf.substr(firstRange);
+            const U16StringPiece secondText = textBuf.substr(secondRange);
+            widths.emplace_back(
+                    measureHyphenPiece(firstText, firstRange.getStart(),
+                                       Range(0, firstText.size()), StartHyphenEdit::NO_EDIT,
+                                       split.endHyphen, pieces),
+                    measureHyphenPiece(secondText, secondRange.getStart(),
+                                       Range(0, secondText.size()), split.startHyphen,
+                                       EndHyphenEdit::NO_EDIT, pieces));
+        }
+        return widths;
+    }
+
+    // The cluster advances of the whole range, which the line breaker usually has shaped already,
+    // and the points where the range can be split without reshaping either side. Collected once
+    // for all the splits, when the first one needs them.
+    const U16StringPiece text = textBuf.substr(range);
+    std::vector<float> advances;
+    std::vector<bool> safeToBreak;
+    const auto collectAdvances = [&]() {
+        advances.resize(text.size(), 0.0f);
+        safeToBreak.resize(text.size(), false);
+        Range pieceRange;
+        auto collect = [&](const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+            for (uint32_t i = 0; i < layoutPiece.advanceCount(); i++) {
+                advances[pieceRange.getStart() + i] = layoutPiece.advanceAt(i);
+                safeToBreak[pieceRange.getStart() + i] = layoutPiece.isSafeToBreakAt(i);
+            }
+        };
+        for (const auto[context, piece] : LayoutSplitter(text, Range(0, text.size()), mIsRtl)) {
+            pieceRange = piece;
+            LayoutCache::getInstance().getOrCreate(text.substr(context),
+                                                   piece - context.getStart(), mPaint, mIsRtl,
+                                                   StartHyphenEdit::NO_EDIT,
+                                                   EndHyphenEdit::NO_EDIT, collect);
+        }
+    };
+    const auto sum = [&](uint32_t start, uint32_t end) {
+        return std::accumulate(advances.begin() + start, advances.begin() + end, 0.0f);
+    };
+    const auto measureWithHyphen = [&](const Range& cluster, StartHyphenEdit startEdit,
+                                       EndHyphenEdit endEdit) {
+        const U16StringPiece clusterText = text.substr(cluster);
+        return measureHyphenPiece(clusterText, Range(0, clusterText.size()), startEdit, endEdit,
+                                  nullptr /* pieces */);
+    };
+
+    std::vector<std::pair<float, float>> widths;
+    widths.reserve(splits.size());
+    for (const HyphenSplit& split : splits) {
+        // An inserted ZWJ changes the joining form of the letters before it, so it is left to the
+        // full shaping too.
+        if (split.startHyphen == StartHyphenEdit::INSERT_ZWJ ||
+            split.endHyphen == EndHyphenEdit::INSERT_ZWJ_AND_HYPHEN) {
+            widths.push_back(measureHyphenSplit(textBuf, range, split, nullptr /* pieces */));
+            continue;
+        }
+        if (advances.empty()) {
+            collectAdvances();
+        }
+        const uint32_t splitOffset = split.offset - range.getStart();
+        if (!safeToBreak[splitOffset]) {
+            widths.push_back(measureHyphenSplit(textBuf, range, split, nullptr /* pieces */));
+            continue;
+        }
+
+        // Only the clusters next to the hyphens are shaped again, together with the hyphens.
+        uint32_t tailStart = splitOffset - 1;
+        while (!safeToBreak[tailStart]) {
+            tailStart--;
+        }
+        uint32_t headEnd = splitOffset + 1;
+        while (headEnd < text.size() && !safeToBreak[headEnd]) {
+            headEnd++;
+        }
+
+        float first = sum(0, tailStart);
+        if (split.endHyphen == EndHyphenEdit::NO_EDIT) {
+            first += sum(tailStart, splitOffset);
+        } else {
+            first += measureWithHyphen(Range(tailStart, splitOffset), StartHyphenEdit::NO_EDIT,
+                                       split.endHyphen);
+        }
+        float second = sum(headEnd, text.size());
+        if (split.startHyphen == StartHyphenEdit::NO_EDIT) {
+            second += sum(splitOffset, headEnd);
+        } else {
+            second += measureWithHyphen(Range(splitOffset, headEnd), split.startHyphen,
+                                        EndHyphenEdit::NO_EDIT);
+        }
+        widths.emplace_back(first, second);
+    }
+    return widths;
+}
+
 void MeasuredText::measure(const U16StringPiece& textBuf, bool computeHyphenation,
-                           bool computeLayout, MeasuredText* hint) {
+                           bool computeLayout, MeasuredText* hint, uint32_t threadCount) {
     if (textBuf.size() == 0) {
         return;
     }
+    if (threadCount > 1) {
+        measureInParallel(textBuf, computeHyphenation, computeLayout, hint, threadCount);
+        return;
+    }
 
     LayoutPieces* piecesOut = computeLayout ? &layoutPieces : nullptr;
     CharProcessor proc(textBuf);
@@ -158,6 +300,268 @@ void MeasuredText::measure(const U16StringPiece& textBuf, bool computeHyphenatio
     }
 }
 
+namespace {
+
+// A word to be hyphenated, found by the serial word break iteration.
+struct HyphenationTarget {
+    const Run* run;
+    const Hyphenator* hyphenator;
+    Range contextRange;
+    Range wordRange;
+};
+
+// The number of hyphenation targets processed as one work item. Each work item has its own
+// output, so this amortizes the allocation of LayoutPieces.
+constexpr size_t kHyphenationTargetsPerItem = 64;
+
+// Iterates word breaks and returns the words to be hyphenated in text order, from the start of the
+// locale run containing the start of range up to the first word starting at or after its end. The
+// iteration over all the runs restarts at each locale change too, so the words are the same,
+// unless the locale changes in an email address or URL. Such locale changes are skipped.
+std::vector<HyphenationTarget> collectHyphenationTargets(
+        const U16StringPiece& textBuf, const std::vector<std::unique_ptr<Run>>& runs,
+        const std::vector<float>& widths, const Range& range) {
+    size_t firstRun = runs.size();
+    uint32_t localeListId = LocaleListCache::kInvalidListId;
+    for (size_t i = 0; i < runs.size() && runs[i]->getRange().getStart() <= range.getStart(); i++) {
+        if (!runs[i]->canBreak() || runs[i]->getLocaleListId() == localeListId) {
+            continue;
+        }
+        localeListId = runs[i]->getLocaleListId();
+        if (firstRun == runs.size() ||
+            !WordBreaker::mayBeInEmailOrUrl(textBuf, runs[i]->getRange().getStart())) {
+            firstRun = i;
+        }
+    }
+    if (firstRun == runs.size()) {
+        firstRun = 0;
+    }
+
+    std::vector<HyphenationTarget> targets;
+    CharProcessor proc(textBuf);
+    for (size_t runIndex = firstRun; runIndex < runs.size(); runIndex++) {
+        const Run& run = *runs[runIndex];
+        if (!run.canBreak()) {
+            continue;
+        }
+        const Range& runRange = run.getRange();
+        proc.updateLocaleIfNecessary(run);
+        for (uint32_t i = runRange.getStart(); i < runRange.getEnd(); ++i) {
+            proc.feedChar(i, textBuf[i], widths[i], true /* canBreakHere */);
+            if (i + 1 == proc.nextWordBreak) {
+                targets.push_back({&run, proc.hyphenator, proc.contextRange(), proc.wordRange()});
+                if (proc.contextRange().getStart() >= range.getEnd()) {
+                    return targets;
+                }
+            }
+        }
+    }
+    return targets;
+}
+
+}  // namespace
+
+// Measures in three phases so that the result is identical to the serial measurement:
+// 1. Shapes each run in parallel. Runs write to disjoint ranges of widths.
+// 2. Iterates word breaks serially, since the word breaker state depends on the preceding runs.
+//    Only collects the words to be hyphenated here.
+// 3. Hyphenates and measures the collected words in parallel.
+// The layout pieces and the hyphenation points of each work item are merged in order.
+void MeasuredText::measureInParallel(const U16StringPiece& textBuf, bool computeHyphenation,
+                                     bool computeLayout, MeasuredText* hint,
+                                     uint32_t threadCount) {
+    LayoutPieces* precomputed = hint ? &hint->layoutPieces : nullptr;
+    std::vector<LayoutPieces> runPieces(computeLayout ? runs.size() : 0);
+    parallelFor(runs.size(), threadCount, [&](size_t i) {
+        runs[i]->getMetrics(textBuf, &widths, precomputed,
+                            computeLayout ? &runPieces[i] : nullptr);
+    });
+    for (const LayoutPieces& pieces : runPieces) {
+        layoutPieces.merge(pieces);
+    }
+
+    if (!computeHyphenation) {
+        return;
+    }
+
+    const std::vector<HyphenationTarget> targets =
+            collectHyphenationTargets(textBuf, runs, widths, Range(0, textBuf.size()));
+    const size_t itemCount =
+            (targets.size() + kHyphenationTargetsPerItem - 1) / kHyphenationTargetsPerItem;
+    std::vector<std::vector<HyphenBreak>> itemBreaks(itemCount);
+    std::vector<LayoutPieces> itemPieces(computeLayout ? itemCount : 0);
+    parallelFor(itemCount, threadCount, [&](size_t item) {
+        const size_t end = std::min(targets.size(), (item + 1) * kHyphenationTargetsPerItem);
+        for (size_t i = item * kHyphenationTargetsPerItem; i < end; i++) {
+            const HyphenationTarget& target = targets[i];
+            populateHyphenationPoints(textBuf, *target.run, *target.hyphenator,
+                                      target.contextRange, target.wordRange, &itemBreaks[item],
+                                      computeLayout ? &itemPieces[item] : nullptr);
+        }
+    });
+    for (size_t item = 0; item < itemCount; item++) {
+        hyphenBreaks.insert(hyphenBreaks.end(), itemBreaks[item].begin(), itemBreaks[item].end());
+        if (computeLayout) {
+            layoutPieces.merge(itemPieces[item]);
+        }
+    }
+}
+
+// Re-measures only around the edit:
+// 1. The layout of a character only depends on the text between the surrounding word breaks for
+//    the layout cache, so only the characters between the cache word breaks around the edit are
+//    shaped again. The other widths are copied with shifted offsets.
+// 2. The word breaks are iterated again from the start of the locale run before the shaped range
+//    up to the first word after it. Only the words overlapping the shaped range are hyphenated
+//    again, together with one more word on each side since line break rules may look across a
+//    space, e.g. after an opening parenthesis. The other hyphenation points are copied with
+//    shifted offsets.
+// 3. The layout pieces are keyed by their content, so the pieces of previous are copied as they
+//    are, except the ones whose context overlaps the text measured again. Otherwise the pieces of
+//    the replaced text would pile up over a sequence of edits.
+void MeasuredText::remeasure(const U16StringPiece& textBuf, bool computeHyphenation,
+                             bool computeLayout, const MeasuredText& previous,
+                             const Range& editRange, uint32_t newLength) {
+    const uint32_t oldSize = previous.widths.size();
+    if (editRange.getEnd() > oldSize ||
+        oldSize - editRange.getLength() + newLength != textBuf.size()) {
+        // The text is not an edit of the previous text. Measure everything.
+        widths.resize(textBuf.size());
+        measure(textBuf, computeHyphenation, computeLayout, nullptr /* hint */, 1);
+        return;
+    }
+    if (textBuf.size() == 0) {
+        return;
+    }
+
+    const int32_t delta = static_cast<int32_t>(newLength) - editRange.getLength();
+    const Range dirtyRange(getPrevWordBreakForCache(textBuf, editRange.getStart()),
+                           getNextWordBreakForCache(textBuf, editRange.getStart() + newLength));
+    // The dirty range in the offsets of the previous text.
+    const Range oldDirtyRange(dirtyRange.getStart(), dirtyRange.getEnd() - delta);
+
+    widths.resize(textBuf.size());
+    std::copy(previous.widths.begin(), previous.widths.begin() + dirtyRange.getStart(),
+              widths.begin());
+    std::copy(previous.widths.begin() + oldDirtyRange.getEnd(), previous.widths.end(),
+              widths.begin() + dirtyRange.getEnd());
+
+    LayoutPieces* piecesOut = computeLayout ? &layoutPieces : nullptr;
+    for (const auto& run : runs) {
+        const Range& runRange = run->getRange();
+        if (!Range::intersects(runRange, dirtyRange)) {
+            continue;
+        }
+        run->getMetricsInRange(textBuf, Range::intersection(runRange, dirtyRange), &widths,
+                               nullptr /* precomputed */, piecesOut);
+    }
+
+    // The range of previous whose hyphenated pieces are measured again.
+    Range oldHyphenationRange = oldDirtyRange;
+    if (computeHyphenation) {
+        oldHyphenationRange = rehyphenate(textBuf, previous, dirtyRange, delta, piecesOut);
+    }
+
+    if (computeLayout) {
+        layoutPieces.merge(previous.layoutPieces, [&](const LayoutPieces::Key& key,
+                                                      Range* context) {
+            const Range& measuredAgain = key.hyphenEdit == 0 ? oldDirtyRange : oldHyphenationRange;
+            // Not Range::intersects, since an empty range still invalidates the contexts around it.
+            if (context->getStart() < measuredAgain.getEnd() &&
+                measuredAgain.getStart() < context->getEnd()) {
+                return false;
+            }
+            if (context->getStart() >= editRange.getEnd()) {
+                *context = *context + delta;
+            }
+            return true;
+        });
+    }
+}
+
+// Hyphenates the words around the dirty range again and copies the other hyphenation points of
+// previous with shifted offsets. Returns the range of previous which was hyphenated again.
+Range MeasuredText::rehyphenate(const U16StringPiece& textBuf, const MeasuredText& previous,
+                                const Range& dirtyRange, int32_t delta, LayoutPieces* piecesOut) {
+    const std::vector<HyphenationTarget> targets = collectHyphenationTargets(
+            textBuf, runs, widths,
+            Range(getPrevWordBreakForCache(textBuf, dirtyRange.getStart()), dirtyRange.getEnd()));
+    size_t first = 0;
+    while (first < targets.size() &&
+           targets[first].contextRange.getEnd() <= dirtyRange.getStart()) {
+        first++;
+    }
+    size_t last = first;
+    while (last < targets.size() && targets[last].contextRange.getStart() < dirtyRange.getEnd()) {
+        last++;
+    }
+    first = first == 0 ? 0 : first - 1;
+    last = std::min(last + 1, targets.size());
+
+    uint32_t hyphenationStart = dirtyRange.getStart();
+    uint32_t hyphenationEnd = dirtyRange.getEnd();
+    if (first < last) {
+        // The context of the first word after a locale change starts in the previous run, whose
+        // words are not hyphenated again.
+        const HyphenationTarget& firstTarget = targets[first];
+        hyphenationStart = std::min(hyphenationStart,
+                                    std::max(firstTarget.contextRange.getStart(),
+                                             firstTarget.run->getRange().getStart()));
+        hyphenationEnd = std::max(hyphenationEnd, targets[last - 1].contextRange.getEnd());
+    }
+    const uint32_t oldHyphenationEnd = hyphenationEnd - delta;
+
+    for (const HyphenBreak& hyphenBreak : previous.hyphenBreaks) {
+        if (hyphenBreak.offset >= hyphenationStart) {
+            break;
+        }
+        hyphenBreaks.push_back(hyphenBreak);
+    }
+    for (size_t i = first; i < last; i++) {
+        const HyphenationTarget& target = targets[i];
+        populateHyphenationPoints(textBuf, *target.run, *target.hyphenator, target.contextRange,
+                                  target.wordRange, &hyphenBreaks, piecesOut);
+    }
+    for (const HyphenBreak& hyphenBreak : previous.hyphenBreaks) {
+        if (hyphenBreak.offset >= oldHyphenationEnd) {
+            hyphenBreaks.emplace_back(hyphenBreak.offset + delta, hyphenBreak.type,
+                                      hyphenBreak.first, hyphenBreak.second);
+        }
+    }
+    return Range(hyphenationStart, oldHyphenationEnd);
+}
+
+// Replays the word break iteration of GreedyLineBreaker::process, moving to the next break once the
+// current one is reached, and records the state of the word breaker at each break.
+void MeasuredText::computeWordBreaks(const U16StringPiece& textBuf) {
+    wordBreaks.clear();
+    if (textBuf.size() == 0) {
+        return;
+    }
+    WordBreaker breaker;
+    breaker.setText(textBuf.data(), textBuf.size());
+    uint32_t localeListId = LocaleListCache::kInvalidListId;
+    uint32_t nextWordBreak = 0;
+    for (const auto& run : runs) {
+        const Range& range = run->getRange();
+        const uint32_t newLocaleListId = run->getLocaleListId();
+        if (localeListId != newLocaleListId) {
+            nextWordBreak = breaker.followingWithLocale(getEffectiveLocale(newLocaleListId),
+                                                        range.getStart());
+            wordBreaks.emplace_back(nextWordBreak, breaker.wordRange(), breaker.breakBadness(),
+                                    true /* isLocaleStart */, breaker.isInEmailOrUrl());
+            localeListId = newLocaleListId;
+        }
+        for (uint32_t i = range.getStart(); i < range.getEnd(); ++i) {
+            if (i + 1 == nextWordBreak) {
+                nextWordBreak = breaker.next();
+                wordBreaks.emplace_back(nextWordBreak, breaker.wordRange(), breaker.breakBadness(),
+                                        false /* isLocaleStart */, breaker.isInEmailOrUrl());
+            }
+        }
+    }
+}
+
 // Helper class for composing Layout object.
 class LayoutCompositor {
 public:
@@ -166,7 +570,8 @@ public:
 
     void setOutOffset(uint32_t outOffset) { mOutOffset = outOffset; }
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+    template <typename Piece>
+    void operator()(const Piece& layoutPiece, const MinikinPaint& /* paint */) {
         mOutLayout->appendLayout(layoutPiece, mOutOffset, mExtraAdvance);
     }
 
@@ -213,7 +618,8 @@ class BoundsCompositor {
 public:
     BoundsCompositor() : mAdvance(0) {}
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
+    template <typename Piece>
+    void operator()(const Piece& layoutPiece, const MinikinPaint& paint) {
         MinikinRect pieceBounds;
         MinikinRect tmpRect;
         for (uint32_t i = 0; i < layoutPiece.glyphCount(); ++i) {
@@ -258,7 +664,8 @@ class ExtentCompositor {
 public:
     ExtentCompositor() {}
 
-    void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& /* paint */) {
+    template <typename Piece>
+    void operator()(const Piece& layoutPiece, const MinikinPaint& /* paint */) {
         mExtent.extendBy(layoutPiece.extent());
     }
 
@@ -335,4 +742,95 @@ MinikinExtent MeasuredText::getExtent(const U16StringPiece& textBuf, const Range
     return extent;
 }
 
+namespace {
+
+// The run which refers to a run kept in MeasuredTextBuilder, for building a range without
+// splitting the run.
+class RunRef : public Run {
+public:
+    RunRef(const Run& run) : Run(run.getRange()), mRun(run) {}
+
+    bool isRtl() const override { return mRun.isRtl(); }
+    bool canBreak() const override { return mRun.canBreak(); }
+    uint32_t getLocaleListId() const override { return mRun.getLocaleListId(); }
+
+    void getMetrics(const U16StringPiece& text, std::vector<float>* advances,
+                    LayoutPieces* precomputed, LayoutPieces* outPieces) const override {
+        mRun.getMetrics(text, advances, precomputed, outPieces);
+    }
+
+    void getMetricsInRange(const U16StringPiece& text, const Range& range,
+                           std::vector<float>* advances, LayoutPieces* precomputed,
+                           LayoutPieces* outPieces) const override {
+        mRun.getMetricsInRange(text, range, advances, precomputed, outPieces);
+    }
+
+    std::pair<float, MinikinRect> getBounds(const U16StringPiece& text, const Range& range,
+                                            const LayoutPieces& pieces) const override {
+        return mRun.getBounds(text, range, pieces);
+    }
+
+    MinikinExtent getExtent(const U16StringPiece& text, const Range& range,
+                            const LayoutPieces& pieces) const override {
+        return mRun.getExtent(text, range, pieces);
+    }
+
+    void appendLayout(const U16StringPiece& text, const Range& range, const Range& contextRange,
+                      const LayoutPieces& pieces, const MinikinPaint& paint, uint32_t outOrigin,
+                      StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                      Layout* outLayout) const override {
+        mRun.appendLayout(text, range, contextRange, pieces, paint, outOrigin, startHyphen,
+                          endHyphen, outLayout);
+    }
+
+    const MinikinPaint* getPaint() const override { return mRun.getPaint(); }
+
+    float measureHyphenPiece(const U16StringPiece& text, const Range& hyphenPieceRange,
+                             StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                             LayoutPieces* pieces) const override {
+        return mRun.measureHyphenPiece(text, hyphenPieceRange, startHyphen, endHyphen, pieces);
+    }
+
+    std::vector<std::pair<float, float>> measureHyphenPieces(
+            const U16StringPiece& text, const Range& range, const std::vector<HyphenSplit>& splits,
+            LayoutPieces* pieces) const override {
+        return mRun.measureHyphenPieces(text, range, splits, pieces);
+    }
+
+    std::unique_ptr<Run> createSubRun(const Range& range, uint32_t origin) const override {
+        return mRun.createSubRun(range, origin);
+    }
+
+private:
+    const Run& mRun;
+};
+
+}  // namespace
+
+std::unique_ptr<MeasuredText> MeasuredTextBuilder::buildRange(const U16StringPiece& textBuf,
+                                                              const Range& range,
+                                                              bool computeHyphenation,
+                                                              bool computeLayout) const {
+    std::vector<std::unique_ptr<Run>> runs;
+    for (const auto& run : mRuns) {
+        const Range& runRange = run->getRange();
+        if (!Range::intersects(runRange, range)) {
+            continue;
+        }
+        std::unique_ptr<Run> subRun =
+                run->createSubRun(Range::intersection(runRange, range), range.getStart());
+        if (subRun == nullptr) {
+            if (range.getStart() != 0 || !range.contains(runRange)) {
+                return nullptr;
+            }
+            // The offsets are the same in the range, so the run is used as is.
+            subRun = std::make_unique<RunRef>(*run);
+        }
+        runs.push_back(std::move(subRun));
+    }
+    return std::unique_ptr<MeasuredText>(
+            new MeasuredText(textBuf.substr(range), std::move(runs), computeHyphenation,
+                             computeLayout, nullptr /* hint */, 1 /* threadCount */));
+}
+
 }  // namespace minikin
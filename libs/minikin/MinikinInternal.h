@@ -49,6 +49,8 @@ constexpr uint32_t VS256 = 0xE01EF;
 // [0x10-0xFF] for U+E0100..U+E01EF
 // INVALID_VS_INDEX for other input.
 constexpr uint16_t INVALID_VS_INDEX = 0xFFFF;
+// The number of valid variation selector indices.
+constexpr uint16_t VS_INDEX_COUNT = 0x100;
 uint16_t getVsIndex(uint32_t codePoint);
 
 // Returns true if the code point is a variation selector.
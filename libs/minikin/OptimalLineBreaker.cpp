@@ -208,7 +208,7 @@ OptimizeContext populateCandidates(const U16StringPiece& textBuf, const Measured
                                    const LineWidth& lineWidth, HyphenationFrequency frequency,
                                    bool isJustified) {
     const ParaWidth minLineWidth = lineWidth.getMin();
-    CharProcessor proc(textBuf);
+    CharProcessor proc(textBuf, measured);
 
     OptimizeContext result;
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParallelUtils.h"
+
+#include <thread>
+
+namespace minikin {
+
+void WorkerPool::run(size_t helperCount, const std::function<void()>& task) {
+    Job job(&task);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        helperCount = std::min(helperCount, kMaxWorkerCount);
+        while (mWorkerCount < helperCount) {
+            std::thread(&WorkerPool::workerLoop, this).detach();
+            mWorkerCount++;
+        }
+        mQueue.insert(mQueue.end(), helperCount, &job);
+    }
+    mJobAvailable.notify_all();
+
+    task();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    // The task is done once the calling thread returns from it, so the helpers which haven't
+    // started yet would have nothing to do.
+    mQueue.erase(std::remove(mQueue.begin(), mQueue.end(), &job), mQueue.end());
+    job.done.wait(lock, [&job] { return job.running == 0; });
+}
+
+size_t WorkerPool::getWorkerCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mWorkerCount;
+}
+
+void WorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mJobAvailable.wait(lock, [this] { return !mQueue.empty(); });
+        Job* job = mQueue.front();
+        mQueue.pop_front();
+        job->running++;
+        lock.unlock();
+        (*job->task)();
+        lock.lock();
+        // Notified under the lock, since the job is destroyed as soon as run() sees no running
+        // worker.
+        if (--job->running == 0) {
+            job->done.notify_all();
+        }
+    }
+}
+
+}  // namespace minikin
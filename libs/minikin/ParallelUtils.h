@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_PARALLEL_UTILS_H
+#define MINIKIN_PARALLEL_UTILS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// A pool of worker threads shared by all the parallel measurements, so that building a
+// MeasuredText doesn't pay for creating and joining threads. The workers are created on demand,
+// up to kMaxWorkerCount, and live until the process exits.
+class WorkerPool {
+public:
+    static WorkerPool& getInstance() {
+        // Never destroyed, since the workers keep waiting for tasks until the process exits.
+        static WorkerPool* pool = new WorkerPool();
+        return *pool;
+    }
+
+    // Runs task on the calling thread and on up to helperCount workers at the same time, and
+    // returns after all of them returned. The task must be safe to be called concurrently. The
+    // helpers which haven't started when the calling thread returns from the task are canceled,
+    // so that this doesn't wait for workers busy with the tasks of other threads.
+    void run(size_t helperCount, const std::function<void()>& task);
+
+    // Returns the number of the workers created so far.
+    size_t getWorkerCount();
+
+    static constexpr size_t kMaxWorkerCount = 16;
+
+private:
+    struct Job {
+        explicit Job(const std::function<void()>* task) : task(task) {}
+
+        const std::function<void()>* task;
+        size_t running = 0;  // The number of the workers running the task.
+        std::condition_variable done;
+    };
+
+    WorkerPool() {}
+
+    void workerLoop();
+
+    std::mutex mMutex;
+    std::condition_variable mJobAvailable;
+    // One entry for each helper requested and not started yet.
+    std::deque<Job*> mQueue GUARDED_BY(mMutex);
+    size_t mWorkerCount GUARDED_BY(mMutex) = 0;
+};
+
+// Calls fn(i) for every i in [0, count) using up to threadCount threads, including the calling
+// thread. Items are handed out one by one from a shared counter, so a thread which finishes its
+// item early takes the next one instead of waiting for a fixed partition. fn must be safe to be
+// called concurrently for different items. Returns after all the items are processed.
+template <typename F>
+void parallelFor(size_t count, uint32_t threadCount, F&& fn) {
+    const size_t workerCount = std::min<size_t>(threadCount, count);
+    if (workerCount <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextItem(0);
+    WorkerPool::getInstance().run(workerCount - 1, [&]() {
+        for (size_t i = nextItem++; i < count; i = nextItem++) {
+            fn(i);
+        }
+    });
+}
+
+}  // namespace minikin
+
+#endif  // MINIKIN_PARALLEL_UTILS_H
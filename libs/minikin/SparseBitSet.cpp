@@ -104,15 +104,39 @@ void SparseBitSet::initFromRanges(const uint32_t* ranges, size_t nRanges) {
     }
 }
 
-void SparseBitSet::initFromBuffer(BufferReader* reader) {
-    mMaxVal = reader->read<uint32_t>();
+template <typename Reader>
+void SparseBitSet::initFromBuffer(Reader* reader) {
+    mMaxVal = reader->template read<uint32_t>();
     // mIndices and mBitmaps are not initialized when mMaxVal == 0
     if (mMaxVal == 0) return;
-    std::tie(mIndices, mIndicesCount) = reader->readArray<uint16_t>();
+    std::tie(mIndices, mIndicesCount) = reader->template readArray<uint16_t>();
     // element is uint32_t
     static_assert(sizeof(element) == 4);
-    std::tie(mBitmaps, mBitmapsCount) = reader->readArray<element>();
-    mZeroPageIndex = reader->read<uint16_t>();
+    std::tie(mBitmaps, mBitmapsCount) = reader->template readArray<element>();
+    mZeroPageIndex = reader->template read<uint16_t>();
+    if constexpr (Reader::kChecked) {
+        if (!isValid()) {
+            reader->setError();
+        }
+        if (reader->hasError()) {
+            *this = SparseBitSet();
+        }
+    }
+}
+
+template void SparseBitSet::initFromBuffer<BufferReader>(BufferReader* reader);
+template void SparseBitSet::initFromBuffer<CheckedBufferReader>(CheckedBufferReader* reader);
+
+bool SparseBitSet::isValid() const {
+    if (mMaxVal > kMaximumCapacity + 1) return false;
+    // Every page below mMaxVal must have an entry in mIndices.
+    uint32_t pageCount = (mMaxVal + kPageMask) >> kLogValuesPerPage;
+    if (mIndicesCount < pageCount) return false;
+    constexpr uint32_t kElementsPerPage = 1 << (kLogValuesPerPage - kLogBitsPerEl);
+    for (uint32_t i = 0; i < mIndicesCount; i++) {
+        if (static_cast<uint32_t>(mIndices[i]) + kElementsPerPage > mBitmapsCount) return false;
+    }
+    return true;
 }
 
 void SparseBitSet::writeTo(BufferWriter* writer) const {
@@ -163,4 +187,33 @@ uint32_t SparseBitSet::nextSetBit(uint32_t fromIndex) const {
     return kNotFound;
 }
 
+void SparseBitSetTableWriter::add(const SparseBitSet* bitset) {
+    if (mIndexByBitSet.find(bitset) != mIndexByBitSet.end()) {
+        return;
+    }
+    BufferWriter fakeWriter(nullptr);
+    bitset->writeTo(&fakeWriter);
+    std::string content(fakeWriter.size(), '\0');
+    BufferWriter writer(content.data());
+    bitset->writeTo(&writer);
+    auto [it, inserted] = mIndexByContent.emplace(std::move(content), mBitSets.size());
+    if (inserted) {
+        mBitSets.push_back(bitset);
+    }
+    mIndexByBitSet.emplace(bitset, it->second);
+}
+
+uint32_t SparseBitSetTableWriter::indexOf(const SparseBitSet* bitset) const {
+    auto it = mIndexByBitSet.find(bitset);
+    MINIKIN_ASSERT(it != mIndexByBitSet.end(), "The bit set is not in the table.");
+    return it->second;
+}
+
+void SparseBitSetTableWriter::writeTo(BufferWriter* writer) const {
+    writer->write<uint32_t>(mBitSets.size());
+    for (const SparseBitSet* bitset : mBitSets) {
+        bitset->writeTo(writer);
+    }
+}
+
 }  // namespace minikin
@@ -16,8 +16,11 @@
 
 #include "WordBreaker.h"
 
+#include <algorithm>
+#include <atomic>
 #include <list>
 #include <map>
+#include <vector>
 
 #include <unicode/ubrk.h>
 #include <unicode/uchar.h>
@@ -40,20 +43,49 @@ static UBreakIterator* createNewIterator(const Locale& locale) {
                         &status);
     return ubrk_open(UBreakIteratorType::UBRK_LINE, localeID, nullptr, 0, &status);
 }
+
+// A breaker released to a pool and kept by the releasing thread.
+struct ThreadSlot {
+    uint32_t poolId;
+    ICULineBreakerPool::Slot slot;
+};
+
+// The breakers released by this thread, the most recently released last. It holds the breakers of
+// all the pools, but in practice only the singleton is used out of tests.
+thread_local std::vector<ThreadSlot> tThreadSlots;
+
+std::atomic<uint32_t> gNextPoolId = {0};
 }  // namespace
 
+ICULineBreakerPoolImpl::ICULineBreakerPoolImpl(size_t maxThreadPoolSize, size_t maxPoolSize)
+        : mId(gNextPoolId++), mMaxThreadPoolSize(maxThreadPoolSize), mMaxPoolSize(maxPoolSize) {}
+
 ICULineBreakerPool::Slot ICULineBreakerPoolImpl::acquire(const Locale& locale) {
     const uint64_t id = locale.getIdentifier();
-    std::lock_guard<std::mutex> lock(mMutex);
-    for (auto i = mPool.begin(); i != mPool.end(); i++) {
-        if (i->localeId == id) {
-            Slot slot = std::move(*i);
-            mPool.erase(i);
+    std::vector<ThreadSlot>& threadSlots = tThreadSlots;
+    for (auto i = threadSlots.rbegin(); i != threadSlots.rend(); i++) {
+        if (i->poolId == mId && i->slot.localeId == id) {
+            Slot slot = std::move(i->slot);
+            threadSlots.erase(std::next(i).base());
+            mThreadHitCount.fetch_add(1, std::memory_order_relaxed);
             return slot;
         }
     }
 
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto i = mPool.begin(); i != mPool.end(); i++) {
+            if (i->localeId == id) {
+                Slot slot = std::move(*i);
+                mPool.erase(i);
+                mSharedHitCount.fetch_add(1, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+    }
+
     // Not found in pool. Create new one.
+    mOpenCount.fetch_add(1, std::memory_order_relaxed);
     return {id, IcuUbrkUniquePtr(createNewIterator(locale))};
 }
 
@@ -61,8 +93,27 @@ void ICULineBreakerPoolImpl::release(ICULineBreakerPool::Slot&& slot) {
     if (slot.breaker.get() == nullptr) {
         return;  // Already released slot. Do nothing.
     }
+    const size_t maxThreadPoolSize = mMaxThreadPoolSize.load(std::memory_order_relaxed);
+    if (maxThreadPoolSize == 0) {
+        releaseToPool(std::move(slot));
+        return;
+    }
+    std::vector<ThreadSlot>& threadSlots = tThreadSlots;
+    threadSlots.push_back({mId, std::move(slot)});
+    while (threadSlots.size() > maxThreadPoolSize) {
+        // Thread cache is full. Move the oldest one to the shared pool. If it belongs to another
+        // pool, which may not be alive anymore, just close it.
+        ThreadSlot oldest = std::move(threadSlots.front());
+        threadSlots.erase(threadSlots.begin());
+        if (oldest.poolId == mId) {
+            releaseToPool(std::move(oldest.slot));
+        }
+    }
+}
+
+void ICULineBreakerPoolImpl::releaseToPool(ICULineBreakerPool::Slot&& slot) {
     std::lock_guard<std::mutex> lock(mMutex);
-    if (mPool.size() >= MAX_POOL_SIZE) {
+    if (mPool.size() >= mMaxPoolSize.load(std::memory_order_relaxed)) {
         // Pool is full. Move to local variable, so that the given slot will be released when the
         // variable leaves the scope.
         Slot localSlot = std::move(slot);
@@ -71,12 +122,36 @@ void ICULineBreakerPoolImpl::release(ICULineBreakerPool::Slot&& slot) {
     mPool.push_front(std::move(slot));
 }
 
+void ICULineBreakerPoolImpl::setMaxPoolSizes(size_t maxThreadPoolSize, size_t maxPoolSize) {
+    mMaxThreadPoolSize.store(maxThreadPoolSize, std::memory_order_relaxed);
+    mMaxPoolSize.store(maxPoolSize, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mMutex);
+    while (mPool.size() > maxPoolSize) {
+        mPool.pop_back();
+    }
+}
+
+ICULineBreakerPoolImpl::Stats ICULineBreakerPoolImpl::getStats() const {
+    return {mOpenCount.load(std::memory_order_relaxed),
+            mThreadHitCount.load(std::memory_order_relaxed),
+            mSharedHitCount.load(std::memory_order_relaxed)};
+}
+
+size_t ICULineBreakerPoolImpl::getThreadPoolSize() const {
+    return std::count_if(tThreadSlots.begin(), tThreadSlots.end(),
+                         [this](const ThreadSlot& slot) { return slot.poolId == mId; });
+}
+
 WordBreaker::WordBreaker() : mPool(&ICULineBreakerPoolImpl::getInstance()) {}
 
 WordBreaker::WordBreaker(ICULineBreakerPool* pool) : mPool(pool) {}
 
 ssize_t WordBreaker::followingWithLocale(const Locale& locale, size_t from) {
-    mIcuBreaker = mPool->acquire(locale);
+    if (mIcuBreaker.breaker.get() == nullptr || mIcuBreaker.localeId != locale.getIdentifier()) {
+        // Give back the breaker of the previous locale, so that the next run can reuse it.
+        mPool->release(std::move(mIcuBreaker));
+        mIcuBreaker = mPool->acquire(locale);
+    }
     UErrorCode status = U_ZERO_ERROR;
     MINIKIN_ASSERT(mText != nullptr, "setText must be called first");
     // TODO: handle failure status
@@ -102,6 +177,9 @@ void WordBreaker::setText(const uint16_t* data, size_t size) {
     mCurrent = 0;
     mScanOffset = 0;
     mInEmailOrUrl = false;
+    mSimpleStart = 0;
+    mSimpleEnd = 0;
+    mEmailOrUrlIndexValid = false;
     UErrorCode status = U_ZERO_ERROR;
     utext_openUChars(&mUText, reinterpret_cast<const UChar*>(data), size, &status);
 }
@@ -180,38 +258,97 @@ static bool breakBefore(uint16_t c) {
            c == '%' || c == '=' || c == '&';
 }
 
-enum ScanState {
-    START,
-    SAW_AT,
-    SAW_COLON,
-    SAW_COLON_SLASH,
-    SAW_COLON_SLASH_SLASH,
-};
+// The email address / URL detector scans the ASCII characters from a break, stopping at a space,
+// and finds an email address if it sees an '@', or a URL if it sees "://". A colon not followed by
+// a slash, or a single slash after a colon, resets the scan, so that the character after it is
+// not looked at as a start of "://" nor '@'.
+static inline bool isEmailOrUrlChar(uint16_t c) {
+    return ' ' < c && c <= 0x007E;
+}
+
+constexpr uint32_t EMAIL_OR_URL_FLAG = 1u << 31;
+
+// static
+bool WordBreaker::mayBeInEmailOrUrl(const U16StringPiece& text, size_t offset) {
+    // The detector only scans the ASCII characters around the offset, or the last ones before it,
+    // since the end of an email address or URL moves to the next ICU boundary, past the spaces or
+    // marks after it.
+    size_t end = offset;
+    while (end > 0 && !isEmailOrUrlChar(text[end - 1])) {
+        end--;
+    }
+    if (end == offset) {
+        while (end < text.size() && isEmailOrUrlChar(text[end])) {
+            end++;
+        }
+    }
+    size_t start = std::min(offset, end);
+    while (start > 0 && isEmailOrUrlChar(text[start - 1])) {
+        start--;
+    }
+    for (size_t i = start; i < end; i++) {
+        if (text[i] == '@' || (text[i] == ':' && i + 2 < end && text[i + 1] == '/' &&
+                               text[i + 2] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WordBreaker::buildEmailOrUrlIndex() {
+    mEmailOrUrlIndex.resize(mTextSize);
+    uint32_t* index = mEmailOrUrlIndex.data();
+    // Walk backward, so that the result of a scan starting at i is derived from the results of the
+    // scans starting at the next three characters, which end at the same offset.
+    uint32_t end = mTextSize;  // The end of the scans starting in the current run.
+    bool found1 = false;       // Whether the scan from i + 1 finds one. False past the end.
+    bool found2 = false;       // Same for i + 2.
+    bool found3 = false;       // Same for i + 3.
+    for (size_t i = mTextSize; i-- > 0;) {
+        const uint16_t c = mText[i];
+        if (!isEmailOrUrlChar(c)) {
+            index[i] = i;  // The scan stops immediately.
+            end = i;
+            found1 = found2 = found3 = false;
+            continue;
+        }
+        bool found;
+        if (c == '@') {
+            found = true;
+        } else if (c == ':') {
+            if (i + 1 == end) {
+                found = false;
+            } else if (mText[i + 1] != '/') {
+                found = found2;  // The character after the colon resets the scan.
+            } else if (i + 2 == end) {
+                found = false;
+            } else {
+                found = mText[i + 2] == '/' || found3;
+            }
+        } else {
+            found = found1;
+        }
+        index[i] = end | (found ? EMAIL_OR_URL_FLAG : 0);
+        found3 = found2;
+        found2 = found1;
+        found1 = found;
+    }
+    mEmailOrUrlIndexValid = true;
+}
 
 void WordBreaker::detectEmailOrUrl() {
-    // scan forward from current ICU position for email address or URL
+    // look up the scan forward from current ICU position for email address or URL
     if (mLast >= mScanOffset) {
-        ScanState state = START;
-        size_t i;
-        for (i = mLast; i < mTextSize; i++) {
-            uint16_t c = mText[i];
-            // scan only ASCII characters, stop at space
-            if (!(' ' < c && c <= 0x007E)) {
-                break;
-            }
-            if (state == START && c == '@') {
-                state = SAW_AT;
-            } else if (state == START && c == ':') {
-                state = SAW_COLON;
-            } else if (state == SAW_COLON || state == SAW_COLON_SLASH) {
-                if (c == '/') {
-                    state = static_cast<ScanState>((int)state + 1);  // next state adds a slash
-                } else {
-                    state = START;
-                }
-            }
+        if (!mEmailOrUrlIndexValid) {
+            buildEmailOrUrlIndex();
+        }
+        size_t i = mLast;
+        bool found = false;
+        if (i < mTextSize) {
+            i = mEmailOrUrlIndex[mLast] & ~EMAIL_OR_URL_FLAG;
+            found = (mEmailOrUrlIndex[mLast] & EMAIL_OR_URL_FLAG) != 0;
         }
-        if (state == SAW_AT || state == SAW_COLON_SLASH_SLASH) {
+        if (found) {
             if (!ubrk_isBoundary(mIcuBreaker.breaker.get(), i)) {
                 // If there are combining marks or such at the end of the URL or the email address,
                 // consider them a part of the URL or the email, and skip to the next actual
@@ -255,9 +392,107 @@ ssize_t WordBreaker::findNextBreakInEmailOrUrl() {
     return i;
 }
 
+namespace {
+
+// The classes of the code units for the simple text fast path, a subset of the UAX #14 classes.
+enum class SimpleClass : uint8_t {
+    COMPLEX = 0,  // Anything else, which needs ICU.
+    LETTER,       // Letters and digits of line break class AL or NU.
+    SPACE,        // U+0020 SPACE.
+    PUNCT,        // Sentence punctuation of class IS or EX.
+};
+
+// Latin, IPA, Greek and Cyrillic.
+constexpr uint32_t SIMPLE_TEXT_LIMIT = 0x0530;
+
+const SimpleClass* getSimpleClassTable() {
+    static const std::vector<SimpleClass> table = [] {
+        std::vector<SimpleClass> result(SIMPLE_TEXT_LIMIT, SimpleClass::COMPLEX);
+        for (uint32_t c = 0; c < SIMPLE_TEXT_LIMIT; c++) {
+            const int32_t lb = u_getIntPropertyValue(c, UCHAR_LINE_BREAK);
+            if (c == ' ') {
+                result[c] = SimpleClass::SPACE;
+            } else if (c == '.' || c == ',' || c == ':' || c == ';' || c == '!' || c == '?') {
+                result[c] = SimpleClass::PUNCT;
+            } else if ((lb == U_LB_ALPHABETIC || lb == U_LB_NUMERIC) &&
+                       (U_GET_GC_MASK(c) & (U_GC_L_MASK | U_GC_ND_MASK)) != 0) {
+                result[c] = SimpleClass::LETTER;
+            }
+        }
+        return result;
+    }();
+    return table.data();
+}
+
+inline SimpleClass getSimpleClass(uint16_t c) {
+    return c < SIMPLE_TEXT_LIMIT ? getSimpleClassTable()[c] : SimpleClass::COMPLEX;
+}
+
+}  // namespace
+
+// With only the simple classes, UAX #14 allows a break after spaces (LB18) and nowhere else,
+// provided that punctuation is never followed by a letter (LB29 and LB31) nor preceded by a space
+// (LB13). None of the customizations in isValidBreak applies after a space, and neither an email
+// address nor a URL can be made of the simple classes.
+size_t WordBreaker::findSimpleTextEnd(size_t start) const {
+    const SimpleClass* table = getSimpleClassTable();
+    size_t i;
+    for (i = start; i < mTextSize; i++) {
+        const uint16_t c = mText[i];
+        const SimpleClass cls = c < SIMPLE_TEXT_LIMIT ? table[c] : SimpleClass::COMPLEX;
+        if (cls == SimpleClass::COMPLEX) {
+            break;
+        }
+        if (cls == SimpleClass::PUNCT) {
+            if (i == start || mText[i - 1] == ' ') {
+                break;
+            }
+            if (i + 1 < mTextSize && getSimpleClass(mText[i + 1]) == SimpleClass::LETTER) {
+                break;
+            }
+        }
+    }
+    return i;
+}
+
+bool WordBreaker::nextSimpleTextBreak(ssize_t* out) {
+    if (!mSimpleTextFastPathEnabled || mCurrent < mScanOffset || mCurrent < 0) {
+        return false;  // Inside an email address or a URL, or after the end.
+    }
+    const size_t current = mCurrent;
+    if (current >= mTextSize) {
+        // ICU has no break after the end, but finding it out may make ICU scan the whole text.
+        *out = UBRK_DONE;
+        return true;
+    }
+    if (current < mSimpleStart || current >= mSimpleEnd) {
+        mSimpleStart = current;
+        mSimpleEnd = findSimpleTextEnd(current);
+    }
+    for (size_t i = current + 1; i < mSimpleEnd; i++) {
+        if (mText[i - 1] == ' ' && mText[i] != ' ') {
+            *out = i;
+            return true;
+        }
+    }
+    if (mSimpleEnd == mTextSize) {
+        *out = mTextSize;
+        return true;
+    }
+    return false;
+}
+
 ssize_t WordBreaker::next() {
     mLast = mCurrent;
 
+    ssize_t simpleBreak;
+    if (nextSimpleTextBreak(&simpleBreak)) {
+        // Same as the email/URL detector finding nothing from here.
+        mInEmailOrUrl = false;
+        mCurrent = simpleBreak;
+        return mCurrent;
+    }
+
     detectEmailOrUrl();
     if (mInEmailOrUrl) {
         mCurrent = findNextBreakInEmailOrUrl();
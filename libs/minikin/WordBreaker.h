@@ -23,14 +23,17 @@
 #ifndef MINIKIN_WORD_BREAKER_H
 #define MINIKIN_WORD_BREAKER_H
 
+#include <atomic>
 #include <list>
 #include <mutex>
+#include <vector>
 
 #include <unicode/ubrk.h>
 
 #include "minikin/IcuUtils.h"
 #include "minikin/Macros.h"
 #include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
 
 #include "Locale.h"
 
@@ -62,6 +65,10 @@ public:
 
 // An singleton implementation of the ICU line breaker pool.
 // Since creating ICU line breaker instance takes some time. Pool it for later use.
+//
+// The released breakers are kept in two tiers. Each thread keeps the breakers it released last,
+// so that the layout threads get their breakers back without locking. The breakers overflowing a
+// thread's cache go to a shared pool, which is used by all the threads.
 class ICULineBreakerPoolImpl : public ICULineBreakerPool {
 public:
     Slot acquire(const Locale& locale) override;
@@ -72,16 +79,43 @@ public:
         return pool;
     }
 
+    // Changes the number of breakers kept by each thread and by the shared pool. The extra
+    // breakers of the shared pool are closed immediately, and those of the thread caches on the
+    // next release of each thread.
+    void setMaxPoolSizes(size_t maxThreadPoolSize, size_t maxPoolSize);
+
+    struct Stats {
+        uint64_t openCount;        // The number of ubrk_open calls.
+        uint64_t threadHitCount;   // The number of acquires served by the calling thread's cache.
+        uint64_t sharedHitCount;   // The number of acquires served by the shared pool.
+    };
+    Stats getStats() const;
+
 protected:
     // protected for testing purposes.
-    static constexpr size_t MAX_POOL_SIZE = 4;
-    ICULineBreakerPoolImpl(){};  // singleton.
+    static constexpr size_t MAX_THREAD_POOL_SIZE = 4;
+    static constexpr size_t MAX_POOL_SIZE = 8;
+    ICULineBreakerPoolImpl() : ICULineBreakerPoolImpl(MAX_THREAD_POOL_SIZE, MAX_POOL_SIZE) {}
+    ICULineBreakerPoolImpl(size_t maxThreadPoolSize, size_t maxPoolSize);
     size_t getPoolSize() const {
         std::lock_guard<std::mutex> lock(mMutex);
         return mPool.size();
     }
+    // Returns the number of breakers of this pool in the calling thread's cache.
+    size_t getThreadPoolSize() const;
 
 private:
+    void releaseToPool(Slot&& slot);
+
+    // Identifies the pool in the thread caches, which outlive the pools created for testing.
+    const uint32_t mId;
+    std::atomic<size_t> mMaxThreadPoolSize;
+    std::atomic<size_t> mMaxPoolSize;
+
+    std::atomic<uint64_t> mOpenCount = {0};
+    std::atomic<uint64_t> mThreadHitCount = {0};
+    std::atomic<uint64_t> mSharedHitCount = {0};
+
     std::list<Slot> mPool GUARDED_BY(mMutex);
     mutable std::mutex mMutex;
 };
@@ -120,6 +154,15 @@ public:
 
     int breakBadness() const;
 
+    // Returns true if the current break is in an email address or URL, or at its end, where
+    // followingWithLocale keeps the current break.
+    bool isInEmailOrUrl() const { return mInEmailOrUrl; }
+
+    // Returns true if a WordBreaker iterating the text from its start may be in an email address or
+    // URL, or at its end, at the offset. Otherwise a WordBreaker restarted there with
+    // followingWithLocale finds the same breaks after it. May return true for text that is not.
+    static bool mayBeInEmailOrUrl(const U16StringPiece& text, size_t offset);
+
     void finish();
 
 protected:
@@ -127,11 +170,24 @@ protected:
     // Caller must release the pool.
     WordBreaker(ICULineBreakerPool* pool);
 
+    // protected for testing purpose.
+    // Disables the fast path for the simple text, so that all the breaks come from ICU.
+    void setSimpleTextFastPathEnabled(bool enabled) { mSimpleTextFastPathEnabled = enabled; }
+
 private:
     int32_t iteratorNext();
+    // Fills mEmailOrUrlIndex for the whole text in one backward pass.
+    void buildEmailOrUrlIndex();
     void detectEmailOrUrl();
     ssize_t findNextBreakInEmailOrUrl();
 
+    // Returns the end of the simple text starting at the given offset. In the simple text, which
+    // is made of Latin, Greek or Cyrillic letters, digits, spaces and sentence punctuation, the
+    // line breaks are exactly after the spaces, so that they can be found without ICU.
+    size_t findSimpleTextEnd(size_t start) const;
+    // Finds the next break with the simple text rules. Returns false if it needs ICU.
+    bool nextSimpleTextBreak(ssize_t* out);
+
     // Doesn't take ownership. Must not be nullptr. Must be set in constructor.
     ICULineBreakerPool* mPool;
 
@@ -139,13 +195,23 @@ private:
 
     UText mUText = UTEXT_INITIALIZER;
     const uint16_t* mText = nullptr;
-    size_t mTextSize;
-    ssize_t mLast;
-    ssize_t mCurrent;
+    size_t mTextSize = 0;
+    ssize_t mLast = 0;
+    ssize_t mCurrent = 0;
 
     // state for the email address / url detector
-    ssize_t mScanOffset;
-    bool mInEmailOrUrl;
+    ssize_t mScanOffset = 0;
+    bool mInEmailOrUrl = false;
+    // For each offset, the end of the email/URL scan starting there, with EMAIL_OR_URL_FLAG set if
+    // the scan found an email address or a URL. Built on the first detection after setText, so
+    // that the text handled by the simple text fast path doesn't pay for it.
+    std::vector<uint32_t> mEmailOrUrlIndex;
+    bool mEmailOrUrlIndexValid = false;
+
+    // state for the simple text fast path. [mSimpleStart, mSimpleEnd) is simple text.
+    bool mSimpleTextFastPathEnabled = true;
+    size_t mSimpleStart = 0;
+    size_t mSimpleEnd = 0;
 };
 
 }  // namespace minikin
@@ -25,10 +25,14 @@ namespace minikin {
 const char* enUsHyph = "/system/usr/hyphen-data/hyph-en-us.hyb";
 const int enUsMinPrefix = 2;
 const int enUsMinSuffix = 3;
+const char* frHyph = "/system/usr/hyphen-data/hyph-fr.hyb";
+const int frMinPrefix = 2;
+const int frMinSuffix = 3;
 
 static void BM_Hyphenator_short_word(benchmark::State& state) {
-    Hyphenator* hyphenator = Hyphenator::loadBinary(readWholeFile(enUsHyph).data(), enUsMinPrefix,
-                                                    enUsMinSuffix, "en");
+    std::vector<uint8_t> patternData = readWholeFile(enUsHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), enUsMinPrefix, enUsMinSuffix, "en");
     std::vector<uint16_t> word = utf8ToUtf16("hyphen");
     std::vector<HyphenationType> result;
     while (state.KeepRunning()) {
@@ -40,8 +44,9 @@ static void BM_Hyphenator_short_word(benchmark::State& state) {
 BENCHMARK(BM_Hyphenator_short_word);
 
 static void BM_Hyphenator_long_word(benchmark::State& state) {
-    Hyphenator* hyphenator = Hyphenator::loadBinary(readWholeFile(enUsHyph).data(), enUsMinPrefix,
-                                                    enUsMinSuffix, "en");
+    std::vector<uint8_t> patternData = readWholeFile(enUsHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), enUsMinPrefix, enUsMinSuffix, "en");
     std::vector<uint16_t> word = utf8ToUtf16("Pneumonoultramicroscopicsilicovolcanoconiosis");
     std::vector<HyphenationType> result;
     while (state.KeepRunning()) {
@@ -52,6 +57,89 @@ static void BM_Hyphenator_long_word(benchmark::State& state) {
 // TODO: Use BENCHMARK_CAPTURE for parametrise.
 BENCHMARK(BM_Hyphenator_long_word);
 
+// Hyphenates a mix of short and long words, as a paragraph of text would.
+static void BM_Hyphenator_throughput(benchmark::State& state) {
+    std::vector<uint8_t> patternData = readWholeFile(enUsHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), enUsMinPrefix, enUsMinSuffix, "en");
+    const char* kWords[] = {
+            "Lorem",     "ipsum",      "dolor",       "consectetur", "adipiscing", "incididunt",
+            "labore",    "magna",      "exercitation", "ullamco",    "laboris",    "commodo",
+            "consequat", "hyphenation", "algorithm",  "paragraph",   "typography",
+            "internationalization", "Pneumonoultramicroscopicsilicovolcanoconiosis",
+    };
+    std::vector<std::vector<uint16_t>> words;
+    for (const char* word : kWords) {
+        words.push_back(utf8ToUtf16(word));
+    }
+    std::vector<HyphenationType> result;
+    while (state.KeepRunning()) {
+        for (const std::vector<uint16_t>& word : words) {
+            hyphenator->hyphenate(word, &result);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+BENCHMARK(BM_Hyphenator_throughput);
+
+// Hyphenates a whole paragraph at once, with each thread running its own hyphenator over the same
+// pattern data, as a server side pipeline would.
+static void BM_Hyphenator_paragraph(benchmark::State& state) {
+    static std::vector<uint8_t> patternData = readWholeFile(enUsHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), enUsMinPrefix, enUsMinSuffix, "en");
+    const char* kWords[] = {
+            "Lorem",     "ipsum",      "dolor",       "consectetur", "adipiscing", "incididunt",
+            "labore",    "magna",      "exercitation", "ullamco",    "laboris",    "commodo",
+            "consequat", "hyphenation", "algorithm",  "paragraph",   "typography",
+            "internationalization", "Pneumonoultramicroscopicsilicovolcanoconiosis",
+    };
+    std::vector<uint16_t> text;
+    std::vector<Range> words;
+    for (const char* word : kWords) {
+        std::vector<uint16_t> chars = utf8ToUtf16(word);
+        words.push_back(Range(text.size(), text.size() + chars.size()));
+        text.insert(text.end(), chars.begin(), chars.end());
+        text.push_back(' ');
+    }
+    std::vector<HyphenationType> result;
+    while (state.KeepRunning()) {
+        hyphenator->hyphenate(text, words, &result);
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+BENCHMARK(BM_Hyphenator_paragraph)->ThreadRange(1, 8)->UseRealTime();
+
+// "développement" in NFC, which is looked up as is.
+static void BM_Hyphenator_nfc_word(benchmark::State& state) {
+    std::vector<uint8_t> patternData = readWholeFile(frHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), frMinPrefix, frMinSuffix, "fr");
+    std::vector<uint16_t> word = utf8ToUtf16("d\u00E9veloppement");
+    std::vector<HyphenationType> result;
+    while (state.KeepRunning()) {
+        hyphenator->hyphenate(word, &result);
+    }
+}
+
+BENCHMARK(BM_Hyphenator_nfc_word);
+
+// "développement" with a combining accent, which is normalized before the lookup.
+static void BM_Hyphenator_decomposed_word(benchmark::State& state) {
+    std::vector<uint8_t> patternData = readWholeFile(frHyph);
+    Hyphenator* hyphenator =
+            Hyphenator::loadBinary(patternData.data(), frMinPrefix, frMinSuffix, "fr");
+    std::vector<uint16_t> word = utf8ToUtf16("de\u0301veloppement");
+    std::vector<HyphenationType> result;
+    while (state.KeepRunning()) {
+        hyphenator->hyphenate(word, &result);
+    }
+}
+
+BENCHMARK(BM_Hyphenator_decomposed_word);
+
 // TODO: Add more tests for other languages.
 
 }  // namespace minikin
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/MeasuredText.h"
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/Hyphenator.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/LocaleList.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FileUtils.h"
+#include "FontTestUtils.h"
+#include "HyphenationCache.h"
+#include "HyphenatorMap.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+const char* kSystemFontPath = "/system/fonts/";
+const char* kSystemFontXml = "/system/etc/fonts.xml";
+const char* kEnUsHyph = "/system/usr/hyphen-data/hyph-en-us.hyb";
+
+constexpr uint32_t kTextLength = 100000;
+constexpr uint32_t kStyleRunLength = 200;
+
+std::vector<uint16_t> buildLongText() {
+    const std::vector<uint16_t> loremIpsum = utf8ToUtf16(
+            "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+            "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud "
+            "exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat. ");
+    std::vector<uint16_t> text;
+    text.reserve(kTextLength);
+    while (text.size() < kTextLength) {
+        text.insert(text.end(), loremIpsum.begin(), loremIpsum.end());
+    }
+    text.resize(kTextLength);
+    return text;
+}
+
+}  // namespace
+
+// Measures a 100k character paragraph with a style run per 200 characters.
+// Arguments: the number of threads, and whether to compute hyphenation.
+static void BM_MeasuredText_measure_multiRun(benchmark::State& state) {
+    static const std::vector<uint8_t> hyphData = readWholeFile(kEnUsHyph);
+    static const Hyphenator* hyphenator =
+            Hyphenator::loadBinary(hyphData.data(), 2 /* min prefix */, 3 /* min suffix */, "en");
+    HyphenatorMap::add("en-US", hyphenator);
+
+    auto collection =
+            std::make_shared<FontCollection>(getFontFamilies(kSystemFontPath, kSystemFontXml));
+    const std::vector<uint16_t> text = buildLongText();
+    const uint32_t localeListId = registerLocaleList("en-US");
+    const uint32_t threadCount = state.range(0);
+    const bool computeHyphenation = state.range(1) != 0;
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        // Measure the shaping cost instead of the cache lookups.
+        LayoutCache::getInstance().clear();
+        HyphenationCache::getInstance().clear();
+        MeasuredTextBuilder builder;
+        for (uint32_t start = 0; start < text.size(); start += kStyleRunLength) {
+            MinikinPaint paint(collection);
+            // Alternate the text size so that adjacent runs do not share the layout cache.
+            paint.size = (start / kStyleRunLength) % 2 == 0 ? 10.0f : 12.0f;
+            paint.localeListId = localeListId;
+            const uint32_t end = std::min<uint32_t>(start + kStyleRunLength, text.size());
+            builder.addStyleRun(start, end, std::move(paint), false /* is RTL */);
+        }
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(builder.build(text, computeHyphenation,
+                                               false /* compute layout */, nullptr /* hint */,
+                                               threadCount));
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+    // Words repeat within the paragraph, so most of them are hyphenated by a cache lookup.
+    state.counters["hyphenation_hit_rate"] = HyphenationCache::getInstance().getHitRate();
+}
+
+BENCHMARK(BM_MeasuredText_measure_multiRun)
+        ->ArgPair(1, 0)
+        ->ArgPair(2, 0)
+        ->ArgPair(4, 0)
+        ->ArgPair(1, 1)
+        ->ArgPair(2, 1)
+        ->ArgPair(4, 1);
+
+}  // namespace minikin
@@ -38,6 +38,82 @@ static void BM_WordBreaker_English(benchmark::State& state) {
 }
 BENCHMARK(BM_WordBreaker_English);
 
+// Same as BM_WordBreaker_English, but with ICU for all the breaks, as a baseline for the simple
+// text fast path.
+static void BM_WordBreaker_English_ICU(benchmark::State& state) {
+    const char* kLoremIpsum =
+            "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+            "eiusmod tempor incididunt ut labore et dolore magna aliqua.";
+
+    class IcuOnlyWordBreaker : public WordBreaker {
+    public:
+        IcuOnlyWordBreaker() { setSimpleTextFastPathEnabled(false); }
+    };
+    IcuOnlyWordBreaker wb;
+    std::vector<uint16_t> text = utf8ToUtf16(kLoremIpsum);
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        wb.followingWithLocale(Locale("en-US"), 0);
+        while (wb.next() != -1) {
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_English_ICU);
+
+static void BM_WordBreaker_Russian(benchmark::State& state) {
+    const char* kText =
+            "\u0421\u044A\u0435\u0448\u044C \u0436\u0435 \u0435\u0449\u0451 "
+            "\u044D\u0442\u0438\u0445 \u043C\u044F\u0433\u043A\u0438\u0445 "
+            "\u0444\u0440\u0430\u043D\u0446\u0443\u0437\u0441\u043A\u0438\u0445 "
+            "\u0431\u0443\u043B\u043E\u043A, \u0434\u0430 "
+            "\u0432\u044B\u043F\u0435\u0439 \u0447\u0430\u044E.";
+
+    WordBreaker wb;
+    std::vector<uint16_t> text = utf8ToUtf16(kText);
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        wb.followingWithLocale(Locale("ru-RU"), 0);
+        while (wb.next() != -1) {
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_Russian);
+
+// Latin text which falls back to ICU in the middle, at the quotation marks.
+static void BM_WordBreaker_English_Quotes(benchmark::State& state) {
+    const char* kText =
+            "Lorem ipsum dolor sit amet, consectetur adipiscing elit, \"sed do "
+            "eiusmod tempor\" incididunt ut labore et dolore magna aliqua.";
+
+    WordBreaker wb;
+    std::vector<uint16_t> text = utf8ToUtf16(kText);
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        wb.followingWithLocale(Locale("en-US"), 0);
+        while (wb.next() != -1) {
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_English_Quotes);
+
+// A chat log with long URLs and email addresses.
+static void BM_WordBreaker_Urls(benchmark::State& state) {
+    const char* kText =
+            "see https://www.example.com/articles/2017/line-breaking?utm_source=chat&utm_medium=x "
+            "or mail someone@mail.example.org, then http://example.net/a/b/c/d/e/f/g/index.html "
+            "and ftp://files.example.com/pub/releases/latest.tar.gz thanks";
+
+    WordBreaker wb;
+    std::vector<uint16_t> text = utf8ToUtf16(kText);
+    while (state.KeepRunning()) {
+        wb.setText(text.data(), text.size());
+        wb.followingWithLocale(Locale("en-US"), 0);
+        while (wb.next() != -1) {
+        }
+    }
+}
+BENCHMARK(BM_WordBreaker_Urls);
+
 // TODO: Add more tests for other languages.
 
 }  // namespace minikin
@@ -87,4 +87,83 @@ TEST(BufferTest, testSkip) {
     ASSERT_EQ(reader.pos(), 20u);
 }
 
+TEST(BufferTest, testCheckedRead) {
+    TestObject testObject;
+    BufferWriter fakeWriter(nullptr);
+    testObject.writeTo(&fakeWriter);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    testObject.writeTo(&writer);
+
+    CheckedBufferReader reader(buffer.data(), buffer.size());
+    ASSERT_EQ(reader.read<uint8_t>(), 0xABu);
+    ASSERT_EQ(reader.read<uint16_t>(), 0xCDEFu);
+    ASSERT_EQ(reader.read<uint8_t>(), 0x01u);
+    auto [uint32Array, size] = reader.readArray<uint32_t>();
+    ASSERT_EQ(size, 2u);
+    ASSERT_EQ(uint32Array[0], 0x98765432u);
+    ASSERT_EQ(uint32Array[1], 0x98765433u);
+    ASSERT_EQ(reader.pos(), 20u);
+    EXPECT_FALSE(reader.hasError());
+
+    // Reading past the end returns zero and makes the error sticky.
+    EXPECT_EQ(reader.read<uint8_t>(), 0u);
+    EXPECT_TRUE(reader.hasError());
+    EXPECT_EQ(reader.pos(), 20u);
+}
+
+TEST(BufferTest, testCheckedReadTruncated) {
+    TestObject testObject;
+    BufferWriter fakeWriter(nullptr);
+    testObject.writeTo(&fakeWriter);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    testObject.writeTo(&writer);
+
+    // The array is cut in the middle.
+    CheckedBufferReader reader(buffer.data(), buffer.size() - 1);
+    reader.skip<uint8_t>();
+    reader.skip<uint16_t>();
+    reader.skip<uint8_t>();
+    EXPECT_FALSE(reader.hasError());
+    auto [uint32Array, size] = reader.readArray<uint32_t>();
+    EXPECT_EQ(uint32Array, nullptr);
+    EXPECT_EQ(size, 0u);
+    EXPECT_TRUE(reader.hasError());
+    // Subsequent reads fail even if they are in range.
+    CheckedBufferReader reader2(buffer.data(), buffer.size() - 1);
+    reader2.skipArray<uint32_t>();
+    EXPECT_TRUE(reader2.hasError());
+    EXPECT_EQ(reader2.read<uint8_t>(), 0u);
+}
+
+TEST(BufferTest, testCheckedReadCount) {
+    std::vector<uint8_t> buffer(16);
+    BufferWriter writer(buffer.data());
+    writer.write<uint32_t>(12);
+    writer.write<uint32_t>(0xFFFFFFFF);
+    {
+        CheckedBufferReader reader(buffer.data(), buffer.size());
+        EXPECT_EQ(reader.readCount(), 12u);
+        EXPECT_FALSE(reader.hasError());
+        // The remaining 8 bytes can't hold so many elements.
+        EXPECT_EQ(reader.readCount(), 0u);
+        EXPECT_TRUE(reader.hasError());
+    }
+    {
+        // Huge array size must not overflow the range check.
+        CheckedBufferReader reader(buffer.data(), buffer.size(), 4);
+        auto [array, size] = reader.readArray<uint64_t>();
+        EXPECT_EQ(array, nullptr);
+        EXPECT_EQ(size, 0u);
+        EXPECT_TRUE(reader.hasError());
+    }
+    {
+        // The trusted reader does not check anything.
+        BufferReader reader(buffer.data(), 4);
+        EXPECT_EQ(reader.readCount(), 0xFFFFFFFFu);
+        EXPECT_FALSE(reader.hasError());
+    }
+}
+
 }  // namespace minikin
@@ -1213,4 +1213,54 @@ TEST(CmapCoverageTest, TableSelection_vsTableOnly) {
     ASSERT_TRUE(vsTables[vsIndex]);
     EXPECT_TRUE(vsTables[vsIndex]->get('a'));
 }
+
+TEST(CmapCoverageTest, CoveragePages) {
+    std::vector<uint8_t> cmap = CmapBuilder::buildSingleFormat12Cmap(
+            3, 10,
+            std::vector<uint32_t>({'a', 'z', 0x1FF, 0x201, 0x3000, 0x3000, 0x1F600, 0x1F64F}));
+    bool hasVSTable = true;
+    SparseBitSet pages = CmapCoverage::getCoveragePages(cmap.data(), cmap.size(), &hasVSTable);
+    EXPECT_FALSE(hasVSTable);
+    EXPECT_TRUE(pages.get(0x00));
+    EXPECT_TRUE(pages.get(0x01));
+    EXPECT_TRUE(pages.get(0x02));
+    EXPECT_FALSE(pages.get(0x03));
+    EXPECT_TRUE(pages.get(0x30));
+    EXPECT_FALSE(pages.get(0x31));
+    EXPECT_TRUE(pages.get(0x1F6));
+    EXPECT_EQ(0x1F7u, pages.length());
+
+    // The summary must agree with the full coverage.
+    std::vector<std::unique_ptr<SparseBitSet>> vsTables;
+    SparseBitSet coverage = CmapCoverage::getCoverage(cmap.data(), cmap.size(), &vsTables);
+    for (uint32_t page = 0; page < pages.length(); ++page) {
+        uint32_t next = coverage.nextSetBit(page << CmapCoverage::kLogCharsPerPage);
+        bool hasCoverage = next != SparseBitSet::kNotFound &&
+                           (next >> CmapCoverage::kLogCharsPerPage) == page;
+        EXPECT_EQ(hasCoverage, pages.get(page)) << "page " << page;
+    }
+}
+
+TEST(CmapCoverageTest, CoveragePages_VSTable) {
+    std::vector<uint8_t> vsTable =
+            buildCmapFormat14Table(std::vector<VariationSelectorRecord>({{0xFE0F, {}, {'a'}}}));
+    CmapBuilder builder(2);
+    builder.appendTable(3, 1, buildCmapFormat4Table(std::vector<uint16_t>({'a', 'a'})));
+    builder.appendTable(VS_PLATFORM_ID, VS_ENCODING_ID, vsTable);
+    std::vector<uint8_t> cmap = builder.build();
+
+    bool hasVSTable = false;
+    SparseBitSet pages = CmapCoverage::getCoveragePages(cmap.data(), cmap.size(), &hasVSTable);
+    EXPECT_TRUE(hasVSTable);
+    EXPECT_TRUE(pages.get(0));
+    EXPECT_EQ(1u, pages.length());
+}
+
+TEST(CmapCoverageTest, CoveragePages_brokenCmap) {
+    bool hasVSTable = true;
+    uint8_t cmap[2] = {};
+    SparseBitSet pages = CmapCoverage::getCoveragePages(cmap, sizeof(cmap), &hasVSTable);
+    EXPECT_FALSE(hasVSTable);
+    EXPECT_EQ(0u, pages.length());
+}
 }  // namespace minikin
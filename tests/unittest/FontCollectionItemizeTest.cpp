@@ -1629,6 +1629,30 @@ TEST(FontCollectionItemizeTest, customFallbackTest) {
     EXPECT_EQ(customFallbackFamily->getFont(0), runs[0].fakedFont.font.get());
 }
 
+TEST(FontCollectionItemizeTest, customFallbackTest_afterLanguageFamily) {
+    auto firstFamily = buildFontFamily(kNoGlyphFont);
+    auto languageFamily = buildFontFamily(kAsciiFont, "ja-JP");
+    auto customFallbackFamily = buildFontFamily(kAsciiFont, "", true /* isCustomFallback */);
+
+    std::vector<std::shared_ptr<FontFamily>> families = {firstFamily, languageFamily,
+                                                         customFallbackFamily};
+
+    auto collection = std::make_shared<FontCollection>(families);
+
+    // The custom fallback family wins even if a preceding family matches the locale.
+    auto runs = itemize(collection, "'a' 'b' 'c'", "ja-JP");
+    ASSERT_EQ(1U, runs.size());
+    EXPECT_EQ(customFallbackFamily->getFont(0), runs[0].fakedFont.font.get());
+
+    // The first family wins over the custom fallback family.
+    auto asciiFamily = buildFontFamily(kAsciiFont);
+    families = {asciiFamily, customFallbackFamily};
+    collection = std::make_shared<FontCollection>(families);
+    runs = itemize(collection, "'a' 'b' 'c'", "");
+    ASSERT_EQ(1U, runs.size());
+    EXPECT_EQ(asciiFamily->getFont(0), runs[0].fakedFont.font.get());
+}
+
 std::string itemizeEmojiAndFontPostScriptName(const std::string& txt) {
     auto firstFamily = buildFontFamily(kAsciiFont);
     auto OverrideEmojiFamily = buildFontFamily("OverrideEmoji.ttf", "und-Zsye");
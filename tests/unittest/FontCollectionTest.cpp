@@ -234,6 +234,69 @@ TEST(FontCollectionTest, bufferTest) {
     }
 }
 
+TEST(FontCollectionTest, bufferTest_sharedCoverage) {
+    // Two families of the same font have identical coverage.
+    std::vector<std::shared_ptr<FontFamily>> families = {buildFontFamily(kVsTestFont),
+                                                         buildFontFamily(kVsTestFont)};
+    std::vector<std::shared_ptr<FontCollection>> original(
+            {std::make_shared<FontCollection>(families)});
+    std::vector<uint8_t> buffer = writeToBuffer(original);
+
+    BufferReader tableReader(buffer.data());
+    SparseBitSetTableReader coverageTable(&tableReader);
+    // The cmap coverage and the coverage of each variation selector in the font are shared.
+    SparseBitSetTableWriter expectedTable;
+    families[0]->addCoveragesTo(&expectedTable);
+    EXPECT_EQ(expectedTable.size(), coverageTable.size());
+
+    BufferReader reader(buffer.data());
+    auto copied = FontCollection::readVector<readFreeTypeMinikinFontForTest>(&reader);
+    ASSERT_EQ(1u, copied.size());
+    ASSERT_EQ(2u, copied[0]->getFamilies().size());
+    expectVSGlyphsForVsTestFont(copied[0].get());
+    EXPECT_EQ(buffer, writeToBuffer(copied));
+}
+
+TEST(FontCollectionTest, checkedBufferTest) {
+    std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kVsTestFont)});
+    std::vector<uint8_t> buffer = writeToBuffer(original);
+    {
+        CheckedBufferReader reader(buffer.data(), buffer.size());
+        auto copied = FontCollection::readVector<readFreeTypeMinikinFontForTest>(&reader);
+        EXPECT_FALSE(reader.hasError());
+        ASSERT_EQ(1u, copied.size());
+        expectVSGlyphsForVsTestFont(copied[0].get());
+        EXPECT_EQ(buffer, writeToBuffer(copied));
+    }
+    // Every truncation of the buffer must be rejected without reading out of bounds.
+    for (size_t size = 0; size < buffer.size(); size++) {
+        CheckedBufferReader reader(buffer.data(), size);
+        auto copied = FontCollection::readVector<readFreeTypeMinikinFontForTest>(&reader);
+        EXPECT_TRUE(reader.hasError()) << size;
+        EXPECT_TRUE(copied.empty()) << size;
+    }
+    {
+        // The family index of the collection is out of range.
+        std::vector<uint8_t> broken = buffer;
+        BufferReader familiesReader(broken.data());
+        SparseBitSetTableReader coverageTable(&familiesReader);
+        uint32_t familiesCount = familiesReader.read<uint32_t>();
+        for (uint32_t i = 0; i < familiesCount; i++) {
+            FontFamily::readFrom<readFreeTypeMinikinFontForTest>(&familiesReader, &coverageTable);
+        }
+        familiesReader.skip<uint32_t>();  // collection count
+        familiesReader.skip<uint32_t>();  // mMaxChar
+        familiesReader.skip<uint32_t>();  // family count
+        uint32_t* familyIndex = reinterpret_cast<uint32_t*>(
+                broken.data() + BufferReader::align<uint32_t>(familiesReader.pos()));
+        *familyIndex = familiesCount;
+        CheckedBufferReader checkedReader(broken.data(), broken.size());
+        EXPECT_TRUE(FontCollection::readVector<readFreeTypeMinikinFontForTest>(&checkedReader)
+                            .empty());
+        EXPECT_TRUE(checkedReader.hasError());
+    }
+}
+
 TEST(FontCollectionTest, FamilyMatchResultBuilderTest) {
     using Builder = FontCollection::FamilyMatchResult::Builder;
     EXPECT_TRUE(Builder().empty());
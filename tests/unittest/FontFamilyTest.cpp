@@ -681,6 +681,52 @@ TEST_F(FontFamilyTest, coverageTableSelectionTest) {
     EXPECT_TRUE(unicodeEnc4Font->hasGlyph(0x1F926, 0));
 }
 
+static std::shared_ptr<FontFamily> buildLazyCoverageFontFamily(const std::string& filePath) {
+    auto font = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath(filePath));
+    std::vector<std::shared_ptr<Font>> fonts;
+    fonts.push_back(Font::Builder(font).build());
+    return std::make_shared<FontFamily>(kEmptyLocaleListId, FamilyVariant::DEFAULT,
+                                        std::move(fonts), false /* isCustomFallback */,
+                                        true /* isLazyCoverage */);
+}
+
+TEST_F(FontFamilyTest, lazyCoverageTest) {
+    std::shared_ptr<FontFamily> eager = buildFontFamily(kVsTestFont);
+    std::shared_ptr<FontFamily> lazy = buildLazyCoverageFontFamily(kVsTestFont);
+    EXPECT_FALSE(eager->isLazyCoverage());
+    EXPECT_TRUE(lazy->isLazyCoverage());
+    EXPECT_EQ(eager->hasVSTable(), lazy->hasVSTable());
+    EXPECT_EQ(eager->supportedAxes(), lazy->supportedAxes());
+
+    // The page level summary is available without computing the full coverage.
+    EXPECT_LE(eager->getCoverageLength(), lazy->getCoverageLength());
+    EXPECT_EQ(eager->getCoverageLength() >> 8, (lazy->getCoverageLength() - 1) >> 8);
+    EXPECT_EQ(0x5300u, lazy->nextCoveredCharOrPage(0));
+    EXPECT_EQ(0x537Fu, eager->nextCoveredCharOrPage(0));
+    EXPECT_EQ(0x8200u, lazy->nextCoveredCharOrPage(0x5400));
+    EXPECT_EQ(0x82A6u, eager->nextCoveredCharOrPage(0x5400));
+    EXPECT_EQ(SparseBitSet::kNotFound, lazy->nextCoveredCharOrPage(0x8500));
+
+    expectVSGlyphsForVsTestFont(lazy.get());
+    EXPECT_EQ(eager->getCoverage().length(), lazy->getCoverage().length());
+}
+
+TEST_F(FontFamilyTest, lazyCoverageBufferTest) {
+    std::shared_ptr<FontFamily> eager = buildFontFamily(kVsTestFont);
+    std::shared_ptr<FontFamily> lazy = buildLazyCoverageFontFamily(kVsTestFont);
+    // The serialized form of the lazy coverage family has the full coverage.
+    std::vector<uint8_t> eagerBuffer =
+            writeToBuffer<FontFamily, writeFreeTypeMinikinFontForTest>(*eager);
+    std::vector<uint8_t> lazyBuffer =
+            writeToBuffer<FontFamily, writeFreeTypeMinikinFontForTest>(*lazy);
+    ASSERT_EQ(eagerBuffer, lazyBuffer);
+    BufferReader reader(lazyBuffer.data());
+    std::shared_ptr<FontFamily> copied =
+            FontFamily::readFrom<readFreeTypeMinikinFontForTest>(&reader);
+    EXPECT_FALSE(copied->isLazyCoverage());
+    expectVSGlyphsForVsTestFont(copied.get());
+}
+
 const char* slantToString(FontStyle::Slant slant) {
     if (slant == FontStyle::Slant::ITALIC) {
         return "ITALIC";
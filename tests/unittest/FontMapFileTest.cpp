@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FontMapFile.h"
+
+#include <gtest/gtest.h>
+
+#include "FontTestUtils.h"
+#include "FreeTypeMinikinFontForTest.h"
+
+namespace minikin {
+namespace {
+
+constexpr char kTestFont[] = "Ascii.ttf";
+
+std::vector<uint8_t> writeFontMapFile(
+        const std::vector<std::shared_ptr<FontCollection>>& collections) {
+    size_t size = FontMapFile::write<writeFreeTypeMinikinFontForTest>(nullptr, collections);
+    std::vector<uint8_t> buffer(size);
+    EXPECT_EQ(size, FontMapFile::write<writeFreeTypeMinikinFontForTest>(buffer.data(),
+                                                                          collections));
+    return buffer;
+}
+
+FontMapFileHeader* getHeader(std::vector<uint8_t>* buffer) {
+    return reinterpret_cast<FontMapFileHeader*>(buffer->data());
+}
+
+}  // namespace
+
+TEST(FontMapFileTest, roundTrip) {
+    std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kTestFont)});
+    std::vector<uint8_t> buffer = writeFontMapFile(original);
+
+    const FontMapFileHeader* header = getHeader(&buffer);
+    EXPECT_EQ(FontMapFile::kMagic, header->magic);
+    EXPECT_EQ(FontMapFile::kVersion, header->version);
+    EXPECT_EQ(FontMapFile::kPayloadOffset, header->payloadOffset);
+    EXPECT_EQ(0u, header->payloadOffset % FontMapFile::kPayloadAlignment);
+    EXPECT_EQ(buffer.size(), header->payloadOffset + header->payloadSize);
+
+    auto copied = FontMapFile::readVector<readFreeTypeMinikinFontForTest>(
+            buffer.data(), buffer.size(), true /* verifyChecksum */);
+    ASSERT_EQ(1u, copied.size());
+    EXPECT_EQ(original[0]->getFamilies().size(), copied[0]->getFamilies().size());
+    EXPECT_TRUE(copied[0]->getFamilies()[0]->hasGlyph('a', 0));
+
+    // Writing again produces the identical file.
+    EXPECT_EQ(buffer, writeFontMapFile(copied));
+}
+
+TEST(FontMapFileTest, rejectInvalidHeader) {
+    std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kTestFont)});
+    const std::vector<uint8_t> valid = writeFontMapFile(original);
+    ASSERT_NE(nullptr, FontMapFile::getPayload(valid.data(), valid.size(), true));
+    {
+        std::vector<uint8_t> buffer = valid;
+        getHeader(&buffer)->magic = 0;
+        EXPECT_EQ(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), false));
+    }
+    {
+        std::vector<uint8_t> buffer = valid;
+        getHeader(&buffer)->version = FontMapFile::kVersion + 1;
+        EXPECT_EQ(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), false));
+    }
+    {
+        std::vector<uint8_t> buffer = valid;
+        getHeader(&buffer)->reserved = 1;
+        EXPECT_EQ(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), false));
+    }
+    {
+        // Truncated.
+        EXPECT_EQ(nullptr, FontMapFile::getPayload(valid.data(), valid.size() - 1, false));
+        EXPECT_EQ(nullptr, FontMapFile::getPayload(valid.data(), sizeof(FontMapFileHeader), false));
+    }
+}
+
+TEST(FontMapFileTest, checksum) {
+    std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kTestFont)});
+    std::vector<uint8_t> buffer = writeFontMapFile(original);
+    buffer.back() ^= 0x01;
+    EXPECT_EQ(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), true));
+    // The header alone is still valid.
+    EXPECT_NE(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), false));
+    EXPECT_TRUE(FontMapFile::readVector<readFreeTypeMinikinFontForTest>(
+                        buffer.data(), buffer.size(), true /* verifyChecksum */)
+                        .empty());
+}
+
+TEST(FontMapFileTest, rejectBrokenPayload) {
+    std::vector<std::shared_ptr<FontCollection>> original({buildFontCollection(kTestFont)});
+    std::vector<uint8_t> buffer = writeFontMapFile(original);
+    // The payload is bounds checked even if the checksum verification is skipped.
+    getHeader(&buffer)->payloadSize -= 4;
+    EXPECT_NE(nullptr, FontMapFile::getPayload(buffer.data(), buffer.size(), false));
+    EXPECT_TRUE(FontMapFile::readVector<readFreeTypeMinikinFontForTest>(
+                        buffer.data(), buffer.size(), false /* verifyChecksum */)
+                        .empty());
+}
+
+}  // namespace minikin
@@ -18,6 +18,8 @@
 
 #include <gtest/gtest.h>
 
+#include "minikin/Characters.h"
+
 #include "BufferUtils.h"
 #include "FontTestUtils.h"
 #include "FreeTypeMinikinFontForTest.h"
@@ -39,4 +41,15 @@ TEST(FontTest, BufferTest) {
     EXPECT_EQ(buffer, newBuffer);
 }
 
+TEST(FontTest, HyphenTest) {
+    auto minikinFont = std::make_shared<FreeTypeMinikinFontForTest>(getTestFontPath("Ascii.ttf"));
+    std::shared_ptr<Font> font = Font::Builder(minikinFont).build();
+
+    // Ascii.ttf only supports HYPHEN-MINUS.
+    EXPECT_EQ(CHAR_HYPHEN_MINUS, font->getHyphenChar(CHAR_HYPHEN));
+    EXPECT_EQ(CHAR_HYPHEN_MINUS, font->getHyphenChar(CHAR_MAQAF));
+    EXPECT_EQ(CHAR_HYPHEN_MINUS, font->getHyphenChar(CHAR_HYPHEN));
+    EXPECT_EQ(CHAR_ZWJ, font->getHyphenChar(CHAR_ZWJ));
+}
+
 }  // namespace minikin
@@ -1587,5 +1587,192 @@ TEST_F(GreedyLineBreakerTest, testControllCharAfterSpace) {
                                                    << toString(textBuf, actual);
     }
 }
+
+TEST_F(GreedyLineBreakerTest, breakInChunks) {
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "Hyphenation of long paragraphs is done in chunks. Each chunk ends after a space, "
+            "and the last line of a chunk is broken again with the next chunk. Characteristically,"
+            " the result is the same as the one of the whole paragraph.");
+    auto fc = buildFontCollection("Ascii.ttf");
+    MeasuredTextBuilder builder;
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;  // Make 1em=10px
+    paint.localeListId = LocaleListCache::getId("en-US");
+    builder.addStyleRun(0, 60, MinikinPaint(paint), false);
+    builder.addReplacementRun(60, 61, 30.0f, paint.localeListId);
+    builder.addStyleRun(61, textBuf.size(), std::move(paint), false);
+    std::unique_ptr<MeasuredText> measuredText =
+            builder.buildRange(textBuf, Range(0, textBuf.size()), false /* compute hyphenation */,
+                               false /* compute full layout */);
+    TabStops tabStops(nullptr, 0, 10);
+
+    for (float lineWidth : {100.0f, 250.0f, 1000.0f}) {
+        RectangleLineWidth rectangleLineWidth(lineWidth);
+        for (bool doHyphenation : {false, true}) {
+            const LineBreakResult expected = breakLineGreedy(
+                    textBuf, *measuredText, rectangleLineWidth, tabStops, doHyphenation);
+            for (uint32_t chunkLength : {1u, 16u, 40u, 1000u}) {
+                LineBreakResult actual;
+                breakIntoLinesInChunks(
+                        textBuf, builder,
+                        doHyphenation ? HyphenationFrequency::Normal : HyphenationFrequency::None,
+                        rectangleLineWidth, tabStops, chunkLength, [&](LineBreakResult&& lines) {
+                            ASSERT_FALSE(lines.breakPoints.empty());
+                            for (size_t i = 0; i < lines.breakPoints.size(); i++) {
+                                actual.breakPoints.push_back(lines.breakPoints[i]);
+                                actual.widths.push_back(lines.widths[i]);
+                                actual.flags.push_back(lines.flags[i]);
+                            }
+                        });
+                EXPECT_EQ(expected.breakPoints, actual.breakPoints)
+                        << lineWidth << ", " << doHyphenation << ", " << chunkLength;
+                // The widths of a chunk are summed from its own start, so they may differ from the
+                // ones of the whole paragraph by rounding.
+                ASSERT_EQ(expected.widths.size(), actual.widths.size());
+                for (size_t i = 0; i < expected.widths.size(); i++) {
+                    EXPECT_FLOAT_EQ(expected.widths[i], actual.widths[i]) << i;
+                }
+                EXPECT_EQ(expected.flags, actual.flags);
+            }
+        }
+    }
+}
+
+TEST_F(GreedyLineBreakerTest, breakInChunks_noSpace) {
+    // A text without spaces, like CJK or Thai, is still broken into chunks of about the length,
+    // also when it follows a few words.
+    for (const std::string& text :
+         {std::string(300, 'a'), "Hello world this is some text " + std::string(200, 'b')}) {
+        const std::vector<uint16_t> textBuf = utf8ToUtf16(text);
+        auto fc = buildFontCollection("Ascii.ttf");
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=10px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        builder.addStyleRun(0, textBuf.size(), std::move(paint), false);
+        std::unique_ptr<MeasuredText> measuredText = builder.buildRange(
+                textBuf, Range(0, textBuf.size()), false /* compute hyphenation */,
+                false /* compute full layout */);
+        TabStops tabStops(nullptr, 0, 10);
+        RectangleLineWidth rectangleLineWidth(100.0f);
+
+        const LineBreakResult expected = breakLineGreedy(
+                textBuf, *measuredText, rectangleLineWidth, tabStops, false /* do hyphenation */);
+        LineBreakResult actual;
+        size_t callCount = 0;
+        breakIntoLinesInChunks(textBuf, builder, HyphenationFrequency::None, rectangleLineWidth,
+                               tabStops, 40 /* chunkLength */, [&](LineBreakResult&& lines) {
+                                   callCount++;
+                                   EXPECT_LE(lines.breakPoints.size(), 4u) << text;
+                                   actual.breakPoints.insert(actual.breakPoints.end(),
+                                                             lines.breakPoints.begin(),
+                                                             lines.breakPoints.end());
+                               });
+        EXPECT_EQ(expected.breakPoints, actual.breakPoints) << text;
+        EXPECT_LT(5u, callCount) << text;
+    }
+}
+
+TEST_F(GreedyLineBreakerTest, breakInChunks_runCanNotBeSplit) {
+    // A custom run which can not be split doesn't fit in a chunk, so the lines from there on are
+    // broken from the whole paragraph.
+    constexpr float CHAR_WIDTH = 10.0;
+    constexpr float ASCENT = -80.0;
+    constexpr float DESCENT = 20.0;
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "Hyphenation of long paragraphs is done in chunks. Each chunk ends after a space, "
+            "and the last line of a chunk is broken again with the next chunk. Characteristically,"
+            " the result is the same as the one of the whole paragraph.");
+    auto fc = buildFontCollection("Ascii.ttf");
+    TabStops tabStops(nullptr, 0, 10);
+    RectangleLineWidth rectangleLineWidth(100.0f);
+    for (uint32_t customStart : {0u, 120u}) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;  // Make 1em=10px
+        paint.localeListId = LocaleListCache::getId("en-US");
+        if (customStart != 0) {
+            builder.addStyleRun(0, customStart, std::move(paint), false);
+        }
+        builder.addCustomRun<ConstantRun>(Range(customStart, textBuf.size()), "en-US", CHAR_WIDTH,
+                                          ASCENT, DESCENT);
+        EXPECT_EQ(nullptr, builder.buildRange(textBuf, Range(40, 160),
+                                              false /* compute hyphenation */,
+                                              false /* compute full layout */));
+        std::unique_ptr<MeasuredText> measuredText = builder.buildRange(
+                textBuf, Range(0, textBuf.size()), false /* compute hyphenation */,
+                false /* compute full layout */);
+        ASSERT_NE(nullptr, measuredText);
+
+        const LineBreakResult expected = breakLineGreedy(
+                textBuf, *measuredText, rectangleLineWidth, tabStops, false /* do hyphenation */);
+        LineBreakResult actual;
+        size_t callCount = 0;
+        breakIntoLinesInChunks(textBuf, builder, HyphenationFrequency::None, rectangleLineWidth,
+                               tabStops, 40 /* chunkLength */, [&](LineBreakResult&& lines) {
+                                   callCount++;
+                                   ASSERT_FALSE(lines.breakPoints.empty());
+                                   for (size_t i = 0; i < lines.breakPoints.size(); i++) {
+                                       actual.breakPoints.push_back(lines.breakPoints[i]);
+                                       actual.widths.push_back(lines.widths[i]);
+                                       actual.ascents.push_back(lines.ascents[i]);
+                                       actual.descents.push_back(lines.descents[i]);
+                                   }
+                               });
+        EXPECT_EQ(expected.breakPoints, actual.breakPoints) << customStart;
+        ASSERT_EQ(expected.widths.size(), actual.widths.size());
+        for (size_t i = 0; i < expected.widths.size(); i++) {
+            EXPECT_FLOAT_EQ(expected.widths[i], actual.widths[i]) << i;
+        }
+        EXPECT_EQ(expected.ascents, actual.ascents);
+        EXPECT_EQ(expected.descents, actual.descents);
+        if (customStart == 0) {
+            EXPECT_EQ(1u, callCount);
+        } else {
+            // The chunks before the custom run are still broken one at a time.
+            EXPECT_LT(1u, callCount);
+        }
+    }
+}
+
+TEST_F(GreedyLineBreakerTest, precomputedWordBreaks) {
+    constexpr float CHAR_WIDTH = 10.0;
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "Breaking again at another width reuses the word breaks. Mail a@example.com or see "
+            "http://example.com/a/b, (quoted) \"words\" and hyphenation.");
+    auto build = [&](bool precompute) {
+        MeasuredTextBuilder builder;
+        builder.addCustomRun<ConstantRun>(Range(0, 30), "en-US", CHAR_WIDTH, ASCENT, DESCENT);
+        builder.addCustomRun<ConstantRun>(Range(30, 70), "fr-FR", CHAR_WIDTH, ASCENT, DESCENT);
+        // The locale changes in the middle of the URL.
+        builder.addCustomRun<ConstantRun>(Range(70, 90), "en-US", CHAR_WIDTH, ASCENT, DESCENT);
+        builder.addCustomRun<ConstantRun>(Range(90, textBuf.size()), "en-US", CHAR_WIDTH, ASCENT,
+                                          DESCENT);
+        return precompute ? builder.buildWithWordBreaks(textBuf, false /* compute hyphenation */,
+                                                        false /* compute full layout */,
+                                                        nullptr /* no hint */)
+                          : builder.build(textBuf, false /* compute hyphenation */,
+                                          false /* compute full layout */, nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> measuredText = build(false);
+    std::unique_ptr<MeasuredText> precomputed = build(true);
+    EXPECT_TRUE(measuredText->wordBreaks.empty());
+    EXPECT_FALSE(precomputed->wordBreaks.empty());
+    TabStops tabStops(nullptr, 0, 10);
+
+    for (float lineWidth = 10.0f; lineWidth <= 500.0f; lineWidth += 10.0f) {
+        RectangleLineWidth rectangleLineWidth(lineWidth);
+        for (bool doHyphenation : {false, true}) {
+            const LineBreakResult expected = breakLineGreedy(
+                    textBuf, *measuredText, rectangleLineWidth, tabStops, doHyphenation);
+            const LineBreakResult actual = breakLineGreedy(
+                    textBuf, *precomputed, rectangleLineWidth, tabStops, doHyphenation);
+            EXPECT_EQ(expected.breakPoints, actual.breakPoints)
+                    << lineWidth << ", " << doHyphenation;
+            EXPECT_EQ(expected.widths, actual.widths);
+            EXPECT_EQ(expected.flags, actual.flags);
+        }
+    }
+}
 }  // namespace
 }  // namespace minikin
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HyphenationCache.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+class TestableHyphenationCache : public HyphenationCache {
+public:
+    TestableHyphenationCache(uint32_t maxEntries) : HyphenationCache(maxEntries) {}
+};
+
+static std::vector<HyphenationType> hyphenate(HyphenationCache* cache,
+                                              const Hyphenator& hyphenator, const char* word) {
+    const std::vector<uint16_t> text = utf8ToUtf16(word);
+    std::vector<HyphenationType> result(text.size());
+    cache->hyphenate(hyphenator, text, result.data());
+    return result;
+}
+
+TEST(HyphenationCacheTest, cacheHitTest) {
+    // Hyphenators without patterns only break at soft hyphens.
+    std::unique_ptr<Hyphenator> hyphenator(Hyphenator::loadBinary(nullptr, 2, 2, "en"));
+    TestableHyphenationCache cache(64);
+    const char* word = "hy\u00ADphen";
+
+    std::vector<HyphenationType> expected;
+    hyphenator->hyphenate(utf8ToUtf16(word), &expected);
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, expected[3]);
+
+    EXPECT_EQ(expected, hyphenate(&cache, *hyphenator, word));
+    EXPECT_EQ(0u, cache.getHitCount());
+    EXPECT_EQ(1u, cache.getMissCount());
+
+    EXPECT_EQ(expected, hyphenate(&cache, *hyphenator, word));
+    EXPECT_EQ(1u, cache.getHitCount());
+    EXPECT_EQ(1u, cache.getMissCount());
+    EXPECT_EQ(0.5f, cache.getHitRate());
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.getHitCount());
+    EXPECT_EQ(0u, cache.getMissCount());
+    EXPECT_EQ(0.0f, cache.getHitRate());
+    EXPECT_EQ(expected, hyphenate(&cache, *hyphenator, word));
+    EXPECT_EQ(1u, cache.getMissCount());
+}
+
+TEST(HyphenationCacheTest, differentHyphenatorTest) {
+    std::unique_ptr<Hyphenator> english(Hyphenator::loadBinary(nullptr, 2, 2, "en"));
+    std::unique_ptr<Hyphenator> polish(Hyphenator::loadBinary(nullptr, 2, 2, "pl"));
+    EXPECT_NE(english->getId(), polish->getId());
+    TestableHyphenationCache cache(64);
+
+    // Polish repeats the hyphen at the start of the next line.
+    const char* word = "czerwono-niebieska";
+    std::vector<HyphenationType> expectedEnglish;
+    english->hyphenate(utf8ToUtf16(word), &expectedEnglish);
+    std::vector<HyphenationType> expectedPolish;
+    polish->hyphenate(utf8ToUtf16(word), &expectedPolish);
+    ASSERT_NE(expectedEnglish, expectedPolish);
+
+    EXPECT_EQ(expectedEnglish, hyphenate(&cache, *english, word));
+    EXPECT_EQ(expectedPolish, hyphenate(&cache, *polish, word));
+    EXPECT_EQ(0u, cache.getHitCount());
+    EXPECT_EQ(expectedEnglish, hyphenate(&cache, *english, word));
+    EXPECT_EQ(1u, cache.getHitCount());
+}
+
+TEST(HyphenationCacheTest, evictionTest) {
+    std::unique_ptr<Hyphenator> hyphenator(Hyphenator::loadBinary(nullptr, 2, 2, "en"));
+    // One entry per shard at most.
+    TestableHyphenationCache cache(1);
+    const char* words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+                           "hotel", "india", "juliett", "kilo", "lima"};
+    for (const char* word : words) {
+        hyphenate(&cache, *hyphenator, word);
+    }
+    // Some of the words are evicted, but every lookup still gives the right result.
+    for (const char* word : words) {
+        std::vector<HyphenationType> expected;
+        hyphenator->hyphenate(utf8ToUtf16(word), &expected);
+        EXPECT_EQ(expected, hyphenate(&cache, *hyphenator, word));
+    }
+    EXPECT_LT(12u, cache.getMissCount());
+}
+
+}  // namespace minikin
@@ -16,10 +16,15 @@
 
 #include "HyphenatorMap.h"
 
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "PathUtils.h"
+#include "UnicodeUtils.h"
 
 namespace minikin {
 namespace {
@@ -67,7 +72,9 @@ public:
     TestableHyphenatorMap() : HyphenatorMap() {}
 
     using HyphenatorMap::addAliasInternal;
+    using HyphenatorMap::addFileInternal;
     using HyphenatorMap::addInternal;
+    using HyphenatorMap::getSnapshotCount;
     using HyphenatorMap::lookupInternal;
 };
 
@@ -143,6 +150,22 @@ protected:
         return mMap.lookupInternal(getLocale(localeStr));
     }
 
+    const Hyphenator* lookup(const Locale& locale) { return mMap.lookupInternal(locale); }
+
+    void add(const std::string& localeStr, const Hyphenator* hyphenator) {
+        mMap.addInternal(localeStr, hyphenator);
+    }
+
+    void addFile(const std::string& localeStr, const std::string& path) {
+        mMap.addFileInternal(localeStr, path, 2, 3);
+    }
+
+    void addAlias(const std::string& fromLocaleStr, const std::string& toLocaleStr) {
+        mMap.addAliasInternal(fromLocaleStr, toLocaleStr);
+    }
+
+    size_t getSnapshotCount() { return mMap.getSnapshotCount(); }
+
 private:
     TestableHyphenatorMap mMap;
 };
@@ -303,5 +326,114 @@ TEST_F(HyphenatorMapTest, CyrlScriptFallback) {
     EXPECT_NE(MN_CYRL_HYPHENATOR, lookup("und-Cyrl"));
 }
 
+TEST_F(HyphenatorMapTest, registrationAfterLookup) {
+    // The fallback result is memoized, but a later registration must take precedence.
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-AR"));
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-AR"));
+    add("es-AR", PT_HYPHENATOR);
+    EXPECT_EQ(PT_HYPHENATOR, lookup("es-AR"));
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-BO"));
+
+    EXPECT_EQ(EN_US_HYPHENATOR, lookup("en-AS"));
+    addAlias("en-AS", "en-GB");
+    EXPECT_EQ(EN_GB_HYPHENATOR, lookup("en-AS"));
+}
+
+TEST_F(HyphenatorMapTest, concurrentLookup) {
+    constexpr int kThreadCount = 4;
+    constexpr int kLookupCount = 1000;
+    // Resolve the locales once, since LocaleListCache is not part of this test.
+    const Locale& esAr = getLocale("es-AR");
+    const Locale& deCh = getLocale("de-CH-1901");
+    const Locale& am = getLocale("am");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < kLookupCount; j++) {
+                const Hyphenator* es = lookup(esAr);
+                EXPECT_TRUE(es == ES_HYPHENATOR || es == PT_HYPHENATOR);
+                EXPECT_EQ(DE_CH_1901_HYPHENATOR, lookup(deCh));
+                EXPECT_EQ(UND_ETHI_HYPHENATOR, lookup(am));
+            }
+        });
+    }
+    add("es-AR", PT_HYPHENATOR);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(PT_HYPHENATOR, lookup(esAr));
+}
+
+TEST_F(HyphenatorMapTest, replacedSnapshotsAreDeleted) {
+    // Each fallback result publishes a snapshot. The replaced ones are deleted since no other
+    // lookup is reading them.
+    for (const char* region : {"AR", "BO", "CL", "CO", "CR", "CU", "DO", "EC", "GT", "HN", "MX",
+                               "NI", "PA", "PE", "PR", "PY", "SV", "UY", "VE"}) {
+        EXPECT_EQ(ES_HYPHENATOR, lookup(std::string("es-") + region));
+        EXPECT_EQ(1u, getSnapshotCount());
+    }
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-AR"));
+
+    // A file loaded by a lookup does not drop the fallback results.
+    addFile("eo", getTestDataDir() + "hyph-test.hyb");
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-AR"));
+    EXPECT_NE(lookup("ja"), lookup("eo"));
+    EXPECT_EQ(ES_HYPHENATOR, lookup("es-BO"));
+    EXPECT_EQ(1u, getSnapshotCount());
+}
+
+TEST_F(HyphenatorMapTest, lazyFile) {
+    addFile("eo", getTestDataDir() + "hyph-test.hyb");
+    addAlias("ia", "eo");
+    addFile("io", getTestDataDir() + "NonExistent.hyb");
+
+    const Hyphenator* hyphenator = lookup("eo");
+    ASSERT_NE(nullptr, hyphenator);
+    EXPECT_NE(lookup("ja"), hyphenator);
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(utf8ToUtf16("hyphenation"), &result);
+    ASSERT_EQ((size_t)11, result.size());
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[2]);
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[6]);
+
+    // The alias and the fallback share the mapped file.
+    EXPECT_EQ(hyphenator, lookup("ia"));
+    EXPECT_EQ(hyphenator, lookup("eo-FR"));
+
+    // A missing file is the same as no registration.
+    EXPECT_EQ(lookup("ja"), lookup("io"));
+}
+
+TEST_F(HyphenatorMapTest, concurrentLazyFile) {
+    // The file is mapped without the lock, but all the lookups get the same hyphenator.
+    addFile("eo", getTestDataDir() + "hyph-test.hyb");
+    const Locale& eo = getLocale("eo");
+    const Locale& eoFr = getLocale("eo-FR");
+    constexpr int kThreadCount = 4;
+    std::vector<const Hyphenator*> results(kThreadCount * 2);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; i++) {
+        threads.emplace_back([&, i]() {
+            results[i * 2] = lookup(i % 2 == 0 ? eo : eoFr);
+            results[i * 2 + 1] = lookup(i % 2 == 0 ? eoFr : eo);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_NE(lookup("ja"), results[0]);
+    for (const Hyphenator* result : results) {
+        EXPECT_EQ(results[0], result);
+    }
+}
+
+TEST_F(HyphenatorMapTest, lazyFileFallback) {
+    // The fallback to a language registered by file maps the file.
+    addFile("eo", getTestDataDir() + "hyph-test.hyb");
+    const Hyphenator* hyphenator = lookup("eo-FR");
+    EXPECT_NE(lookup("ja"), hyphenator);
+    EXPECT_EQ(hyphenator, lookup("eo"));
+}
+
 }  // namespace
 }  // namespace minikin
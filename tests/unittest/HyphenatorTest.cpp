@@ -19,6 +19,8 @@
 #include <gtest/gtest.h>
 
 #include "FileUtils.h"
+#include "PathUtils.h"
+#include "UnicodeUtils.h"
 
 #ifndef NELEM
 #define NELEM(x) ((sizeof(x) / sizeof((x)[0])))
@@ -338,4 +340,142 @@ TEST(HyphenatorTest, startingHyphenMinus) {
     EXPECT_EQ(HyphenationType::DONT_BREAK, result[1]);
 }
 
+// hyph-test.hyb has the pattern automaton (version 1) and the two-level alphabet table (format 2),
+// and hyph-test-v0.hyb is the same patterns without them. Both must hyphenate the same way.
+TEST(HyphenatorTest, patternAutomaton) {
+    std::vector<uint8_t> automatonData = readWholeFile(getTestDataDir() + "hyph-test.hyb");
+    std::vector<uint8_t> trieData = readWholeFile(getTestDataDir() + "hyph-test-v0.hyb");
+    Hyphenator* automatonHyphenator = Hyphenator::loadBinary(automatonData.data(), 2, 3, "en");
+    Hyphenator* trieHyphenator = Hyphenator::loadBinary(trieData.data(), 2, 3, "en");
+
+    std::vector<HyphenationType> result;
+    automatonHyphenator->hyphenate(utf8ToUtf16("hyphenation"), &result);
+    ASSERT_EQ((size_t)11, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(i == 2 || i == 6 ? HyphenationType::BREAK_AND_INSERT_HYPHEN
+                                   : HyphenationType::DONT_BREAK,
+                  result[i])
+                << i;
+    }
+
+    // "table" is in the exceptions list.
+    automatonHyphenator->hyphenate(utf8ToUtf16("table"), &result);
+    ASSERT_EQ((size_t)5, result.size());
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[2]);
+
+    const char* words[] = {"hyphenation", "Hyphenation", "table", "project", "nation",
+                           "henna", "onion", "station", "tablet", "enable",
+                           "hyph\u00E9nation", "HYPH\u00C9NATION", "tata\U00010428ta",
+                           "TATA\U00010400TA", "taxi"};
+    std::vector<HyphenationType> expected;
+    for (const char* word : words) {
+        const std::vector<uint16_t> utf16 = utf8ToUtf16(word);
+        trieHyphenator->hyphenate(utf16, &expected);
+        automatonHyphenator->hyphenate(utf16, &result);
+        EXPECT_EQ(expected, result) << word;
+    }
+}
+
+// Words which are not in NFC are normalized before the pattern lookup, and the hyphenation points
+// are mapped back to the original offsets.
+TEST(HyphenatorTest, normalization) {
+    std::vector<uint8_t> patternData = readWholeFile(getTestDataDir() + "hyph-test.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+
+    // "hyphénation" with a precomposed e with acute, hyphenated as "hy-phé-na-tion".
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(utf8ToUtf16("hyph\u00E9nation"), &result);
+    ASSERT_EQ((size_t)11, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(i == 2 || i == 5 || i == 7 ? HyphenationType::BREAK_AND_INSERT_HYPHEN
+                                             : HyphenationType::DONT_BREAK,
+                  result[i])
+                << i;
+    }
+
+    // The same word with a combining acute accent. The breaks after the accent shift by one.
+    hyphenator->hyphenate(utf8ToUtf16("hyphe\u0301nation"), &result);
+    ASSERT_EQ((size_t)12, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(i == 2 || i == 6 || i == 8 ? HyphenationType::BREAK_AND_INSERT_HYPHEN
+                                             : HyphenationType::DONT_BREAK,
+                  result[i])
+                << i;
+    }
+}
+
+// Non-BMP characters are looked up as code points. The test patterns break before U+10428 DESERET
+// SMALL LETTER LONG I when it follows 'a'.
+TEST(HyphenatorTest, nonBmp) {
+    std::vector<uint8_t> patternData = readWholeFile(getTestDataDir() + "hyph-test.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+    std::vector<HyphenationType> result;
+    hyphenator->hyphenate(utf8ToUtf16("tata\U00010428ta"), &result);
+    ASSERT_EQ((size_t)8, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ(i == 4 ? HyphenationType::BREAK_AND_INSERT_HYPHEN : HyphenationType::DONT_BREAK,
+                  result[i])
+                << i;
+    }
+
+    // The capital letter is case folded.
+    hyphenator->hyphenate(utf8ToUtf16("TATA\U00010400TA"), &result);
+    ASSERT_EQ((size_t)8, result.size());
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[4]);
+    EXPECT_EQ(HyphenationType::DONT_BREAK, result[5]);
+}
+
+TEST(HyphenatorTest, paragraph) {
+    std::vector<uint8_t> patternData = readWholeFile(getTestDataDir() + "hyph-test.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(patternData.data(), 2, 3, "en");
+    const std::vector<uint16_t> text = utf8ToUtf16("hyphenation, x hyphenation");
+    std::vector<HyphenationType> result(text.size(), HyphenationType::BREAK_AND_INSERT_HYPHEN);
+    hyphenator->hyphenate(text, {Range(0, 11), Range(13, 14), Range(15, 26)}, &result);
+    ASSERT_EQ(text.size(), result.size());
+
+    // Same as hyphenating each word alone.
+    std::vector<HyphenationType> word;
+    hyphenator->hyphenate(utf8ToUtf16("hyphenation"), &word);
+    for (size_t i = 0; i < result.size(); i++) {
+        HyphenationType expected = HyphenationType::DONT_BREAK;
+        if (i < 11) {
+            expected = word[i];
+        } else if (i >= 15) {
+            expected = word[i - 15];
+        }
+        EXPECT_EQ(expected, result[i]) << i;
+    }
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[2]);
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, result[17]);
+
+    // Empty ranges, even at the end of the text, write nothing.
+    std::vector<HyphenationType> out(text.size() + 1, HyphenationType::BREAK_AND_INSERT_HYPHEN);
+    hyphenator->hyphenate(
+            text, {Range(0, 11), Range(12, 12), Range(13, 14), Range(15, 26), Range(26, 26)},
+            out.data());
+    for (size_t i = 0; i < text.size(); i++) {
+        EXPECT_EQ(result[i], out[i]) << i;
+    }
+    EXPECT_EQ(HyphenationType::BREAK_AND_INSERT_HYPHEN, out[text.size()]);
+}
+
+TEST(HyphenatorTest, isValidBinary) {
+    for (const char* file : {"hyph-test.hyb", "hyph-test-v0.hyb"}) {
+        std::vector<uint8_t> data = readWholeFile(getTestDataDir() + file);
+        EXPECT_TRUE(Hyphenator::isValidBinary(data.data(), data.size())) << file;
+        // Truncated.
+        EXPECT_FALSE(Hyphenator::isValidBinary(data.data(), data.size() - 1)) << file;
+        EXPECT_FALSE(Hyphenator::isValidBinary(data.data(), 16)) << file;
+        // Broken magic.
+        std::vector<uint8_t> broken = data;
+        broken[0] ^= 0xff;
+        EXPECT_FALSE(Hyphenator::isValidBinary(broken.data(), broken.size())) << file;
+        // Broken table offset. The trie offset is the fourth field.
+        broken = data;
+        broken[3 * 4 + 3] = 0xff;
+        EXPECT_FALSE(Hyphenator::isValidBinary(broken.data(), broken.size())) << file;
+    }
+    EXPECT_FALSE(Hyphenator::isValidBinary(nullptr, 0));
+}
+
 }  // namespace minikin
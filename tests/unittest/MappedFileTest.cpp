@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/MappedFile.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "FileUtils.h"
+#include "PathUtils.h"
+
+namespace minikin {
+
+TEST(MappedFileTest, open) {
+    const std::string path = getTestFontPath("Ascii.ttf");
+    std::unique_ptr<MappedFile> file = MappedFile::open(path);
+    ASSERT_NE(nullptr, file);
+    std::vector<uint8_t> expected = readWholeFile(path);
+    ASSERT_EQ(expected.size(), file->size());
+    EXPECT_EQ(0, memcmp(expected.data(), file->data(), file->size()));
+}
+
+TEST(MappedFileTest, openNonExistentFile) {
+    EXPECT_EQ(nullptr, MappedFile::open(getTestFontPath("NonExistent.ttf")));
+}
+
+}  // namespace minikin
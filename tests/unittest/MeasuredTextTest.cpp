@@ -16,18 +16,32 @@
 
 #include "minikin/MeasuredText.h"
 
+#include <algorithm>
+#include <map>
+
 #include <gtest/gtest.h>
 
+#include "minikin/Hyphenator.h"
 #include "minikin/LineBreaker.h"
 #include "minikin/Measurement.h"
 
+#include "FileUtils.h"
 #include "FontTestUtils.h"
+#include "HyphenatorMap.h"
 #include "UnicodeUtils.h"
 
 namespace minikin {
 
 constexpr float CHAR_WIDTH = 10.0;  // Mock implementation always returns 10.0 for advance.
 
+static std::vector<float> getAdvances(const LayoutPieceView& piece) {
+    std::vector<float> advances;
+    for (uint32_t i = 0; i < piece.advanceCount(); i++) {
+        advances.push_back(piece.advanceAt(i));
+    }
+    return advances;
+}
+
 TEST(MeasuredTextTest, RunTests) {
     constexpr uint32_t CHAR_COUNT = 6;
     constexpr float REPLACEMENT_WIDTH = 20.0f;
@@ -532,4 +546,428 @@ TEST(MeasuredTextTest, buildLayoutTest_multiStyle_differentPaint) {
     EXPECT_EQ(MinikinRect(0.0f, 30.0f, 390.0f, 0.0f), rect);
 }
 
+TEST(MeasuredTextTest, parallelMeasureTest) {
+    std::vector<uint8_t> hyphenationPattern =
+            readWholeFile("/system/usr/hyphen-data/hyph-en-us.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(
+            hyphenationPattern.data(), 2 /* min prefix */, 2 /* min suffix */, "en-US");
+    HyphenatorMap::add("en-US", hyphenator);
+    auto text = utf8ToUtf16(
+            "Hyphenation of extraordinarily long words happens in multiple style runs. "
+            "Internationalization and localization are measured independently. "
+            "Characteristically, the measurement must be deterministic.");
+    auto font = buildFontCollection("Ascii.ttf");
+    const uint32_t localeListId = registerLocaleList("en-US");
+
+    auto build = [&](uint32_t threadCount) {
+        MeasuredTextBuilder builder;
+        constexpr uint32_t kRunLength = 17;
+        for (uint32_t start = 0; start < text.size(); start += kRunLength) {
+            const uint32_t end = std::min<uint32_t>(start + kRunLength, text.size());
+            if ((start / kRunLength) % 5 == 4) {
+                builder.addReplacementRun(start, end, 5.0f, localeListId);
+                continue;
+            }
+            MinikinPaint paint(font);
+            paint.size = (start / kRunLength) % 2 == 0 ? 10.0f : 20.0f;
+            paint.localeListId = localeListId;
+            builder.addStyleRun(start, end, std::move(paint), false /* is RTL */);
+        }
+        return builder.build(text, true /* hyphenation */, true /* full layout */,
+                             nullptr /* no hint */, threadCount);
+    };
+
+    std::unique_ptr<MeasuredText> expected = build(1);
+    for (uint32_t threadCount : {2, 4}) {
+        std::unique_ptr<MeasuredText> actual = build(threadCount);
+        EXPECT_EQ(expected->widths, actual->widths) << threadCount;
+        ASSERT_EQ(expected->hyphenBreaks.size(), actual->hyphenBreaks.size()) << threadCount;
+        for (size_t i = 0; i < expected->hyphenBreaks.size(); i++) {
+            const HyphenBreak& e = expected->hyphenBreaks[i];
+            const HyphenBreak& a = actual->hyphenBreaks[i];
+            EXPECT_EQ(e.offset, a.offset) << i;
+            EXPECT_EQ(e.type, a.type) << i;
+            EXPECT_EQ(e.first, a.first) << i;
+            EXPECT_EQ(e.second, a.second) << i;
+        }
+        EXPECT_EQ(expected->layoutPieces.paintMap, actual->layoutPieces.paintMap);
+        ASSERT_EQ(expected->layoutPieces.size(), actual->layoutPieces.size());
+        for (const auto& [key, index] : expected->layoutPieces.sortedKeys) {
+            const uint32_t actualIndex = actual->layoutPieces.find(key);
+            ASSERT_NE(LayoutPieces::kNotFound, actualIndex);
+            EXPECT_EQ(getAdvances(LayoutPieceView(&expected->layoutPieces, index)),
+                      getAdvances(LayoutPieceView(&actual->layoutPieces, actualIndex)));
+        }
+        EXPECT_EQ(expected->getMemoryUsage(), actual->getMemoryUsage());
+    }
+    HyphenatorMap::clear();
+}
+
+TEST(MeasuredTextTest, buildAfterEditTest) {
+    std::vector<uint8_t> hyphenationPattern =
+            readWholeFile("/system/usr/hyphen-data/hyph-en-us.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(
+            hyphenationPattern.data(), 2 /* min prefix */, 2 /* min suffix */, "en-US");
+    HyphenatorMap::add("en-US", hyphenator);
+    auto font = buildFontCollection("Ascii.ttf");
+    const uint32_t localeListId = registerLocaleList("en-US");
+
+    const std::string before = "Hyphenation of long words. Internationalization is measured.";
+    const uint32_t editStart = 15;  // the offset of "long"
+    const uint32_t editLength = 4;
+    const std::string inserted = "extraordinarily";
+    const uint32_t runBoundary = 27;  // the offset of "Internationalization"
+
+    auto build = [&](const std::vector<uint16_t>& text, uint32_t boundary,
+                     const MeasuredText* previous) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        paint.localeListId = localeListId;
+        builder.addStyleRun(0, boundary, std::move(paint), false /* is RTL */);
+        builder.addReplacementRun(boundary, boundary + 1, 5.0f, localeListId);
+        MinikinPaint paint2(font);
+        paint2.size = 20.0f;
+        paint2.localeListId = localeListId;
+        builder.addStyleRun(boundary + 1, text.size(), std::move(paint2), false /* is RTL */);
+        if (previous == nullptr) {
+            return builder.build(text, true /* hyphenation */, true /* full layout */,
+                                 nullptr /* no hint */);
+        }
+        return builder.buildAfterEdit(text, true /* hyphenation */, true /* full layout */,
+                                      *previous, Range(editStart, editStart + editLength),
+                                      inserted.size());
+    };
+
+    std::string after = before;
+    after.replace(editStart, editLength, inserted);
+    const uint32_t delta = inserted.size() - editLength;
+    std::unique_ptr<MeasuredText> previous = build(utf8ToUtf16(before), runBoundary, nullptr);
+    std::unique_ptr<MeasuredText> expected =
+            build(utf8ToUtf16(after), runBoundary + delta, nullptr);
+    std::unique_ptr<MeasuredText> actual =
+            build(utf8ToUtf16(after), runBoundary + delta, previous.get());
+
+    EXPECT_EQ(expected->widths, actual->widths);
+    ASSERT_EQ(expected->hyphenBreaks.size(), actual->hyphenBreaks.size());
+    for (size_t i = 0; i < expected->hyphenBreaks.size(); i++) {
+        const HyphenBreak& e = expected->hyphenBreaks[i];
+        const HyphenBreak& a = actual->hyphenBreaks[i];
+        EXPECT_EQ(e.offset, a.offset) << i;
+        EXPECT_EQ(e.type, a.type) << i;
+        EXPECT_EQ(e.first, a.first) << i;
+        EXPECT_EQ(e.second, a.second) << i;
+    }
+    const std::vector<uint16_t> text = utf8ToUtf16(after);
+    for (const auto& run : expected->runs) {
+        const Range& range = run->getRange();
+        if (run->getPaint() == nullptr) {
+            continue;  // Replacement run.
+        }
+        const Layout expectedLayout =
+                expected->buildLayout(text, range, range, *run->getPaint(),
+                                      StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        const Layout actualLayout =
+                actual->buildLayout(text, range, range, *run->getPaint(),
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        EXPECT_EQ(expectedLayout.getAdvances(), actualLayout.getAdvances());
+    }
+    HyphenatorMap::clear();
+}
+
+// Returns the contexts of the hyphenated pieces, by key.
+static std::map<LayoutPieces::Key, Range> getHyphenatedPieces(const LayoutPieces& pieces) {
+    std::map<LayoutPieces::Key, Range> out;
+    for (const auto& [key, index] : pieces.sortedKeys) {
+        if (key.hyphenEdit != 0) {
+            out.emplace(key, pieces.entries[index].context);
+        }
+    }
+    for (const auto& [key, index] : pieces.offsetMap) {
+        if (key.hyphenEdit != 0) {
+            out.emplace(key, pieces.entries[index].context);
+        }
+    }
+    return out;
+}
+
+TEST(MeasuredTextTest, buildAfterEditTest_hyphenatedPieces) {
+    std::vector<uint8_t> hyphenationPattern =
+            readWholeFile("/system/usr/hyphen-data/hyph-en-us.hyb");
+    Hyphenator* hyphenator = Hyphenator::loadBinary(
+            hyphenationPattern.data(), 2 /* min prefix */, 2 /* min suffix */, "en-US");
+    HyphenatorMap::add("en-US", hyphenator);
+    auto font = buildFontCollection("Ascii.ttf");
+    const uint32_t localeListId = registerLocaleList("en-US");
+
+    auto build = [&](const std::string& str, const MeasuredText* previous,
+                     const Range& editRange, uint32_t newLength) {
+        const std::vector<uint16_t> text = utf8ToUtf16(str);
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        paint.localeListId = localeListId;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        if (previous == nullptr) {
+            return builder.build(text, true /* hyphenation */, true /* full layout */,
+                                 nullptr /* no hint */);
+        }
+        return builder.buildAfterEdit(text, true /* hyphenation */, true /* full layout */,
+                                      *previous, editRange, newLength);
+    };
+
+    // The hyphenated pieces of the replaced word are dropped, the ones of the other words are
+    // kept at their offsets in the edited text, including the ones at the start of the text.
+    const std::string before = "Hyphenation is measured once. An extraordinarily long paragraph.";
+    const std::string replaced = "extraordinarily";
+    const std::vector<std::string> edits = {"internationally", "unbelievably", "", "ordinarily"};
+    std::string text = before;
+    uint32_t editStart = text.find(replaced);
+    uint32_t editLength = replaced.size();
+    std::unique_ptr<MeasuredText> measured = build(text, nullptr, Range(), 0);
+    for (const std::string& inserted : edits) {
+        text.replace(editStart, editLength, inserted);
+        measured = build(text, measured.get(), Range(editStart, editStart + editLength),
+                         inserted.size());
+        editLength = inserted.size();
+
+        std::unique_ptr<MeasuredText> expected = build(text, nullptr, Range(), 0);
+        EXPECT_EQ(expected->widths, measured->widths) << text;
+        const std::map<LayoutPieces::Key, Range> expectedPieces =
+                getHyphenatedPieces(expected->layoutPieces);
+        EXPECT_FALSE(expectedPieces.empty());
+        EXPECT_EQ(expectedPieces, getHyphenatedPieces(measured->layoutPieces)) << text;
+    }
+    HyphenatorMap::clear();
+}
+
+TEST(MeasuredTextTest, buildAfterEditTest_localeChanges) {
+    std::vector<uint8_t> enPattern = readWholeFile("/system/usr/hyphen-data/hyph-en-us.hyb");
+    std::vector<uint8_t> frPattern = readWholeFile("/system/usr/hyphen-data/hyph-fr.hyb");
+    HyphenatorMap::add("en-US", Hyphenator::loadBinary(enPattern.data(), 2 /* min prefix */,
+                                                       2 /* min suffix */, "en-US"));
+    HyphenatorMap::add("fr-FR", Hyphenator::loadBinary(frPattern.data(), 2 /* min prefix */,
+                                                       2 /* min suffix */, "fr-FR"));
+    auto font = buildFontCollection("Ascii.ttf");
+    const uint32_t enLocaleListId = registerLocaleList("en-US");
+    const uint32_t frLocaleListId = registerLocaleList("fr-FR");
+
+    struct EditCase {
+        std::string before;
+        std::vector<uint32_t> localeChanges;  // Alternating between en-US and fr-FR.
+        uint32_t editStart;
+        uint32_t editLength;
+        std::string inserted;
+    };
+    const std::vector<EditCase> cases = {
+            // The first word after the locale change is hyphenated again, but not the one before.
+            {"international hyphenation extraordinarily", {14}, 28, 2, ""},
+            // The locale changes in a URL and right after it, where the word breaker does not
+            // restart.
+            {"hyphenation http://exam.ple/path international.", {29, 33}, 46, 1, "!"},
+    };
+    for (const EditCase& c : cases) {
+        auto build = [&](const std::string& str, const MeasuredText* previous) {
+            const std::vector<uint16_t> text = utf8ToUtf16(str);
+            MeasuredTextBuilder builder;
+            uint32_t start = 0;
+            for (size_t i = 0; i <= c.localeChanges.size(); i++) {
+                const uint32_t end = i < c.localeChanges.size() ? c.localeChanges[i] : text.size();
+                MinikinPaint paint(font);
+                paint.size = 10.0f;
+                paint.localeListId = i % 2 == 0 ? enLocaleListId : frLocaleListId;
+                builder.addStyleRun(start, end, std::move(paint), false /* is RTL */);
+                start = end;
+            }
+            if (previous == nullptr) {
+                return builder.build(text, true /* hyphenation */, false /* full layout */,
+                                     nullptr /* no hint */);
+            }
+            return builder.buildAfterEdit(text, true /* hyphenation */, false /* full layout */,
+                                          *previous,
+                                          Range(c.editStart, c.editStart + c.editLength),
+                                          c.inserted.size());
+        };
+
+        std::string after = c.before;
+        after.replace(c.editStart, c.editLength, c.inserted);
+        std::unique_ptr<MeasuredText> previous = build(c.before, nullptr);
+        std::unique_ptr<MeasuredText> expected = build(after, nullptr);
+        std::unique_ptr<MeasuredText> actual = build(after, previous.get());
+
+        EXPECT_FALSE(expected->hyphenBreaks.empty()) << after;
+        ASSERT_EQ(expected->hyphenBreaks.size(), actual->hyphenBreaks.size()) << after;
+        for (size_t i = 0; i < expected->hyphenBreaks.size(); i++) {
+            EXPECT_EQ(expected->hyphenBreaks[i].offset, actual->hyphenBreaks[i].offset) << after;
+            EXPECT_EQ(expected->hyphenBreaks[i].first, actual->hyphenBreaks[i].first) << after;
+            EXPECT_EQ(expected->hyphenBreaks[i].second, actual->hyphenBreaks[i].second) << after;
+        }
+    }
+    HyphenatorMap::clear();
+}
+
+TEST(MeasuredTextTest, buildAfterEditTest_memoryUsage) {
+    auto font = buildFontCollection("Ascii.ttf");
+    auto build = [&](const std::vector<uint16_t>& text, const MeasuredText* previous,
+                     uint32_t editOffset) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        if (previous == nullptr) {
+            return builder.build(text, false /* hyphenation */, true /* full layout */,
+                                 nullptr /* no hint */);
+        }
+        return builder.buildAfterEdit(text, false /* hyphenation */, true /* full layout */,
+                                      *previous, Range(editOffset, editOffset), 1 /* newLength */);
+    };
+
+    // Types the text one character at a time. The pieces of every prefix of a word are replaced
+    // by the next one, so they must not pile up.
+    std::string text = "Typing: ";
+    std::unique_ptr<MeasuredText> measured = build(utf8ToUtf16(text), nullptr, 0);
+    const std::string typed =
+            "The quick brown fox jumps over the lazy dog. Pneumonoultramicroscopicsilicovolcano.";
+    for (char c : typed) {
+        const uint32_t offset = text.size();
+        text.push_back(c);
+        measured = build(utf8ToUtf16(text), measured.get(), offset);
+    }
+    std::unique_ptr<MeasuredText> expected = build(utf8ToUtf16(text), nullptr, 0);
+    EXPECT_EQ(expected->widths, measured->widths);
+    EXPECT_LT(measured->layoutPieces.size(), 2 * expected->layoutPieces.size());
+    EXPECT_LT(measured->getMemoryUsage(), 2 * expected->getMemoryUsage());
+}
+
+TEST(MeasuredTextTest, layoutPiecesTest_afterInsertion) {
+    auto font = buildFontCollection("Ascii.ttf");
+    auto build = [&](const std::vector<uint16_t>& text, MeasuredText* hint) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        return builder.build(text, false /* hyphenation */, true /* full layout */, hint);
+    };
+
+    std::unique_ptr<MeasuredText> before = build(utf8ToUtf16("Hello, World!"), nullptr);
+    std::unique_ptr<MeasuredText> after =
+            build(utf8ToUtf16("Oh, Hello, World!"), before.get());
+
+    // The pieces are keyed by their content, so all the pieces of the text before the insertion
+    // are found in the text after the insertion.
+    for (const auto& [key, index] : before->layoutPieces.sortedKeys) {
+        const uint32_t afterIndex = after->layoutPieces.find(key);
+        ASSERT_NE(LayoutPieces::kNotFound, afterIndex);
+        EXPECT_EQ(getAdvances(LayoutPieceView(&before->layoutPieces, index)),
+                  getAdvances(LayoutPieceView(&after->layoutPieces, afterIndex)));
+    }
+    // The pieces of the same content share a key, so only "Oh," is added.
+    EXPECT_EQ(before->layoutPieces.size() + 1, after->layoutPieces.size());
+}
+
+TEST(MeasuredTextTest, layoutPiecesTest_compact) {
+    auto text = utf8ToUtf16("Hello, World! Hello, World!");
+    auto font = buildFontCollection("Ascii.ttf");
+
+    MeasuredTextBuilder builder;
+    MinikinPaint paint(font);
+    paint.size = 10.0f;
+    builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+    std::unique_ptr<MeasuredText> mt =
+            builder.build(text, false /* hyphenation */, true /* full layout */, nullptr);
+
+    const LayoutPieces& pieces = mt->layoutPieces;
+    EXPECT_TRUE(pieces.offsetMap.empty());
+    // "Hello,", " " and "World!". The repeated words share the pieces.
+    ASSERT_EQ(3u, pieces.sortedKeys.size());
+    EXPECT_TRUE(std::is_sorted(
+            pieces.sortedKeys.begin(), pieces.sortedKeys.end(),
+            [](const auto& l, const auto& r) { return l.first < r.first; }));
+    EXPECT_EQ(text.size() / 2, pieces.advances.size());
+    for (const auto& [key, index] : pieces.sortedKeys) {
+        EXPECT_EQ(index, pieces.find(key));
+    }
+
+    // The compacted pieces give the same layout as the one without the pieces.
+    MinikinPaint layoutPaint(font);
+    layoutPaint.size = 10.0f;
+    Layout layout = mt->buildLayout(text, Range(0, text.size()), Range(0, text.size()),
+                                    layoutPaint, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    Layout expected(text, Range(0, text.size()), Bidi::FORCE_LTR, layoutPaint,
+                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(expected.getAdvances(), layout.getAdvances());
+    EXPECT_EQ(expected.getAdvance(), layout.getAdvance());
+}
+
+TEST(MeasuredTextTest, lazyLayoutTest) {
+    auto text = utf8ToUtf16("Hello, World! Lazy layout.");
+    auto font = buildFontCollection("Ascii.ttf");
+    auto build = [&](bool lazy, uint32_t maxPieceCount) {
+        MeasuredTextBuilder builder;
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        builder.addStyleRun(0, text.size(), std::move(paint), false /* is RTL */);
+        if (lazy) {
+            return builder.buildWithLazyLayout(text, false /* hyphenation */, nullptr /* hint */,
+                                               maxPieceCount);
+        }
+        return builder.build(text, false /* hyphenation */, true /* full layout */, nullptr);
+    };
+
+    std::unique_ptr<MeasuredText> eager = build(false, 0);
+    std::unique_ptr<MeasuredText> lazy = build(true, 16);
+    EXPECT_EQ(eager->widths, lazy->widths);
+    EXPECT_EQ(0u, lazy->layoutPieces.size());
+    EXPECT_EQ(0u, lazy->layoutPieces.lazyPieces->pieces.size());
+    const uint32_t usageBeforeDraw = lazy->getMemoryUsage();
+
+    const Range helloWorld(0, 13);
+    EXPECT_EQ(eager->getBounds(text, helloWorld), lazy->getBounds(text, helloWorld));
+    // "Hello,", " " and "World!" are kept.
+    EXPECT_EQ(3u, lazy->layoutPieces.lazyPieces->pieces.size());
+    EXPECT_LT(usageBeforeDraw, lazy->getMemoryUsage());
+    EXPECT_EQ(eager->getBounds(text, helloWorld), lazy->getBounds(text, helloWorld));
+    EXPECT_EQ(3u, lazy->layoutPieces.lazyPieces->pieces.size());
+
+    // The kept pieces are bounded.
+    std::unique_ptr<MeasuredText> bounded = build(true, 2);
+    const Range all(0, text.size());
+    EXPECT_EQ(eager->getBounds(text, all), bounded->getBounds(text, all));
+    EXPECT_GE(2u, bounded->layoutPieces.lazyPieces->pieces.size());
+}
+
+TEST(MeasuredTextTest, measureHyphenPiecesTest) {
+    const std::vector<std::pair<StartHyphenEdit, EndHyphenEdit>> edits = {
+            {StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT},
+            {StartHyphenEdit::NO_EDIT, EndHyphenEdit::INSERT_HYPHEN},
+            {StartHyphenEdit::INSERT_HYPHEN, EndHyphenEdit::INSERT_HYPHEN},
+            {StartHyphenEdit::NO_EDIT, EndHyphenEdit::REPLACE_WITH_HYPHEN},
+    };
+    // Ligature.ttf makes "ff" and "fi" into ligatures, which are not safe to break, so that some
+    // splits are shaped in full and the clusters next to the others span the ligatures.
+    const std::vector<std::pair<std::string, std::string>> fonts = {
+            {"Ascii.ttf", "(hyphenation) word"},
+            {"Ligature.ttf", "(officious) word"},
+    };
+    for (const auto& [fontFile, str] : fonts) {
+        auto text = utf8ToUtf16(str);
+        auto font = buildFontCollection(fontFile);
+        MinikinPaint paint(font);
+        paint.size = 10.0f;
+        StyleRun run(Range(0, text.size()), std::move(paint), false /* is RTL */);
+
+        const Range context(0, str.find(' '));
+        for (const auto& [startEdit, endEdit] : edits) {
+            std::vector<HyphenSplit> splits;
+            for (uint32_t offset = context.getStart() + 1; offset < context.getEnd(); offset++) {
+                splits.emplace_back(offset, startEdit, endEdit);
+            }
+            // The widths derived from the shaped context match the ones from shaping each piece.
+            EXPECT_EQ(run.Run::measureHyphenPieces(text, context, splits, nullptr /* pieces */),
+                      run.measureHyphenPieces(text, context, splits, nullptr /* pieces */))
+                    << fontFile;
+        }
+    }
+}
+
 }  // namespace minikin
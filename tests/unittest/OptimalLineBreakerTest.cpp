@@ -24,6 +24,7 @@
 #include "FontTestUtils.h"
 #include "HyphenatorMap.h"
 #include "LineBreakerTestHelper.h"
+#include "LineBreakerUtil.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
 #include "OptimalLineBreaker.h"
@@ -2108,5 +2109,104 @@ TEST_F(OptimalLineBreakerTest, roundingError) {
     EXPECT_EQ(1u, r.breakPoints.size());
 }
 
+TEST_F(OptimalLineBreakerTest, precomputedWordBreaks) {
+    constexpr float CHAR_WIDTH = 10.0;
+    const std::vector<uint16_t> textBuf = utf8ToUtf16(
+            "Breaking again at another width reuses the word breaks. Mail a@example.com or see "
+            "http://example.com/a/b, (quoted) \"words\" and hyphenation.");
+    auto build = [&](bool precompute) {
+        MeasuredTextBuilder builder;
+        builder.addCustomRun<ConstantRun>(Range(0, 30), "en-US", CHAR_WIDTH, ASCENT, DESCENT);
+        builder.addCustomRun<ConstantRun>(Range(30, 60), "fr-FR", CHAR_WIDTH, ASCENT, DESCENT);
+        builder.addCustomRun<ConstantRun>(Range(60, textBuf.size()), "en-US", CHAR_WIDTH, ASCENT,
+                                          DESCENT);
+        return precompute ? builder.buildWithWordBreaks(textBuf, true /* compute hyphenation */,
+                                                        false /* compute full layout */,
+                                                        nullptr /* no hint */)
+                          : builder.build(textBuf, true /* compute hyphenation */,
+                                          false /* compute full layout */, nullptr /* no hint */);
+    };
+    std::unique_ptr<MeasuredText> measuredText = build(false);
+    std::unique_ptr<MeasuredText> precomputed = build(true);
+    EXPECT_TRUE(measuredText->wordBreaks.empty());
+    EXPECT_FALSE(precomputed->wordBreaks.empty());
+
+    for (float lineWidth = 10.0f; lineWidth <= 500.0f; lineWidth += 10.0f) {
+        for (BreakStrategy strategy : {BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+            for (HyphenationFrequency frequency :
+                 {HyphenationFrequency::None, HyphenationFrequency::Normal}) {
+                const LineBreakResult expected =
+                        doLineBreak(textBuf, *measuredText, strategy, frequency, lineWidth);
+                const LineBreakResult actual =
+                        doLineBreak(textBuf, *precomputed, strategy, frequency, lineWidth);
+                EXPECT_EQ(expected.breakPoints, actual.breakPoints) << lineWidth;
+                EXPECT_EQ(expected.widths, actual.widths);
+                EXPECT_EQ(expected.flags, actual.flags);
+            }
+        }
+    }
+}
+
+TEST_F(OptimalLineBreakerTest, precomputedWordBreaks_emailOrUrlAcrossLocales) {
+    constexpr float CHAR_WIDTH = 10.0;
+    // The locale changes in the middle of the URL or the email address, at 21 on a break in it.
+    for (uint32_t localeChange : {18u, 21u}) {
+        for (const std::string& text : {"This is an url: http://a.b", "This is an email: a@b.c"}) {
+            const std::vector<uint16_t> textBuf = utf8ToUtf16(text);
+            auto build = [&](bool precompute) {
+                MeasuredTextBuilder builder;
+                builder.addCustomRun<ConstantRun>(Range(0, localeChange), "en-US", CHAR_WIDTH,
+                                                  ASCENT, DESCENT);
+                builder.addCustomRun<ConstantRun>(Range(localeChange, textBuf.size()), "fr-FR",
+                                                  CHAR_WIDTH, ASCENT, DESCENT);
+                return precompute ? builder.buildWithWordBreaks(
+                                            textBuf, true /* compute hyphenation */,
+                                            false /* compute full layout */, nullptr /* no hint */)
+                                  : builder.build(textBuf, true /* compute hyphenation */,
+                                                  false /* compute full layout */,
+                                                  nullptr /* no hint */);
+            };
+            std::unique_ptr<MeasuredText> measuredText = build(false);
+            std::unique_ptr<MeasuredText> precomputed = build(true);
+
+            for (float lineWidth = 10.0f; lineWidth <= 300.0f; lineWidth += 10.0f) {
+                for (BreakStrategy strategy :
+                     {BreakStrategy::HighQuality, BreakStrategy::Balanced}) {
+                    const LineBreakResult expected =
+                            doLineBreak(textBuf, *measuredText, strategy,
+                                        HyphenationFrequency::None, lineWidth);
+                    const LineBreakResult actual = doLineBreak(
+                            textBuf, *precomputed, strategy, HyphenationFrequency::None, lineWidth);
+                    EXPECT_EQ(expected.breakPoints, actual.breakPoints)
+                            << text << ", " << localeChange << ", " << lineWidth;
+                    EXPECT_EQ(expected.widths, actual.widths);
+                    EXPECT_EQ(expected.flags, actual.flags);
+                }
+            }
+
+            // The word breaks seen by the optimal line breaker, which advances to the next break
+            // only when it reaches the current one, are the same as from a WordBreaker.
+            CharProcessor expectedProc(textBuf);
+            CharProcessor actualProc(textBuf, *precomputed);
+            for (const auto& run : precomputed->runs) {
+                expectedProc.updateLocaleIfNecessary(*run);
+                actualProc.updateLocaleIfNecessary(*run);
+                for (uint32_t i : run->getRange()) {
+                    expectedProc.feedChar(i, textBuf[i], precomputed->widths[i], true);
+                    actualProc.feedChar(i, textBuf[i], precomputed->widths[i], true);
+                    EXPECT_EQ(expectedProc.prevWordBreak, actualProc.prevWordBreak)
+                            << text << ", " << localeChange << ", " << i;
+                    EXPECT_EQ(expectedProc.nextWordBreak, actualProc.nextWordBreak)
+                            << text << ", " << localeChange << ", " << i;
+                    EXPECT_EQ(expectedProc.wordRange(), actualProc.wordRange());
+                    EXPECT_EQ(expectedProc.wordBreakPenalty(), actualProc.wordBreakPenalty());
+                    EXPECT_EQ(expectedProc.widthFromLastWordBreak(),
+                              actualProc.widthFromLastWordBreak());
+                }
+            }
+        }
+    }
+}
+
 }  // namespace
 }  // namespace minikin
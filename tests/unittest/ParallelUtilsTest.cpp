@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParallelUtils.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(ParallelUtilsTest, parallelFor) {
+    for (uint32_t threadCount : {1, 2, 4}) {
+        for (size_t count : {0, 1, 3, 100}) {
+            std::vector<std::atomic<int>> calls(count);
+            parallelFor(count, threadCount, [&](size_t i) { calls[i]++; });
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(1, calls[i]) << threadCount << ", " << count << ", " << i;
+            }
+        }
+    }
+}
+
+TEST(ParallelUtilsTest, workersAreReused) {
+    WorkerPool& pool = WorkerPool::getInstance();
+    parallelFor(100, 4, [](size_t) {});
+    const size_t workerCount = pool.getWorkerCount();
+    EXPECT_LE(workerCount, WorkerPool::kMaxWorkerCount);
+    for (int i = 0; i < 100; i++) {
+        parallelFor(100, 4, [](size_t) {});
+    }
+    EXPECT_EQ(workerCount, pool.getWorkerCount());
+}
+
+TEST(ParallelUtilsTest, concurrentCallers) {
+    // Callers must not wait for each other even if all the workers are busy.
+    std::vector<std::thread> callers;
+    std::atomic<int> total(0);
+    for (int i = 0; i < 8; i++) {
+        callers.emplace_back([&total]() {
+            for (int j = 0; j < 50; j++) {
+                parallelFor(20, 4, [&total](size_t) { total++; });
+            }
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+    EXPECT_EQ(8 * 50 * 20, total);
+}
+
+}  // namespace minikin
@@ -79,4 +79,86 @@ TEST(SparseBitSetTest, emptyBitSetBufferTest) {
     ASSERT_EQ(buffer, newBuffer);
 }
 
+TEST(SparseBitSetTest, checkedBufferTest) {
+    std::vector<uint32_t> range({10, 20, 0x1000, 0x1010});
+    SparseBitSet originalBitset(range.data(), range.size() / 2);
+    std::vector<uint8_t> buffer = writeToBuffer(originalBitset);
+    {
+        CheckedBufferReader reader(buffer.data(), buffer.size());
+        SparseBitSet bitset(&reader);
+        EXPECT_FALSE(reader.hasError());
+        EXPECT_TRUE(bitset.get(10));
+        EXPECT_TRUE(bitset.get(0x100F));
+        EXPECT_EQ(buffer, writeToBuffer(bitset));
+    }
+    {
+        // Truncated buffer.
+        CheckedBufferReader reader(buffer.data(), buffer.size() - 1);
+        SparseBitSet bitset(&reader);
+        EXPECT_TRUE(reader.hasError());
+        EXPECT_EQ(0u, bitset.length());
+        EXPECT_FALSE(bitset.get(10));
+    }
+    {
+        // mMaxVal is larger than the page table.
+        std::vector<uint8_t> broken = buffer;
+        BufferWriter writer(broken.data());
+        writer.write<uint32_t>(0x100000);
+        CheckedBufferReader reader(broken.data(), broken.size());
+        SparseBitSet bitset(&reader);
+        EXPECT_TRUE(reader.hasError());
+        EXPECT_EQ(0u, bitset.length());
+    }
+    {
+        // A page index points outside of the bitmaps.
+        std::vector<uint8_t> broken = buffer;
+        BufferReader reader(broken.data());
+        reader.skip<uint32_t>();  // mMaxVal
+        reader.skip<uint32_t>();  // mIndices size
+        uint16_t* indices = reinterpret_cast<uint16_t*>(broken.data() + reader.pos());
+        indices[0] = 0xFFF0;
+        CheckedBufferReader checkedReader(broken.data(), broken.size());
+        SparseBitSet bitset(&checkedReader);
+        EXPECT_TRUE(checkedReader.hasError());
+        EXPECT_EQ(0u, bitset.length());
+    }
+}
+
+TEST(SparseBitSetTest, tableTest) {
+    std::vector<uint32_t> range1({10, 20});
+    std::vector<uint32_t> range2({0x1000, 0x1010});
+    SparseBitSet bitset1(range1.data(), range1.size() / 2);
+    SparseBitSet bitset1Copy(range1.data(), range1.size() / 2);
+    SparseBitSet bitset2(range2.data(), range2.size() / 2);
+    SparseBitSet empty;
+
+    SparseBitSetTableWriter tableWriter;
+    tableWriter.add(&bitset1);
+    tableWriter.add(&bitset2);
+    tableWriter.add(&bitset1Copy);
+    tableWriter.add(&empty);
+    tableWriter.add(&bitset1);
+    EXPECT_EQ(3u, tableWriter.size());
+    EXPECT_EQ(tableWriter.indexOf(&bitset1), tableWriter.indexOf(&bitset1Copy));
+    EXPECT_NE(tableWriter.indexOf(&bitset1), tableWriter.indexOf(&bitset2));
+
+    std::vector<uint8_t> buffer = writeToBuffer(tableWriter);
+    {
+        BufferReader reader(buffer.data());
+        SparseBitSetTableReader tableReader(&reader);
+        EXPECT_EQ(buffer.size(), reader.pos());
+        ASSERT_EQ(3u, tableReader.size());
+        SparseBitSet copied1 = tableReader.get(tableWriter.indexOf(&bitset1));
+        EXPECT_EQ(writeToBuffer(bitset1), writeToBuffer(copied1));
+        SparseBitSet copied2 = tableReader.get(tableWriter.indexOf(&bitset2));
+        EXPECT_EQ(writeToBuffer(bitset2), writeToBuffer(copied2));
+        EXPECT_EQ(0u, tableReader.get(tableWriter.indexOf(&empty)).length());
+    }
+    {
+        CheckedBufferReader reader(buffer.data(), buffer.size() - 1);
+        SparseBitSetTableReader tableReader(&reader);
+        EXPECT_TRUE(reader.hasError());
+    }
+}
+
 }  // namespace minikin
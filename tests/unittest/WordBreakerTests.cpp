@@ -17,6 +17,8 @@
 #include "WordBreaker.h"
 
 #include <cstdio>
+#include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 #include <unicode/uclean.h>
@@ -482,6 +484,37 @@ TEST(WordBreakerTest, emailStartsWithSlash) {
     EXPECT_TRUE(breaker.wordStart() >= breaker.wordEnd());
 }
 
+TEST(WordBreakerTest, multipleEmailsAndUrls) {
+    // The email address after "café" is not detected, since the detector stops at non-ASCII
+    // characters and doesn't restart until the next break.
+    const std::vector<uint16_t> buf =
+            utf8ToUtf16("see http://a.example/x?y=z and foo@b.org, or caf\u00E9:x@y.");
+    struct Break {
+        ssize_t offset;
+        ssize_t wordStart;
+        ssize_t wordEnd;
+        int badness;
+    };
+    const Break expected[] = {
+            {4, 0, 3, 0},     {9, 4, 4, 1},     {11, 9, 9, 1},    {12, 11, 11, 1},
+            {20, 12, 12, 1},  {22, 20, 20, 1},  {24, 22, 22, 1},  {25, 24, 24, 1},
+            {27, 25, 25, 0},  {31, 27, 30, 0},  {36, 31, 31, 1},  {40, 36, 36, 1},
+            {42, 40, 40, 0},  {45, 42, 44, 0},  {54, 45, 53, 0},
+    };
+    WordBreaker breaker;
+    breaker.setText(buf.data(), buf.size());
+    ssize_t offset = breaker.followingWithLocale(Locale("en-US"), 0);
+    for (const Break& b : expected) {
+        SCOPED_TRACE(b.offset);
+        EXPECT_EQ(b.offset, offset);
+        EXPECT_EQ(b.wordStart, breaker.wordStart());
+        EXPECT_EQ(b.wordEnd, breaker.wordEnd());
+        EXPECT_EQ(b.badness, breaker.breakBadness());
+        offset = breaker.next();
+    }
+    EXPECT_EQ(-1, offset);
+}
+
 TEST(WordBreakerTest, setLocaleInsideUrl) {
     std::vector<uint16_t> buf = utf8ToUtf16("Hello http://abc/d.html World");
     WordBreaker breaker;
@@ -552,12 +585,64 @@ TEST(WordBreakerTest, spaceAfterSpace) {
     }
 }
 
+class TestableWordBreaker : public WordBreaker {
+public:
+    using WordBreaker::setSimpleTextFastPathEnabled;
+};
+
+// Returns the breaks, words and badness of the whole text as a string, for comparing the breakers.
+static std::string breakAll(TestableWordBreaker* breaker, const std::vector<uint16_t>& text) {
+    std::string result;
+    breaker->setText(text.data(), text.size());
+    ssize_t offset = breaker->followingWithLocale(Locale("en-US"), 0);
+    while (offset != -1) {
+        result += std::to_string(offset) + "(" + std::to_string(breaker->wordStart()) + "," +
+                  std::to_string(breaker->wordEnd()) + "," +
+                  std::to_string(breaker->breakBadness()) + ") ";
+        offset = breaker->next();
+    }
+    return result;
+}
+
+TEST(WordBreakerTest, simpleTextMatchesIcu) {
+    const char* kTexts[] = {
+            // Simple text.
+            "hello world",
+            "Lorem ipsum dolor sit amet, consectetur adipiscing elit.",
+            "  leading and trailing spaces  ",
+            "Wait... what?! Yes: really; 1984, 2001.",
+            "\u03A4\u03BF \u03B3\u03C1\u03AE\u03B3\u03BF\u03C1\u03BF, "
+            "\u0431\u044B\u0441\u0442\u0440\u043E! caf\u00E9 na\u00EFve",
+            "x",
+            " ",
+            // Falls back to ICU at some point.
+            "hello, world. (parenthesis) \"quotes\" don't a.b 3.5 end",
+            "sugar-free soft\u00ADhyphen foo@example.com http://example.com/a?b=c x",
+            "a .b a !b a\u00A0b a\tb \u65E5\u672C\u8A9E a \u0301b",
+            "text \U0001F468\u200D\U0001F469 \U0001F44B\U0001F3FB emoji",
+            "US\u00A2 JP\u00A5 \u00A1\u00A1hello, world!!",
+            "mailto:foo@example.com x simple text again after the url",
+    };
+    for (const char* text : kTexts) {
+        SCOPED_TRACE(text);
+        const std::vector<uint16_t> buf = utf8ToUtf16(text);
+        TestableWordBreaker icuBreaker;
+        icuBreaker.setSimpleTextFastPathEnabled(false);
+        TestableWordBreaker breaker;
+        EXPECT_EQ(breakAll(&icuBreaker, buf), breakAll(&breaker, buf));
+    }
+}
+
 class TestableICULineBreakerPoolImpl : public ICULineBreakerPoolImpl {
 public:
     TestableICULineBreakerPoolImpl() : ICULineBreakerPoolImpl() {}
+    TestableICULineBreakerPoolImpl(size_t maxThreadPoolSize, size_t maxPoolSize)
+            : ICULineBreakerPoolImpl(maxThreadPoolSize, maxPoolSize) {}
 
     using ICULineBreakerPoolImpl::getPoolSize;
+    using ICULineBreakerPoolImpl::getThreadPoolSize;
     using ICULineBreakerPoolImpl::MAX_POOL_SIZE;
+    using ICULineBreakerPoolImpl::MAX_THREAD_POOL_SIZE;
 };
 
 TEST(WordBreakerTest, LineBreakerPool_acquire_without_release) {
@@ -612,27 +697,117 @@ TEST(WordBreakerTest, LineBreakerPool_acquire_with_release) {
 
 TEST(WordBreakerTest, LineBreakerPool_exceeds_pool_size) {
     const size_t MAX_POOL_SIZE = TestableICULineBreakerPoolImpl::MAX_POOL_SIZE;
+    const size_t MAX_THREAD_POOL_SIZE = TestableICULineBreakerPoolImpl::MAX_THREAD_POOL_SIZE;
+    const size_t TOTAL_SIZE = MAX_THREAD_POOL_SIZE + MAX_POOL_SIZE;
     TestableICULineBreakerPoolImpl pool;
 
     const Locale enUS("en-Latn-US");
 
-    ICULineBreakerPool::Slot slots[MAX_POOL_SIZE * 2];
+    ICULineBreakerPool::Slot slots[TOTAL_SIZE * 2];
 
     // Make pool full.
-    for (size_t i = 0; i < MAX_POOL_SIZE * 2; i++) {
+    for (size_t i = 0; i < TOTAL_SIZE * 2; i++) {
         slots[i] = pool.acquire(enUS);
         EXPECT_EQ(0U, pool.getPoolSize());
+        EXPECT_EQ(0U, pool.getThreadPoolSize());
+    }
+    EXPECT_EQ(TOTAL_SIZE * 2, pool.getStats().openCount);
+
+    // The thread cache is filled first, and then the shared pool.
+    for (size_t i = 0; i < MAX_THREAD_POOL_SIZE; i++) {
+        pool.release(std::move(slots[i]));
+        EXPECT_EQ(i + 1, pool.getThreadPoolSize());
+        EXPECT_EQ(0U, pool.getPoolSize());
     }
 
-    for (size_t i = 0; i < MAX_POOL_SIZE; i++) {
+    for (size_t i = MAX_THREAD_POOL_SIZE; i < TOTAL_SIZE; i++) {
         pool.release(std::move(slots[i]));
-        EXPECT_EQ(i + 1, pool.getPoolSize());
+        EXPECT_EQ(MAX_THREAD_POOL_SIZE, pool.getThreadPoolSize());
+        EXPECT_EQ(i + 1 - MAX_THREAD_POOL_SIZE, pool.getPoolSize());
     }
 
-    for (size_t i = MAX_POOL_SIZE; i < MAX_POOL_SIZE * 2; i++) {
+    for (size_t i = TOTAL_SIZE; i < TOTAL_SIZE * 2; i++) {
         pool.release(std::move(slots[i]));
+        EXPECT_EQ(MAX_THREAD_POOL_SIZE, pool.getThreadPoolSize());
         EXPECT_EQ(MAX_POOL_SIZE, pool.getPoolSize());
     }
 }
 
+TEST(WordBreakerTest, LineBreakerPool_shared_between_threads) {
+    TestableICULineBreakerPoolImpl pool(1, 4);
+
+    const Locale enUS("en-Latn-US");
+    const Locale frFR("fr-Latn-FR");
+
+    ICULineBreakerPool::Slot enUSBreaker = pool.acquire(enUS);
+    ICULineBreakerPool::Slot frFRBreaker = pool.acquire(frFR);
+    UBreakIterator* enUSBreakerPtr = enUSBreaker.breaker.get();
+    UBreakIterator* frFRBreakerPtr = frFRBreaker.breaker.get();
+
+    // The first one overflows to the shared pool.
+    pool.release(std::move(enUSBreaker));
+    pool.release(std::move(frFRBreaker));
+    EXPECT_EQ(1U, pool.getThreadPoolSize());
+    EXPECT_EQ(1U, pool.getPoolSize());
+
+    // Other threads only see the shared pool.
+    std::thread thread([&] {
+        ICULineBreakerPool::Slot slot = pool.acquire(enUS);
+        EXPECT_EQ(enUSBreakerPtr, slot.breaker.get());
+        slot = pool.acquire(frFR);
+        EXPECT_NE(frFRBreakerPtr, slot.breaker.get());
+        EXPECT_EQ(0U, pool.getThreadPoolSize());
+    });
+    thread.join();
+
+    ICULineBreakerPool::Slot frFRBreaker2 = pool.acquire(frFR);
+    EXPECT_EQ(frFRBreakerPtr, frFRBreaker2.breaker.get());
+
+    ICULineBreakerPoolImpl::Stats stats = pool.getStats();
+    EXPECT_EQ(3U, stats.openCount);
+    EXPECT_EQ(1U, stats.threadHitCount);
+    EXPECT_EQ(1U, stats.sharedHitCount);
+}
+
+TEST(WordBreakerTest, LineBreakerPool_set_max_pool_sizes) {
+    TestableICULineBreakerPoolImpl pool(0, 4);
+
+    const Locale enUS("en-Latn-US");
+
+    ICULineBreakerPool::Slot slots[4];
+    for (size_t i = 0; i < 4; i++) {
+        slots[i] = pool.acquire(enUS);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pool.release(std::move(slots[i]));
+    }
+    EXPECT_EQ(0U, pool.getThreadPoolSize());
+    EXPECT_EQ(4U, pool.getPoolSize());
+
+    pool.setMaxPoolSizes(2, 1);
+    EXPECT_EQ(1U, pool.getPoolSize());
+}
+
+TEST(WordBreakerTest, reuseBreakerForSameLocale) {
+    uint16_t buf[] = {'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd'};
+    const Locale enUS("en-US");
+    TestableICULineBreakerPoolImpl pool;
+    class TestableWordBreaker : public WordBreaker {
+    public:
+        TestableWordBreaker(ICULineBreakerPool* pool) : WordBreaker(pool) {}
+    };
+
+    TestableWordBreaker breaker(&pool);
+    breaker.setText(buf, NELEM(buf));
+    EXPECT_EQ(6, breaker.followingWithLocale(enUS, 0));
+    EXPECT_EQ(11, breaker.followingWithLocale(enUS, 6));
+    EXPECT_EQ(1U, pool.getStats().openCount);
+
+    // Switching the locale releases the previous breaker to the pool.
+    EXPECT_EQ(6, breaker.followingWithLocale(Locale("fr-FR"), 0));
+    EXPECT_EQ(6, breaker.followingWithLocale(enUS, 0));
+    EXPECT_EQ(2U, pool.getStats().openCount);
+    EXPECT_EQ(1U, pool.getStats().threadHitCount);
+}
+
 }  // namespace minikin
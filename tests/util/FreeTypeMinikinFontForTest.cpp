@@ -126,4 +126,9 @@ Font::TypefaceLoader* readFreeTypeMinikinFontForTest(BufferReader* reader) {
     return &loadFreeTypeMinikinFontForTest;
 }
 
+Font::TypefaceLoader* readFreeTypeMinikinFontForTest(CheckedBufferReader* reader) {
+    reader->skipString();  // fontPath
+    return reader->hasError() ? nullptr : &loadFreeTypeMinikinFontForTest;
+}
+
 }  // namespace minikin
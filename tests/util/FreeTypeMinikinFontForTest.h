@@ -67,6 +67,7 @@ private:
 void writeFreeTypeMinikinFontForTest(BufferWriter* writer, const MinikinFont* typeface);
 
 Font::TypefaceLoader* readFreeTypeMinikinFontForTest(BufferReader* reader);
+Font::TypefaceLoader* readFreeTypeMinikinFontForTest(CheckedBufferReader* reader);
 
 }  // namespace minikin
 
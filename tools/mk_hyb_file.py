@@ -18,9 +18,11 @@
 Convert hyphen files in standard TeX format (a trio of pat, chr, and hyp)
 into binary format. See doc/hyb_file_format.md for more information.
 
-Usage: mk_hyb_file.py [-v] hyph-foo.pat.txt hyph-foo.hyb
+Usage: mk_hyb_file.py [-v] [--legacy] hyph-foo.pat.txt hyph-foo.hyb
 
 Optional -v parameter turns on verbose debugging.
+Optional --legacy parameter writes a version 0 file, without the pattern automaton, and with the
+alphabet in one of the formats readable by older versions (0 or 1).
 
 """
 
@@ -308,16 +310,24 @@ def load_hyp(hyph, fn):
             hyph.add_exception(l.strip())
 
 
-def generate_header(alphabet, trie, pattern):
-    alphabet_off = 6 * 4
+def generate_header(alphabet, trie, pattern, automaton=None):
+    if automaton is None:
+        alphabet_off = 6 * 4
+    else:
+        alphabet_off = 7 * 4
     trie_off = alphabet_off + len(alphabet)
     pattern_off = trie_off + len(trie)
     file_size = pattern_off + len(pattern)
-    data = [0x62ad7968, 0, alphabet_off, trie_off, pattern_off, file_size]
-    return struct.pack('<6I', *data)
+    if automaton is None:
+        data = [0x62ad7968, 0, alphabet_off, trie_off, pattern_off, file_size]
+        return struct.pack('<6I', *data)
+    automaton_off = file_size
+    file_size += len(automaton)
+    data = [0x62ad7968, 1, alphabet_off, trie_off, pattern_off, file_size, automaton_off]
+    return struct.pack('<7I', *data)
 
 
-def generate_alphabet(ch_map):
+def generate_alphabet(ch_map, legacy=False):
     ch_map = ch_map.copy()
     del ch_map['.']
     min_ch = ord(min(ch_map))
@@ -330,13 +340,30 @@ def generate_alphabet(ch_map):
         result = [struct.pack('<3I', 0, min_ch, max_ch + 1)]
         for b in data:
             result.append(struct.pack('<B', b))
-    else:
+    elif legacy:
         # generate format 1
         assert max(ch_map.values()) < 2048, 'max number of unique characters exceeded'
         result = [struct.pack('<2I', 1, len(ch_map))]
         for c, val in sorted(ch_map.items()):
             data = (ord(c) << 11) | val
             result.append(struct.pack('<I', data))
+    else:
+        # generate format 2, a two-level table indexed by the code point page (high bits) and the
+        # code point within the page (low 8 bits). Block 0 is empty, shared by unused pages.
+        assert max(ch_map.values()) < 65536, 'max number of unique characters exceeded'
+        blocks = {}
+        for c, val in ch_map.items():
+            blocks.setdefault(ord(c) >> 8, [0] * 256)[ord(c) & 0xff] = val
+        n_pages = max(blocks) + 1
+        page_index = [0] * n_pages
+        for i, page in enumerate(sorted(blocks)):
+            page_index[page] = i + 1
+        result = [struct.pack('<3I', 2, n_pages, len(blocks) + 1)]
+        for block in page_index:
+            result.append(struct.pack('<H', block))
+        result.append(struct.pack('<256H', *([0] * 256)))
+        for page in sorted(blocks):
+            result.append(struct.pack('<256H', *blocks[page]))
     binary = b''.join(result)
     if len(binary) % 4 != 0:
         binary += b'\x00' * (4 - len(binary) % 4)
@@ -407,20 +434,65 @@ def generate_pattern(pats):
     return patmap, b''.join(result)
 
 
-def generate_hyb_file(hyph, ch_map, hyb_fn):
+# Aho-Corasick automaton over the same patterns as the trie, so that all the patterns in a word
+# are found in one pass over the word instead of a trie walk from every offset. The goto function
+# is the trie without suffix compression, packed the same way as the trie. The states are
+# numbered in bfs order, so the root is state 0.
+def generate_automaton(hyph, ch_map, patmap):
+    states = hyph.bfs_order
+    hyph.root.fail = None
+    hyph.root.fsm_pat = None
+    for node in states:
+        for c, next in node.succ.items():
+            fail = node.fail
+            while fail is not None and c not in fail.succ:
+                fail = fail.fail
+            next.fail = hyph.root if fail is None else fail.succ[c]
+            # fsm_pat is the nearest state with a pattern along the failure links
+            next.fsm_pat = next.fail if next.fail.res is not None else next.fail.fsm_pat
+
+    # must be called after generate_trie, since packing overwrites node.ix
+    n_entries = hyph.pack(states, ch_map)
+    link_shift = num_bits(max(ch_map.values()) + 1)
+    char_mask = (1 << link_shift) - 1
+    link_mask = ((1 << num_bits(len(states) - 1)) - 1) << link_shift
+    result = [struct.pack('<6I', 0, char_mask, link_shift, link_mask, len(states), n_entries)]
+    goto_array = [0] * n_entries
+    for node in states:
+        fail = 0 if node.fail is None else node.fail.bfs_ix
+        pattern = 0 if node.res is None else patmap[pat_to_binary(node.res)]
+        output = 0 if node.fsm_pat is None else node.fsm_pat.bfs_ix
+        result.append(struct.pack('<4I', node.ix, fail, pattern, output))
+        for c, next in node.succ.items():
+            # store the character plus one, so that an empty slot never matches
+            goto_array[node.ix + ch_map[c]] = (next.bfs_ix << link_shift) | (ch_map[c] + 1)
+    for entry in goto_array:
+        result.append(struct.pack('<I', entry))
+    return b''.join(result)
+
+
+def generate_hyb_file(hyph, ch_map, hyb_fn, legacy=False):
     bfs = hyph.bfs(ch_map)
     dedup_ix, dedup_nodes = hyph.dedup()
     n_trie = hyph.pack(dedup_nodes, ch_map)
-    alphabet = generate_alphabet(ch_map)
+    alphabet = generate_alphabet(ch_map, legacy)
     patmap, pattern = generate_pattern([n.res for n in hyph.node_list])
     trie = generate_trie(hyph, ch_map, n_trie, dedup_ix, dedup_nodes, patmap)
-    header = generate_header(alphabet, trie, pattern)
+    automaton = None
+    if not legacy:
+        automaton = generate_automaton(hyph, ch_map, patmap)
+        # align the automaton to a 4-byte boundary
+        if len(pattern) % 4 != 0:
+            pattern += b'\x00' * (4 - len(pattern) % 4)
+    header = generate_header(alphabet, trie, pattern, automaton)
 
     with open(hyb_fn, 'wb') as f:
         f.write(header)
         f.write(alphabet)
         f.write(trie)
         f.write(pattern)
+        if automaton is not None:
+            f.write(automaton)
 
 
 # Verify that the file contains the same lines as the lines argument, in arbitrary order
@@ -466,39 +538,42 @@ def get_pattern(pattern_data, ix):
     return pattern_data[offset: offset + pat_len] + b'\0' * pat_shift
 
 
+def decode_pattern(s, pat, patterns, exceptions):
+    result = []
+    is_exception = False
+    for i in range(len(s) + 1):
+        pat_off = i - 1 + len(pat) - len(s)
+        if pat_off < 0:
+            code = 0
+        else:
+            code = struct.unpack('B', pat[pat_off : pat_off + 1])[0]
+        if 1 <= code <= 9:
+            result.append('%d' % code)
+        elif code == 10:
+            is_exception = True
+        elif code == 11:
+            result.append('-')
+            is_exception = True
+        else:
+            assert code == 0, 'unexpected code'
+        if i < len(s):
+            result.append(s[i])
+    pat_str = ''.join(result)
+    #print(`pat_str`, `pat`)
+    if is_exception:
+        assert pat_str[0] == '.', "expected leading '.'"
+        assert pat_str[-1] == '.', "expected trailing '.'"
+        exceptions.append(pat_str[1:-1])  # strip leading and trailing '.'
+    else:
+        patterns.append(pat_str)
+
+
 def traverse_trie(ix, s, trie_data, ch_map, pattern_data, patterns, exceptions):
     (char_mask, link_shift, link_mask, pattern_shift) = struct.unpack('<4I', trie_data[4:20])
     node_entry = struct.unpack('<I', trie_data[24 + ix * 4: 24 + ix * 4 + 4])[0]
     pattern = node_entry >> pattern_shift
     if pattern:
-        result = []
-        is_exception = False
-        pat = get_pattern(pattern_data, pattern)
-        for i in range(len(s) + 1):
-            pat_off = i - 1 + len(pat) - len(s)
-            if pat_off < 0:
-                code = 0
-            else:
-                code = struct.unpack('B', pat[pat_off : pat_off + 1])[0]
-            if 1 <= code <= 9:
-                result.append('%d' % code)
-            elif code == 10:
-                is_exception = True
-            elif code == 11:
-                result.append('-')
-                is_exception = True
-            else:
-                assert code == 0, 'unexpected code'
-            if i < len(s):
-                result.append(s[i])
-        pat_str = ''.join(result)
-        #print(`pat_str`, `pat`)
-        if is_exception:
-            assert pat_str[0] == '.', "expected leading '.'"
-            assert pat_str[-1] == '.', "expected trailing '.'"
-            exceptions.append(pat_str[1:-1])  # strip leading and trailing '.'
-        else:
-            patterns.append(pat_str)
+        decode_pattern(s, get_pattern(pattern_data, pattern), patterns, exceptions)
     for ch in ch_map:
         edge_entry = struct.unpack('<I', trie_data[24 + (ix + ch) * 4: 24 + (ix + ch) * 4 + 4])[0]
         link = (edge_entry & link_mask) >> link_shift
@@ -507,6 +582,35 @@ def traverse_trie(ix, s, trie_data, ch_map, pattern_data, patterns, exceptions):
             traverse_trie(link, sch, trie_data, ch_map, pattern_data, patterns, exceptions)
 
 
+# Walks the goto function of the automaton, which must give the same patterns as the trie. Also
+# checks that the failure links point to the longest proper suffix in the automaton.
+def traverse_automaton(state, s, automaton_data, ch_map, pattern_data, patterns, exceptions,
+                       states_by_string):
+    (char_mask, link_shift, link_mask, n_states) = struct.unpack('<4I', automaton_data[4:20])
+    states_by_string[s] = state
+    (base, fail, pattern, output) = struct.unpack(
+        '<4I', automaton_data[24 + state * 16: 24 + state * 16 + 16])
+    if pattern:
+        decode_pattern(s, get_pattern(pattern_data, pattern), patterns, exceptions)
+    goto_off = 24 + n_states * 16
+    for ch in ch_map:
+        entry = struct.unpack('<I', automaton_data[goto_off + (base + ch) * 4:
+                                                   goto_off + (base + ch) * 4 + 4])[0]
+        if (entry & char_mask) == ch + 1:
+            next = (entry & link_mask) >> link_shift
+            traverse_automaton(next, s + ch_map[ch], automaton_data, ch_map, pattern_data,
+                               patterns, exceptions, states_by_string)
+
+
+def verify_failure_links(automaton_data, states_by_string):
+    for s, state in states_by_string.items():
+        fail = struct.unpack('<I', automaton_data[24 + state * 16 + 4: 24 + state * 16 + 8])[0]
+        suffix = s[1:]
+        while suffix not in states_by_string:
+            suffix = suffix[1:]
+        assert s == '' or fail == states_by_string[suffix], 'wrong failure link for ' + repr(s)
+
+
 # Verify the generated binary file by reconstructing the textual representations
 # from the binary hyb file, then checking that they're identical (mod the order of
 # lines within the file, which is irrelevant). This function makes assumptions that
@@ -519,7 +623,12 @@ def verify_hyb_file(hyb_fn, pat_fn, chr_fn, hyp_fn):
     (magic, version, alphabet_off, trie_off, pattern_off, file_size) = struct.unpack('<6I', header)
     alphabet_data = hyb_data[alphabet_off:trie_off]
     trie_data = hyb_data[trie_off:pattern_off]
-    pattern_data = hyb_data[pattern_off:file_size]
+    if version == 0:
+        pattern_data = hyb_data[pattern_off:file_size]
+    else:
+        automaton_off = struct.unpack('<I', hyb_data[6 * 4: 7 * 4])[0]
+        pattern_data = hyb_data[pattern_off:automaton_off]
+        automaton_data = hyb_data[automaton_off:file_size]
 
     # reconstruct alphabet table
     alphabet_version = struct.unpack('<I', alphabet_data[:4])[0]
@@ -531,12 +640,24 @@ def verify_hyb_file(hyb_fn, pat_fn, chr_fn, hyp_fn):
             b = struct.unpack('B', alphabet_data[offset : offset + 1])[0]
             if b != 0:
                 alphabet_map[unichr(ch)] = b
-    else:
-        assert alphabet_version == 1
+    elif alphabet_version == 1:
         n_entries = struct.unpack('<I', alphabet_data[4:8])[0]
         for i in range(n_entries):
             entry = struct.unpack('<I', alphabet_data[8 + 4 * i: 8 + 4 * i + 4])[0]
             alphabet_map[unichr(entry >> 11)] = entry & 0x7ff
+    else:
+        assert alphabet_version == 2
+        (n_pages, n_blocks) = struct.unpack('<2I', alphabet_data[4:12])
+        page_index = struct.unpack('<%dH' % n_pages, alphabet_data[12: 12 + 2 * n_pages])
+        blocks_off = 12 + 2 * n_pages
+        values = struct.unpack('<%dH' % (n_blocks * 256),
+                               alphabet_data[blocks_off: blocks_off + n_blocks * 512])
+        assert not any(values[:256]), 'empty block not verified'
+        for page, block in enumerate(page_index):
+            for i in range(256):
+                val = values[block * 256 + i]
+                if val != 0:
+                    alphabet_map[unichr((page << 8) | i)] = val
 
     ch_map, reconstructed_chr = map_to_chr(alphabet_map)
 
@@ -560,17 +681,34 @@ def verify_hyb_file(hyb_fn, pat_fn, chr_fn, hyp_fn):
     assert verify_file_sorted(patterns, pat_fn), 'pattern table not verified'
     assert verify_file_sorted(exceptions, hyp_fn), 'exception table not verified'
 
+    if version != 0:
+        automaton_patterns = []
+        automaton_exceptions = []
+        states_by_string = {}
+        traverse_automaton(0, '', automaton_data, ch_map, pattern_data, automaton_patterns,
+                           automaton_exceptions, states_by_string)
+        if u'\u044c' in automaton_patterns:
+            automaton_patterns.remove(u'\u044c')
+            automaton_patterns.append(u'0\u044c0')
+        assert sorted(automaton_patterns) == sorted(patterns), 'automaton patterns not verified'
+        assert sorted(automaton_exceptions) == sorted(exceptions), \
+            'automaton exceptions not verified'
+        verify_failure_links(automaton_data, states_by_string)
+
 
 def main():
     global VERBOSE
     try:
-        opts, args = getopt.getopt(sys.argv[1:], 'v')
+        opts, args = getopt.getopt(sys.argv[1:], 'v', ['legacy'])
     except getopt.GetoptError as err:
         print(str(err))
         sys.exit(1)
+    legacy = False
     for o, _ in opts:
         if o == '-v':
             VERBOSE = True
+        elif o == '--legacy':
+            legacy = True
     pat_fn, out_fn = args
     hyph = load(pat_fn)
     if pat_fn.endswith('.pat.txt'):
@@ -578,7 +716,7 @@ def main():
         ch_map = load_chr(chr_fn)
         hyp_fn = pat_fn[:-8] + '.hyp.txt'
         load_hyp(hyph, hyp_fn)
-        generate_hyb_file(hyph, ch_map, out_fn)
+        generate_hyb_file(hyph, ch_map, out_fn, legacy)
         verify_hyb_file(out_fn, pat_fn, chr_fn, hyp_fn)
 
 if __name__ == '__main__':